@@ -0,0 +1,65 @@
+#include "AllocationTracker.h"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+std::atomic<size_t> g_current{0};
+std::atomic<size_t> g_peak{0};
+std::atomic<size_t> g_allocations{0};
+std::atomic<bool> g_enabled{false};
+
+// Each block carries its size in front so delete can account for it.
+constexpr size_t kHeader = alignof(std::max_align_t);
+
+void* trackedAlloc(size_t size) {
+    void* block = std::malloc(size + kHeader);
+    if (!block) throw std::bad_alloc();
+    if (!g_enabled.load(std::memory_order_relaxed)) {
+        *static_cast<size_t*>(block) = 0;
+        return static_cast<char*>(block) + kHeader;
+    }
+    *static_cast<size_t*>(block) = size;
+
+    size_t current = g_current.fetch_add(size, std::memory_order_relaxed) + size;
+    size_t peak = g_peak.load(std::memory_order_relaxed);
+    while (current > peak && !g_peak.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+    }
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    return static_cast<char*>(block) + kHeader;
+}
+
+void trackedFree(void* pointer) {
+    if (!pointer) return;
+    void* block = static_cast<char*>(pointer) - kHeader;
+    // Blocks allocated while tracking was off carry a zero size.
+    size_t size = *static_cast<size_t*>(block);
+    if (size) g_current.fetch_sub(size, std::memory_order_relaxed);
+    std::free(block);
+}
+
+}
+
+void* operator new(size_t size) { return trackedAlloc(size); }
+void* operator new[](size_t size) { return trackedAlloc(size); }
+void operator delete(void* pointer) noexcept { trackedFree(pointer); }
+void operator delete[](void* pointer) noexcept { trackedFree(pointer); }
+void operator delete(void* pointer, size_t) noexcept { trackedFree(pointer); }
+void operator delete[](void* pointer, size_t) noexcept { trackedFree(pointer); }
+
+namespace deep_thonk::bench {
+
+AllocationStats allocationStats() {
+    return {g_current.load(), g_peak.load(), g_allocations.load()};
+}
+
+void setAllocationTracking(bool enabled) {
+    g_enabled.store(enabled);
+}
+
+void resetAllocationPeak() {
+    g_peak.store(g_current.load());
+}
+
+}
@@ -0,0 +1,27 @@
+#ifndef DEEPTHONK3D_BENCH_ALLOCATIONTRACKER_H
+#define DEEPTHONK3D_BENCH_ALLOCATIONTRACKER_H
+
+#include <cstddef>
+
+namespace deep_thonk::bench {
+
+    // Counts global operator new/delete in the benchmark binary while tracking
+    // is on. Off by default: the shared counters would skew multi-threaded
+    // timings. Only blocks allocated while tracking was on are counted when
+    // they are freed.
+    struct AllocationStats {
+        size_t currentBytes = 0;
+        size_t peakBytes = 0;
+        size_t allocations = 0;
+    };
+
+    AllocationStats allocationStats();
+
+    void setAllocationTracking(bool enabled);
+
+    // Restarts peak tracking from the current live size.
+    void resetAllocationPeak();
+
+}
+
+#endif //DEEPTHONK3D_BENCH_ALLOCATIONTRACKER_H
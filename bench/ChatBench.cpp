@@ -0,0 +1,82 @@
+#include "Suites.h"
+#include "AllocationTracker.h"
+#include "Corpus.h"
+#include "ui/model/ChatModel.h"
+#include <QString>
+#include <QStringList>
+#include <memory>
+
+namespace deep_thonk::bench {
+
+namespace {
+
+// Copying appends timed per checkpoint for the string baseline; one per
+// message would take hours at 100k lines.
+constexpr int kStringSamples = 50;
+// Model appends timed per checkpoint, just before the transcript reaches it.
+constexpr int kModelWindow = 1000;
+
+QString transcriptLine(const QString& text, int row)
+{
+    return row % 2 == 0 ? QStringLiteral("[12:00:00] You: ") + text + QLatin1Char('\n')
+                        : QStringLiteral("[12:00:00] Therapist: ") + text + QStringLiteral(" (rule: bench.reply)\n");
+}
+
+}
+
+void benchChatHistory(Report& report, const BenchOptions& options) {
+    std::vector<int> checkpoints = options.quick ? std::vector<int>{1000, 10000} : std::vector<int>{1000, 10000, 100000};
+    std::vector<std::string> corpus = makeCorpus("en-US", 4096);
+    QStringList messages;
+    for (const auto& message : corpus)
+        messages.append(QString::fromStdString(message));
+    const QString ruleId = QStringLiteral("bench.reply");
+    const qint64 timestamp = 1700000000000;
+
+    // ChatModel: append the whole transcript, timing the last window before
+    // each checkpoint and the heap it holds once there.
+    setAllocationTracking(true);
+    AllocationStats before = allocationStats();
+    auto model = std::make_unique<ChatModel>();
+    int row = 0;
+    for (int checkpoint : checkpoints) {
+        for (; row < checkpoint - kModelWindow; ++row) {
+            model->append(row % 2 ? ChatModel::Speaker::Therapist : ChatModel::Speaker::User,
+                          messages[row % messages.size()], row % 2 ? ruleId : QString(), timestamp);
+        }
+        uint64_t start = nowNs();
+        for (; row < checkpoint; ++row) {
+            model->append(row % 2 ? ChatModel::Speaker::Therapist : ChatModel::Speaker::User,
+                          messages[row % messages.size()], row % 2 ? ruleId : QString(), timestamp);
+        }
+        double perAppend = static_cast<double>(nowNs() - start) / kModelWindow;
+        size_t modelBytes = allocationStats().currentBytes - before.currentBytes;
+
+        report.add("chat", "chat_model", {{"messages", checkpoint}},
+                   {{"ns_per_append", perAppend}, {"bytes", modelBytes},
+                    {"bytes_per_message", static_cast<double>(modelBytes) / checkpoint}});
+    }
+    setAllocationTracking(false);
+    model.reset();
+
+    // The old TextArea: every message rebuilt the whole transcript string
+    // (`chatLog.text += ...`). Only the copy is timed here; the text layout
+    // the TextArea then redid over the whole document comes on top.
+    QString transcript;
+    row = 0;
+    for (int checkpoint : checkpoints) {
+        for (; row < checkpoint; ++row)
+            transcript += transcriptLine(messages[row % messages.size()], row);
+
+        uint64_t start = nowNs();
+        for (int sample = 0; sample < kStringSamples; ++sample) {
+            QString next = transcript + transcriptLine(messages[sample % messages.size()], checkpoint + sample);
+        }
+        double perAppend = static_cast<double>(nowNs() - start) / kStringSamples;
+
+        report.add("chat", "textarea_string", {{"messages", checkpoint}},
+                   {{"ns_per_append", perAppend}, {"bytes", static_cast<double>(transcript.size()) * sizeof(QChar)}});
+    }
+}
+
+}
@@ -0,0 +1,59 @@
+#include "Corpus.h"
+#include <random>
+
+namespace deep_thonk::bench {
+
+namespace {
+
+struct Phrasebook {
+    std::vector<std::string> openers;
+    std::vector<std::string> subjects;
+    std::vector<std::string> endings;
+    std::vector<std::string> smallTalk;
+};
+
+const Phrasebook& phrasebook(const std::string& locale) {
+    static const Phrasebook en{
+        {"I feel", "I am feeling", "I think", "I can't", "I do not", "I am", "You are", "Please reflect:", "Hello,", "Hey"},
+        {"my mother never listens to me", "you are not helping me", "I am stuck at my job",
+         "my friends forget about me", "I should call my father", "your questions make me nervous",
+         "me and my brother are fighting again", "I am tired of my routine"},
+        {"", " today", " lately", " and I don't know why", " again", " at night"},
+        {"ok", "maybe", "whatever you say", "the weather was nice", "lunch was late", "it rained all week",
+         "so what now", "nothing much happened"},
+    };
+    static const Phrasebook pt{
+        {"eu sinto", "tenho sentido", "eu não consigo", "eu nao consigo", "Eu sinto"},
+        {"que minha mãe não me escuta", "que eu sou um fardo para meu pai", "medo do meu futuro",
+         "falta da minha casa", "que meus amigos esqueceram de mim", "raiva de mim mesmo",
+         "dormir direito", "entender minha família"},
+        {"", " hoje", " ultimamente", " e não sei por quê", " de novo", " à noite"},
+        {"tudo bem", "talvez", "choveu a semana toda", "o almoço atrasou", "e agora", "nada demais",
+         "sei lá", "o trânsito estava ruim"},
+    };
+    return locale == "pt-BR" ? pt : en;
+}
+
+}
+
+std::vector<std::string> makeCorpus(const std::string& locale, size_t count, uint32_t seed) {
+    const Phrasebook& book = phrasebook(locale);
+    std::mt19937 rng(seed);
+    auto pick = [&rng](const std::vector<std::string>& list) -> const std::string& {
+        return list[std::uniform_int_distribution<size_t>(0, list.size() - 1)(rng)];
+    };
+
+    std::vector<std::string> corpus;
+    corpus.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        // Roughly one message in four is small talk for the fallback rule.
+        if (rng() % 4 == 0) {
+            corpus.push_back(pick(book.smallTalk));
+        } else {
+            corpus.push_back(pick(book.openers) + " " + pick(book.subjects) + pick(book.endings));
+        }
+    }
+    return corpus;
+}
+
+}
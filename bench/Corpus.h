@@ -0,0 +1,19 @@
+#ifndef DEEPTHONK3D_BENCH_CORPUS_H
+#define DEEPTHONK3D_BENCH_CORPUS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace deep_thonk::bench {
+
+    // Chat-like messages for the shipped packs of `locale` ("en-US" or
+    // "pt-BR"): a mix of phrases the specific rules catch, pronoun-heavy
+    // captures for reflection, and small talk that only the fallback takes.
+    // Deterministic for a given seed.
+    std::vector<std::string> makeCorpus(const std::string& locale, size_t count, uint32_t seed = 1);
+
+}
+
+#endif //DEEPTHONK3D_BENCH_CORPUS_H
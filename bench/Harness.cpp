@@ -0,0 +1,81 @@
+#include "Harness.h"
+#include "core/rogerian/Instrumentation.h"
+#include <algorithm>
+#include <ctime>
+#include <iostream>
+#include <numeric>
+#include <thread>
+
+namespace deep_thonk::bench {
+
+namespace {
+
+double percentile(const std::vector<double>& sorted, double fraction) {
+    size_t rank = static_cast<size_t>(fraction * static_cast<double>(sorted.size() - 1) + 0.5);
+    return sorted[std::min(rank, sorted.size() - 1)];
+}
+
+std::string compilerName() {
+#if defined(__clang__)
+    return "clang " __clang_version__;
+#elif defined(__GNUC__)
+    return "gcc " __VERSION__;
+#elif defined(_MSC_VER)
+    return "msvc " + std::to_string(_MSC_VER);
+#else
+    return "unknown";
+#endif
+}
+
+}
+
+LatencySummary summarize(std::vector<double>& samples) {
+    LatencySummary summary;
+    if (samples.empty()) return summary;
+
+    std::sort(samples.begin(), samples.end());
+    summary.mean = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size());
+    summary.p50 = percentile(samples, 0.50);
+    summary.p99 = percentile(samples, 0.99);
+    summary.min = samples.front();
+    summary.max = samples.back();
+    return summary;
+}
+
+nlohmann::json toJson(const LatencySummary& summary) {
+    return {{"mean_ns", summary.mean}, {"p50_ns", summary.p50}, {"p99_ns", summary.p99},
+            {"min_ns", summary.min}, {"max_ns", summary.max}};
+}
+
+void Report::add(const std::string& suite, const std::string& name, nlohmann::json params, nlohmann::json metrics) {
+    std::cout << suite << "/" << name;
+    if (!params.empty()) std::cout << " " << params.dump();
+    std::cout << "\n    " << metrics.dump() << std::endl;
+    m_results.push_back({{"suite", suite}, {"name", name}, {"params", std::move(params)}, {"metrics", std::move(metrics)}});
+}
+
+nlohmann::json Report::toJson(const BenchOptions& options) const {
+    return {
+        {"schema", 1},
+        {"timestamp", static_cast<int64_t>(std::time(nullptr))},
+        {"compiler", compilerName()},
+#ifdef NDEBUG
+        {"build", "release"},
+#else
+        {"build", "debug"},
+#endif
+        {"instrumentation", deep_thonk::kInstrumentationEnabled},
+        {"hardware_threads", std::thread::hardware_concurrency()},
+        {"quick", options.quick},
+        {"results", m_results},
+    };
+}
+
+QuietStdout::QuietStdout() : m_previous(std::cout.rdbuf(nullptr)) {}
+
+QuietStdout::~QuietStdout() {
+    std::cout.rdbuf(m_previous);
+    std::cout.clear();
+}
+
+}
@@ -0,0 +1,64 @@
+#ifndef DEEPTHONK3D_BENCH_HARNESS_H
+#define DEEPTHONK3D_BENCH_HARNESS_H
+
+#include "third_party/nlohmann/json.hpp"
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace deep_thonk::bench {
+
+    struct BenchOptions {
+        // Smaller corpora and pack sizes, for a quick local sanity run.
+        bool quick = false;
+        // Only suites whose name contains this substring run.
+        std::string filter;
+    };
+
+    // Distribution of a set of per-call timings, in nanoseconds.
+    struct LatencySummary {
+        double mean = 0;
+        double p50 = 0;
+        double p99 = 0;
+        double min = 0;
+        double max = 0;
+    };
+
+    // Sorts `samples` in place.
+    LatencySummary summarize(std::vector<double>& samples);
+    nlohmann::json toJson(const LatencySummary& summary);
+
+    inline uint64_t nowNs() {
+        return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+    }
+
+    // Collects results from every suite. Each add() also prints one line for
+    // humans; toJson() is the machine-readable form meant to be archived per
+    // commit and diffed.
+    class Report {
+    public:
+        void add(const std::string& suite, const std::string& name, nlohmann::json params, nlohmann::json metrics);
+        nlohmann::json toJson(const BenchOptions& options) const;
+
+    private:
+        nlohmann::json m_results = nlohmann::json::array();
+    };
+
+    // Silences std::cout for its lifetime; the engine logs every pack it loads.
+    class QuietStdout {
+    public:
+        QuietStdout();
+        ~QuietStdout();
+
+        QuietStdout(const QuietStdout&) = delete;
+        QuietStdout& operator=(const QuietStdout&) = delete;
+
+    private:
+        std::streambuf* m_previous;
+    };
+
+}
+
+#endif //DEEPTHONK3D_BENCH_HARNESS_H
@@ -0,0 +1,70 @@
+#include "Suites.h"
+#include "AllocationTracker.h"
+#include "SyntheticPack.h"
+#include "core/rogerian/Engine.h"
+#include "ui/model/RuleModel.h"
+#include <QMetaObject>
+#include <QString>
+#include <QStringList>
+#include <memory>
+#include <random>
+
+namespace deep_thonk::bench {
+
+namespace {
+
+constexpr size_t kUpdatesPerFrame = 64;
+
+}
+
+void benchRuleModel(Report& report, const BenchOptions& options) {
+    std::vector<size_t> ruleCounts = options.quick ? std::vector<size_t>{100, 1000}
+                                                   : std::vector<size_t>{100, 1000, 10000, 100000};
+    size_t updates = options.quick ? 10000 : 200000;
+
+    for (size_t ruleCount : ruleCounts) {
+        Engine engine;
+        {
+            QuietStdout quiet;
+            engine.loadRulesFromString(makeSyntheticPack("en-US", ruleCount).json);
+        }
+
+        setAllocationTracking(true);
+        AllocationStats before = allocationStats();
+        uint64_t start = nowNs();
+        auto model = std::make_unique<RuleModel>(&engine);
+        double buildMs = static_cast<double>(nowNs() - start) / 1e6;
+        size_t modelBytes = allocationStats().currentBytes - before.currentBytes;
+        setAllocationTracking(false);
+
+        QStringList ids;
+        std::shared_ptr<const RulePack> pack = engine.getRulePack("en-US");
+        for (const auto& rule : pack->rules) {
+            std::string_view id = pack->str(rule.id);
+            ids.append(QString::fromUtf8(id.data(), static_cast<qsizetype>(id.size())));
+        }
+        std::mt19937 rng(3);
+        std::vector<int> picks(updates);
+        for (int& pick : picks) pick = static_cast<int>(rng() % ids.size());
+
+        size_t repaints = 0;
+        QObject::connect(model.get(), &QAbstractItemModel::dataChanged, [&repaints] { ++repaints; });
+
+        // Replies arrive in bursts between two repaints; flush the way the
+        // model's timer would after every burst.
+        start = nowNs();
+        for (size_t i = 0; i < picks.size(); ++i) {
+            model->onRuleMatched(ids[picks[i]]);
+            if ((i + 1) % kUpdatesPerFrame == 0 || i + 1 == picks.size()) {
+                QMetaObject::invokeMethod(model.get(), "flushHits", Qt::DirectConnection);
+            }
+        }
+        double perUpdate = static_cast<double>(nowNs() - start) / static_cast<double>(updates);
+
+        report.add("model", "onRuleMatched", {{"rules", ruleCount}, {"updates", updates}, {"updates_per_frame", kUpdatesPerFrame}},
+                   {{"ns_per_update", perUpdate}, {"build_ms", buildMs}, {"model_bytes", modelBytes},
+                    {"signals_per_update", static_cast<double>(repaints) / static_cast<double>(updates)}});
+    }
+}
+
+}
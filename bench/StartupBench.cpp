@@ -0,0 +1,80 @@
+#include "Suites.h"
+#include "core/rogerian/Engine.h"
+#include "ui/bridge/Bridge.h"
+#include <QEventLoop>
+#include <QSet>
+#include <QString>
+#include <QTimer>
+#include <memory>
+
+namespace deep_thonk::bench {
+
+namespace {
+
+constexpr int kReadyTimeoutMs = 60000;
+
+// Bridge logs every locale switch; that is not what is being measured.
+void discardMessages(QtMsgType, const QMessageLogContext&, const QString&) {}
+
+double elapsedMs(uint64_t startNs) {
+    return static_cast<double>(nowNs() - startNs) / 1e6;
+}
+
+// Runs the event loop until every locale in `pending` has reported ready.
+bool waitForLocales(Bridge& bridge, QSet<QString> pending) {
+    QEventLoop loop;
+    QObject::connect(&bridge, &Bridge::localeReady, &loop, [&](const QString& locale) {
+        pending.remove(locale);
+        if (pending.isEmpty()) loop.quit();
+    });
+    QTimer::singleShot(kReadyTimeoutMs, &loop, &QEventLoop::quit);
+    loop.exec();
+    return pending.isEmpty();
+}
+
+}
+
+void benchStartup(Report& report, const BenchOptions& options) {
+    size_t runs = options.quick ? 3 : 10;
+    QtMessageHandler previous = qInstallMessageHandler(discardMessages);
+
+    std::vector<double> eager, construct, defaultReady, allReady;
+    for (size_t run = 0; run < runs; ++run) {
+        // Each Bridge lives inside its QuietStdout: its workers log until the pools drain.
+        QuietStdout quiet;
+
+        // What the constructor used to do: compile every pack before QML starts.
+        uint64_t start = nowNs();
+        {
+            Engine engine;
+            engine.loadRulesFromFile(std::string(DEEPTHONK_RULES_DIR) + "/en-US.json");
+            engine.loadRulesFromFile(std::string(DEEPTHONK_RULES_DIR) + "/pt-BR.json");
+        }
+        eager.push_back(elapsedMs(start));
+
+        // The window can show its first frame as soon as the Bridge exists.
+        start = nowNs();
+        {
+            Bridge bridge;
+            construct.push_back(elapsedMs(start));
+            if (waitForLocales(bridge, {"en-US"})) defaultReady.push_back(elapsedMs(start));
+        }
+
+        // Selecting the second locale straight away compiles both packs in parallel.
+        start = nowNs();
+        {
+            Bridge bridge;
+            bridge.setLocale("pt-BR");
+            if (waitForLocales(bridge, {"en-US", "pt-BR"})) allReady.push_back(elapsedMs(start));
+        }
+    }
+
+    qInstallMessageHandler(previous);
+
+    auto median = [](std::vector<double>& samples) { return samples.empty() ? 0.0 : summarize(samples).p50; };
+    report.add("startup", "shipped_packs", {{"runs", runs}},
+               {{"eager_load_ms", median(eager)}, {"construct_ms", median(construct)},
+                {"default_ready_ms", median(defaultReady)}, {"all_ready_ms", median(allReady)}});
+}
+
+}
@@ -0,0 +1,505 @@
+#include "Suites.h"
+#include "AllocationTracker.h"
+#include "Corpus.h"
+#include "SyntheticPack.h"
+#include "core/rogerian/Engine.h"
+#include "core/rogerian/Journal.h"
+#include "core/rogerian/Normalizer.h"
+#include "core/utils/WorkStealingPool.h"
+#include <algorithm>
+#include <cctype>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+namespace deep_thonk::bench {
+
+namespace {
+
+const char* const kLocales[] = {"en-US", "pt-BR"};
+
+std::string readShippedPack(const std::string& locale) {
+    std::ifstream input(std::string(DEEPTHONK_RULES_DIR) + "/" + locale + ".json", std::ios::binary);
+    std::stringstream buffer;
+    buffer << input.rdbuf();
+    if (buffer.str().empty()) {
+        std::cerr << "cannot read shipped rule pack " << locale << " from " << DEEPTHONK_RULES_DIR << std::endl;
+    }
+    return buffer.str();
+}
+
+double elapsedMs(uint64_t startNs) {
+    return static_cast<double>(nowNs() - startNs) / 1e6;
+}
+
+bool isFallback(const Response& response) {
+    return response.ruleId.rfind("fallback.", 0) == 0;
+}
+
+// Times respond() call by call over `messages`, after one warm-up pass over a prefix.
+nlohmann::json measureRespond(const Engine& engine, Session& session, const std::vector<std::string>& messages) {
+    for (size_t i = 0; i < std::min<size_t>(messages.size(), 1000); ++i) {
+        engine.respond(session, messages[i]);
+    }
+
+    std::vector<double> samples;
+    samples.reserve(messages.size());
+    size_t fallbacks = 0;
+    for (const auto& message : messages) {
+        uint64_t start = nowNs();
+        Response response = engine.respond(session, message);
+        samples.push_back(static_cast<double>(nowNs() - start));
+        fallbacks += isFallback(response);
+    }
+
+    nlohmann::json metrics = toJson(summarize(samples));
+    metrics["fallback_rate"] = messages.empty() ? 0.0 : static_cast<double>(fallbacks) / static_cast<double>(messages.size());
+    return metrics;
+}
+
+struct HeapUse {
+    double milliseconds = 0;
+    size_t peakBytes = 0;
+    size_t retainedBytes = 0;
+    size_t allocations = 0;
+};
+
+// Runs `work` with allocation tracking on. Whatever it returns stays alive
+// until the heap has been sampled, so "retained" is what the result holds.
+template <typename Work>
+HeapUse measureHeap(Work work) {
+    setAllocationTracking(true);
+    auto before = allocationStats();
+    resetAllocationPeak();
+    uint64_t start = nowNs();
+
+    auto result = work();
+
+    HeapUse use;
+    use.milliseconds = elapsedMs(start);
+    auto after = allocationStats();
+    setAllocationTracking(false);
+
+    use.peakBytes = after.peakBytes - before.currentBytes;
+    use.retainedBytes = after.currentBytes > before.currentBytes ? after.currentBytes - before.currentBytes : 0;
+    use.allocations = after.allocations - before.allocations;
+    return use;
+}
+
+nlohmann::json toJson(const HeapUse& use) {
+    return {{"ms", use.milliseconds}, {"peak_bytes", use.peakBytes}, {"retained_bytes", use.retainedBytes},
+            {"allocations", use.allocations}};
+}
+
+void benchLoaders(Report& report, const std::string& packName, const std::string& jsonContent) {
+    auto path = std::filesystem::temp_directory_path() / "deepThonk3d_bench_rules.json";
+    {
+        std::ofstream file(path, std::ios::binary | std::ios::trunc);
+        file.write(jsonContent.data(), static_cast<std::streamsize>(jsonContent.size()));
+    }
+    nlohmann::json params{{"pack", packName}, {"json_bytes", jsonContent.size()}};
+
+    report.add("loader", "nlohmann_dom", params, toJson(measureHeap([&] { return nlohmann::json::parse(jsonContent); })));
+
+    report.add("loader", "loadRulesFromString", params, toJson(measureHeap([&] {
+        QuietStdout quiet;
+        auto engine = std::make_unique<Engine>();
+        engine->loadRulesFromString(jsonContent);
+        return engine;
+    })));
+
+    report.add("loader", "loadRulesFromFile", params, toJson(measureHeap([&] {
+        QuietStdout quiet;
+        auto engine = std::make_unique<Engine>();
+        engine->loadRulesFromFile(path.string());
+        return engine;
+    })));
+
+    std::filesystem::remove(path);
+}
+
+}
+
+void benchRespondLatency(Report& report, const BenchOptions& options) {
+    size_t count = options.quick ? 2000 : 50000;
+    for (const char* locale : kLocales) {
+        std::vector<std::string> corpus = makeCorpus(locale, count);
+        // The default match cache, then none, so the trend shows what it saves.
+        for (size_t cacheCapacity : {MatchCache::kDefaultCapacity, size_t(0)}) {
+            Engine engine;
+            {
+                QuietStdout quiet;
+                engine.loadRulesFromString(readShippedPack(locale));
+            }
+            engine.setMatchCacheCapacity(cacheCapacity);
+            Session session = engine.createSession(locale);
+            session.rng.seed(1);
+
+            nlohmann::json metrics = measureRespond(engine, session, corpus);
+            InstrumentationSnapshot snapshot = engine.instrumentationSnapshot();
+            metrics["match_cache_hit_rate"] = snapshot.matchCache.hitRate();
+            metrics["match_cache_bytes"] = snapshot.matchCache.bytes;
+            if (kInstrumentationEnabled) {
+                const LocaleStats& stats = snapshot.locales.at(locale);
+                const char* const phaseNames[kPhaseCount] = {"match", "reflect", "template"};
+                for (size_t p = 0; p < kPhaseCount; ++p) {
+                    const PhaseStats& phase = stats.phases[p];
+                    metrics[std::string("phase_") + phaseNames[p] + "_mean_ns"] =
+                        phase.count ? static_cast<double>(phase.totalNs) / static_cast<double>(phase.count) : 0.0;
+                }
+            }
+            report.add("respond", "latency", {{"locale", locale}, {"messages", count}, {"match_cache", cacheCapacity}},
+                       metrics);
+        }
+    }
+}
+
+void benchThroughput(Report& report, const BenchOptions& options) {
+    size_t count = options.quick ? 5000 : 100000;
+    unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> threadCounts;
+    for (unsigned threads = 1; threads < hardwareThreads; threads *= 2) threadCounts.push_back(threads);
+    threadCounts.push_back(hardwareThreads);
+
+    for (const char* locale : kLocales) {
+        Engine engine;
+        {
+            QuietStdout quiet;
+            engine.loadRulesFromString(readShippedPack(locale));
+        }
+        std::vector<std::string> corpus = makeCorpus(locale, count);
+        BatchOptions batch;
+        batch.locale = locale;
+        batch.seed = 42;
+
+        for (unsigned threads : threadCounts) {
+            WorkStealingPool pool(threads);
+            engine.respondBatch(corpus, pool, batch);
+
+            // Best of three, to keep scheduler noise out of the trend line.
+            double bestMs = 0;
+            for (int run = 0; run < 3; ++run) {
+                uint64_t start = nowNs();
+                engine.respondBatch(corpus, pool, batch);
+                double ms = elapsedMs(start);
+                if (run == 0 || ms < bestMs) bestMs = ms;
+            }
+            double perSecond = static_cast<double>(count) / (bestMs / 1e3);
+            report.add("throughput", "respondBatch", {{"locale", locale}, {"threads", threads}, {"messages", count}},
+                       {{"messages_per_second", perSecond}, {"messages_per_second_per_thread", perSecond / threads}});
+        }
+    }
+}
+
+void benchReflect(Report& report, const BenchOptions& options) {
+    size_t count = options.quick ? 2000 : 20000;
+    int repetitions = options.quick ? 5 : 50;
+    for (const char* locale : kLocales) {
+        Engine engine;
+        {
+            QuietStdout quiet;
+            engine.loadRulesFromString(readShippedPack(locale));
+        }
+        std::shared_ptr<const RulePack> pack = engine.getRulePack(locale);
+        std::vector<std::string> captures = makeCorpus(locale, count);
+
+        size_t bytes = 0;
+        for (const auto& capture : captures) bytes += capture.size();
+
+        std::string out;
+        std::vector<double> perCall;
+        for (int run = 0; run < repetitions; ++run) {
+            uint64_t start = nowNs();
+            for (const auto& capture : captures) {
+                out.clear();
+                pack->reflection.reflect(capture, out);
+            }
+            perCall.push_back(static_cast<double>(nowNs() - start) / static_cast<double>(captures.size()));
+        }
+        LatencySummary summary = summarize(perCall);
+
+        report.add("reflect", "reflect", {{"locale", locale}, {"captures", count}, {"runs", repetitions}},
+                   {{"ns_per_call_p50", summary.p50}, {"ns_per_call_min", summary.min},
+                    {"mb_per_second", static_cast<double>(bytes) / summary.p50 / static_cast<double>(captures.size()) * 1e3}});
+    }
+}
+
+void benchNormalize(Report& report, const BenchOptions& options) {
+    size_t count = options.quick ? 2000 : 20000;
+    int repetitions = options.quick ? 5 : 50;
+    for (const char* locale : kLocales) {
+        std::vector<std::string> messages = makeCorpus(locale, count);
+
+        NormalizedText text;
+        std::vector<double> perMessage;
+        for (int run = 0; run < repetitions; ++run) {
+            uint64_t start = nowNs();
+            for (const auto& message : messages) {
+                normalize(message, text);
+            }
+            perMessage.push_back(static_cast<double>(nowNs() - start) / static_cast<double>(messages.size()));
+        }
+        LatencySummary unicode = summarize(perMessage);
+
+        // Byte-wise ::tolower and an [a-zA-Z'] tokenizer into reused buffers.
+        std::string lowered;
+        std::vector<std::pair<uint32_t, uint32_t>> words;
+        perMessage.clear();
+        for (int run = 0; run < repetitions; ++run) {
+            uint64_t start = nowNs();
+            for (const auto& message : messages) {
+                lowered.clear();
+                words.clear();
+                bool inWord = false;
+                uint32_t wordBegin = 0;
+                for (size_t i = 0; i < message.size(); ++i) {
+                    auto c = static_cast<unsigned char>(message[i]);
+                    bool word = std::isalpha(c) || c == '\'';
+                    if (word != inWord) {
+                        if (word) {
+                            wordBegin = static_cast<uint32_t>(i);
+                        } else {
+                            words.emplace_back(wordBegin, static_cast<uint32_t>(i));
+                        }
+                        inWord = word;
+                    }
+                    lowered += static_cast<char>(std::tolower(c));
+                }
+                if (inWord) words.emplace_back(wordBegin, static_cast<uint32_t>(message.size()));
+            }
+            perMessage.push_back(static_cast<double>(nowNs() - start) / static_cast<double>(messages.size()));
+        }
+        LatencySummary ascii = summarize(perMessage);
+
+        report.add("normalize", "normalize", {{"locale", locale}, {"messages", count}, {"runs", repetitions}},
+                   {{"ns_per_message_p50", unicode.p50}, {"ns_per_message_min", unicode.min},
+                    {"ascii_ns_per_message_p50", ascii.p50}, {"ascii_ns_per_message_min", ascii.min},
+                    {"cost_ratio", unicode.p50 / ascii.p50}});
+    }
+}
+
+void benchLoader(Report& report, const BenchOptions& options) {
+    for (const char* locale : kLocales) {
+        benchLoaders(report, locale, readShippedPack(locale));
+    }
+
+    std::vector<size_t> ruleCounts = options.quick ? std::vector<size_t>{1000} : std::vector<size_t>{1000, 10000, 50000};
+    for (size_t ruleCount : ruleCounts) {
+        benchLoaders(report, "synthetic-" + std::to_string(ruleCount), makeSyntheticPack("en-US", ruleCount).json);
+    }
+}
+
+void benchMatcherScaling(Report& report, const BenchOptions& options) {
+    std::vector<size_t> ruleCounts = options.quick ? std::vector<size_t>{10, 100, 1000}
+                                                   : std::vector<size_t>{10, 100, 1000, 10000, 100000};
+    size_t messageCount = options.quick ? 1000 : 10000;
+
+    // Prefilter alone on the shipped packs: how many regex runs it saves on
+    // realistic input, and what the literal scan costs per message.
+    for (const char* locale : kLocales) {
+        Engine engine;
+        {
+            QuietStdout quiet;
+            engine.loadRulesFromString(readShippedPack(locale));
+        }
+        std::shared_ptr<const RulePack> pack = engine.getRulePack(locale);
+        std::vector<std::string> corpus = makeCorpus(locale, messageCount);
+        std::vector<uint32_t> candidates;
+        size_t candidateTotal = 0;
+        uint64_t start = nowNs();
+        for (const auto& message : corpus) {
+            candidates.clear();
+            pack->matcher.collectCandidates(message, candidates);
+            candidateTotal += candidates.size();
+        }
+        double scanNs = static_cast<double>(nowNs() - start) / static_cast<double>(corpus.size());
+
+        report.add("matcher", "prefilter", {{"locale", locale}, {"rules", pack->rules.size()}, {"messages", corpus.size()}},
+                   {{"scan_ns_per_message", scanNs},
+                    {"candidates_mean", static_cast<double>(candidateTotal) / static_cast<double>(corpus.size())},
+                    {"regex_skip_rate", 1.0 - static_cast<double>(candidateTotal) /
+                                                  static_cast<double>(corpus.size() * pack->rules.size())}});
+    }
+
+    for (const char* locale : kLocales) {
+        for (size_t ruleCount : ruleCounts) {
+            SyntheticPack synthetic = makeSyntheticPack(locale, ruleCount);
+
+            Engine engine;
+            uint64_t start = nowNs();
+            {
+                QuietStdout quiet;
+                engine.loadRulesFromString(synthetic.json);
+            }
+            double loadMs = elapsedMs(start);
+
+            // Half the messages hit a specific rule, half only the catch-all.
+            std::vector<std::string> corpus = makeCorpus(locale, messageCount / 2);
+            std::mt19937 rng(7);
+            size_t probeCount = synthetic.probes.empty() ? 0 : messageCount - corpus.size();
+            for (size_t i = 0; i < probeCount; ++i) {
+                corpus.push_back(synthetic.probes[rng() % synthetic.probes.size()]);
+            }
+            std::shuffle(corpus.begin(), corpus.end(), rng);
+
+            std::shared_ptr<const RulePack> pack = engine.getRulePack(locale);
+            std::vector<uint32_t> candidates;
+            size_t candidateTotal = 0;
+            for (const auto& message : corpus) {
+                candidates.clear();
+                pack->matcher.collectCandidates(message, candidates);
+                candidateTotal += candidates.size();
+            }
+
+            Session session = engine.createSession(locale);
+            session.rng.seed(1);
+            nlohmann::json metrics = measureRespond(engine, session, corpus);
+            metrics["load_ms"] = loadMs;
+            metrics["candidates_mean"] = static_cast<double>(candidateTotal) / static_cast<double>(corpus.size());
+            metrics["regex_skip_rate"] =
+                1.0 - static_cast<double>(candidateTotal) / static_cast<double>(corpus.size() * pack->rules.size());
+
+            report.add("matcher", "scaling", {{"locale", locale}, {"rules", ruleCount}, {"messages", corpus.size()}}, metrics);
+        }
+    }
+}
+
+void benchLongInput(Report& report, const BenchOptions& options) {
+    std::vector<size_t> sizes = options.quick ? std::vector<size_t>{1000, 10000} : std::vector<size_t>{1000, 10000, 100000};
+    int runs = options.quick ? 3 : 10;
+    for (const char* locale : kLocales) {
+        // One engine without a step budget, for the full matching cost, and
+        // one with the default budget, to see which pastes it cuts short.
+        Engine unlimited;
+        Engine budgeted;
+        {
+            QuietStdout quiet;
+            unlimited.loadRulesFromString(readShippedPack(locale));
+            budgeted.loadRulesFromString(readShippedPack(locale));
+        }
+        unlimited.setMatchBudget(Matcher::kUnlimitedSteps);
+        Session unlimitedSession = unlimited.createSession(locale, 1);
+        Session budgetedSession = budgeted.createSession(locale, 1);
+        std::vector<std::string> corpus = makeCorpus(locale, 5000);
+
+        for (size_t bytes : sizes) {
+            // A paste: chat messages run together into one long message.
+            std::string paste;
+            for (size_t i = 0; paste.size() < bytes; ++i) {
+                paste += corpus[i % corpus.size()];
+                paste += ' ';
+            }
+
+            std::vector<double> samples;
+            std::vector<double> budgetedSamples;
+            for (int run = 0; run < runs; ++run) {
+                uint64_t start = nowNs();
+                unlimited.respond(unlimitedSession, paste);
+                samples.push_back(static_cast<double>(nowNs() - start));
+                start = nowNs();
+                budgeted.respond(budgetedSession, paste);
+                budgetedSamples.push_back(static_cast<double>(nowNs() - start));
+            }
+            LatencySummary summary = summarize(samples);
+            nlohmann::json metrics = toJson(summary);
+            metrics["ns_per_byte"] = summary.mean / static_cast<double>(paste.size());
+            metrics["budgeted_mean_ns"] = summarize(budgetedSamples).mean;
+            metrics["budgeted_out_of_budget"] = budgeted.instrumentationSnapshot().matchBudgetExhausted > 0;
+            report.add("longinput", "respond", {{"locale", locale}, {"bytes", paste.size()}}, metrics);
+        }
+    }
+}
+
+void benchJournal(Report& report, const BenchOptions& options) {
+    size_t count = options.quick ? 2000 : 20000;
+    size_t syncedCount = options.quick ? 100 : 500;
+    const char* locale = "en-US";
+
+    Engine engine;
+    {
+        QuietStdout quiet;
+        engine.loadRulesFromString(readShippedPack(locale));
+    }
+    Session session = engine.createSession(locale, 1);
+    std::vector<std::string> inputs = makeCorpus(locale, count);
+    std::vector<Response> responses;
+    uint64_t start = nowNs();
+    for (const auto& input : inputs) {
+        responses.push_back(engine.respond(session, input));
+    }
+    double respondNs = static_cast<double>(nowNs() - start) / static_cast<double>(count);
+
+    std::filesystem::path path = std::filesystem::temp_directory_path() / "deepthonk_bench.dtjournal";
+    auto appendAll = [&](JournalWriter& writer, size_t limit, bool flushEach) {
+        for (size_t i = 0; i < limit; ++i) {
+            JournalRecord record;
+            record.timestampMs = 1700000000000 + i;
+            record.templateIndex = responses[i].templateIndex;
+            record.input = inputs[i];
+            record.ruleId = responses[i].ruleId;
+            record.reply = responses[i].text;
+            writer.append(record);
+            if (flushEach) writer.flush();
+        }
+        writer.flush();
+    };
+
+    // Group commit: appends only buffer; the commit thread fsyncs in batches.
+    std::filesystem::remove(path);
+    JournalWriter grouped;
+    grouped.open(path.string());
+    start = nowNs();
+    appendAll(grouped, count, false);
+    double groupedNs = static_cast<double>(nowNs() - start) / static_cast<double>(count);
+    uint64_t groupedSyncs = grouped.syncCount();
+    grouped.close();
+    auto bytes = static_cast<double>(std::filesystem::file_size(path));
+
+    // One fsync per exchange, for comparison.
+    std::filesystem::path syncedPath = path;
+    syncedPath += ".synced";
+    std::filesystem::remove(syncedPath);
+    JournalWriter synced;
+    synced.open(syncedPath.string());
+    start = nowNs();
+    appendAll(synced, syncedCount, true);
+    double syncedNs = static_cast<double>(nowNs() - start) / static_cast<double>(syncedCount);
+    synced.close();
+    std::filesystem::remove(syncedPath);
+
+    report.add("journal", "append", {{"locale", locale}, {"exchanges", count}},
+               {{"ns_per_exchange", groupedNs}, {"fsyncs", groupedSyncs},
+                {"bytes_per_exchange", bytes / static_cast<double>(count)},
+                {"fsync_each_ns_per_exchange", syncedNs}});
+
+    // Replay: history and hit counts straight from the map, against
+    // answering every input again.
+    JournalReader reader;
+    reader.open(path.string());
+    std::unordered_map<std::string, uint64_t> hits;
+    size_t replayed = 0;
+    start = nowNs();
+    JournalRecord record;
+    while (reader.next(record)) {
+        ++hits[std::string(record.ruleId)];
+        ++replayed;
+    }
+    double replayNs = static_cast<double>(nowNs() - start) / static_cast<double>(std::max<size_t>(replayed, 1));
+    reader.close();
+
+    std::ostringstream exported;
+    start = nowNs();
+    exportJournal(path.string(), exported, JournalFormat::Json);
+    double exportNs = static_cast<double>(nowNs() - start) / static_cast<double>(count);
+    std::filesystem::remove(path);
+
+    report.add("journal", "replay", {{"locale", locale}, {"exchanges", replayed}},
+               {{"ns_per_exchange", replayNs}, {"respond_ns_per_exchange", respondNs},
+                {"json_export_ns_per_exchange", exportNs}});
+}
+
+}
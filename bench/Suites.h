@@ -0,0 +1,39 @@
+#ifndef DEEPTHONK3D_BENCH_SUITES_H
+#define DEEPTHONK3D_BENCH_SUITES_H
+
+#include "Harness.h"
+
+namespace deep_thonk::bench {
+
+    // Per-call respond() latency on the shipped packs, with the default match
+    // cache and without one, plus its hit rate and size.
+    void benchRespondLatency(Report& report, const BenchOptions& options);
+    // respondBatch() messages per second, in total and per participating thread.
+    void benchThroughput(Report& report, const BenchOptions& options);
+    // ReflectionTable::reflect() cost per capture.
+    void benchReflect(Report& report, const BenchOptions& options);
+    // normalize() per message, next to the ASCII-only lower-case and
+    // [a-zA-Z'] word split it replaced.
+    void benchNormalize(Report& report, const BenchOptions& options);
+    // Time and heap of the rule loaders, next to a plain DOM parse.
+    void benchLoader(Report& report, const BenchOptions& options);
+    // Load time and respond() latency as synthetic packs grow from 10 to 100k rules.
+    void benchMatcherScaling(Report& report, const BenchOptions& options);
+    // respond() on pasted messages of 1k to 100k bytes, with and without the
+    // default match step budget.
+    void benchLongInput(Report& report, const BenchOptions& options);
+    // Journal append cost with group commit against an fsync per exchange,
+    // and replaying the journal against answering every input again.
+    void benchJournal(Report& report, const BenchOptions& options);
+    // Cost of one RuleModel hit update as the rule tree grows.
+    void benchRuleModel(Report& report, const BenchOptions& options);
+    // Appending to the chat transcript as it grows to 100k messages: ChatModel
+    // against rebuilding one string per message, as the TextArea did.
+    void benchChatHistory(Report& report, const BenchOptions& options);
+    // Time until the window can draw (Bridge constructed) and until the
+    // shipped packs are compiled in the background, against eager loading.
+    void benchStartup(Report& report, const BenchOptions& options);
+
+}
+
+#endif //DEEPTHONK3D_BENCH_SUITES_H
@@ -0,0 +1,96 @@
+#include "SyntheticPack.h"
+#include <random>
+#include <vector>
+
+namespace deep_thonk::bench {
+
+namespace {
+
+struct Vocabulary {
+    std::vector<std::string> anchors;
+    std::vector<std::string> topics;
+    std::vector<std::string> outs;
+    std::vector<std::pair<std::string, std::string>> reflect;
+    std::string fallbackCategory;
+};
+
+const Vocabulary& vocabulary(const std::string& locale) {
+    static const Vocabulary en{
+        {"I feel", "I think", "I am", "I can't", "I want", "my", "you are", "why do", "I remember", "I dream"},
+        {"work", "mother", "father", "friends", "sleep", "school", "money", "future", "health", "home", "love", "time"},
+        {"Tell me more about {1}.", "Why do you say {1}?", "How does {1} make you feel?", "What else comes to mind?"},
+        {{"i", "you"}, {"my", "your"}, {"me", "you"}, {"am", "are"}, {"you", "i"}, {"your", "my"}, {"are", "am"}},
+        "General",
+    };
+    static const Vocabulary pt{
+        {"eu sinto", "eu acho", "eu sou", "não consigo", "eu quero", "minha", "você é", "por que", "eu lembro", "eu sonho"},
+        {"trabalho", "mãe", "pai", "amigos", "sono", "escola", "dinheiro", "futuro", "saúde", "casa", "amor", "tempo"},
+        {"Fale mais sobre {1}.", "Por que você diz {1}?", "Como {1} faz você se sentir?", "O que mais vem à mente?"},
+        {{"eu", "você"}, {"meu", "seu"}, {"minha", "sua"}, {"mim", "você"}, {"sou", "é"}},
+        "Geral",
+    };
+    return locale == "pt-BR" ? pt : en;
+}
+
+void appendJsonString(std::string& out, const std::string& value) {
+    out += '"';
+    for (char c : value) {
+        if (c == '"' || c == '\\') out += '\\';
+        out += c;
+    }
+    out += '"';
+}
+
+}
+
+SyntheticPack makeSyntheticPack(const std::string& locale, size_t ruleCount, uint32_t seed) {
+    const Vocabulary& words = vocabulary(locale);
+    std::mt19937 rng(seed);
+    auto pick = [&rng](const std::vector<std::string>& list) -> const std::string& {
+        return list[std::uniform_int_distribution<size_t>(0, list.size() - 1)(rng)];
+    };
+
+    SyntheticPack pack;
+    std::string& json = pack.json;
+    json = "{\"locale\":";
+    appendJsonString(json, locale);
+    json += ",\"reflect\":[";
+    for (size_t i = 0; i < words.reflect.size(); ++i) {
+        json += i ? ",[" : "[";
+        appendJsonString(json, words.reflect[i].first);
+        json += ',';
+        appendJsonString(json, words.reflect[i].second);
+        json += ']';
+    }
+    json += "],\"rules\":[";
+
+    pack.probes.reserve(ruleCount);
+    for (size_t i = 0; i < ruleCount; ++i) {
+        bool fallback = i + 1 == ruleCount;
+        std::string pattern = "(.+)";
+        if (!fallback) {
+            const std::string& anchor = pick(words.anchors);
+            const std::string& topic = pick(words.topics);
+            const std::string& other = pick(words.topics);
+            pattern = anchor + "\\s+(?:" + topic + "|" + other + ")\\s+" + std::to_string(i) + "\\s+(.*)";
+            pack.probes.push_back(anchor + " " + topic + " " + std::to_string(i) + " " + pick(words.topics));
+        }
+
+        json += i ? ",{" : "{";
+        json += "\"id\":";
+        appendJsonString(json, (fallback ? "fallback." : "synthetic.") + std::to_string(i));
+        json += ",\"category\":";
+        appendJsonString(json, fallback ? words.fallbackCategory : "Category" + std::to_string(i % 40));
+        json += ",\"pattern\":";
+        appendJsonString(json, pattern);
+        json += ",\"outs\":[";
+        appendJsonString(json, pick(words.outs));
+        json += ',';
+        appendJsonString(json, pick(words.outs));
+        json += "]}";
+    }
+    json += "]}";
+    return pack;
+}
+
+}
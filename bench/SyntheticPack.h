@@ -0,0 +1,24 @@
+#ifndef DEEPTHONK3D_BENCH_SYNTHETICPACK_H
+#define DEEPTHONK3D_BENCH_SYNTHETICPACK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace deep_thonk::bench {
+
+    struct SyntheticPack {
+        std::string json;
+        // One message per rule that only that rule (and the catch-all) matches.
+        std::vector<std::string> probes;
+    };
+
+    // A rule pack of `ruleCount` rules in the shape of the shipped packs
+    // (anchor phrase, alternation, capture) ending in a catch-all rule.
+    // Deterministic for a given seed. `locale` is "en-US" or "pt-BR".
+    SyntheticPack makeSyntheticPack(const std::string& locale, size_t ruleCount, uint32_t seed = 1);
+
+}
+
+#endif //DEEPTHONK3D_BENCH_SYNTHETICPACK_H
@@ -0,0 +1,80 @@
+// deepThonk3d_bench: rule engine benchmark suite.
+//
+//   deepThonk3d_bench [--quick] [--filter <suite>] [--json <out.json>]
+//
+// Suites: respond, throughput, reflect, normalize, loader, matcher, longinput, journal, model, chat, startup. Every result is
+// printed as it is measured; --json also writes the full report, with
+// compiler and build type, for tracking regressions across commits.
+
+#include "Harness.h"
+#include "Suites.h"
+#include <QCoreApplication>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+namespace {
+
+using namespace deep_thonk::bench;
+
+struct Suite {
+    const char* name;
+    void (*run)(Report&, const BenchOptions&);
+};
+
+const Suite kSuites[] = {
+    {"respond", benchRespondLatency},
+    {"throughput", benchThroughput},
+    {"reflect", benchReflect},
+    {"normalize", benchNormalize},
+    {"loader", benchLoader},
+    {"matcher", benchMatcherScaling},
+    {"longinput", benchLongInput},
+    {"journal", benchJournal},
+    {"model", benchRuleModel},
+    {"chat", benchChatHistory},
+    {"startup", benchStartup},
+};
+
+}
+
+int main(int argc, char *argv[])
+{
+    // The startup suite constructs a Bridge, which reads the packs from the resources.
+    Q_INIT_RESOURCE(resources);
+
+    // The model and startup suites need an event loop.
+    QCoreApplication app(argc, argv);
+
+    BenchOptions options;
+    std::string jsonPath;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--quick") == 0) {
+            options.quick = true;
+        } else if (std::strcmp(argv[i], "--filter") == 0 && i + 1 < argc) {
+            options.filter = argv[++i];
+        } else if (std::strcmp(argv[i], "--json") == 0 && i + 1 < argc) {
+            jsonPath = argv[++i];
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--quick] [--filter <suite>] [--json <out.json>]" << std::endl;
+            return 2;
+        }
+    }
+
+    Report report;
+    for (const Suite& suite : kSuites) {
+        if (options.filter.empty() || std::string(suite.name).find(options.filter) != std::string::npos) {
+            suite.run(report, options);
+        }
+    }
+
+    if (!jsonPath.empty()) {
+        std::ofstream output(jsonPath, std::ios::trunc);
+        output << report.toJson(options).dump(2) << std::endl;
+        if (!output) {
+            std::cerr << "cannot write " << jsonPath << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,55 @@
+// libFuzzer target for the rule pattern engine (src/core/rogerian/Regex.h).
+//
+// Input: a pattern, a NUL byte, then the text to search. Any pattern that
+// compiles must search `text` within Regex::stepBound(text.size()) steps,
+// report captures inside the text, and give the same outcome under a budget
+// of exactly the steps it used, and OutOfBudget under one step less.
+
+#include "../src/core/rogerian/Regex.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+namespace {
+
+void check(bool condition) {
+    if (!condition) std::abort();
+}
+
+}
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size) {
+    std::string_view input(reinterpret_cast<const char*>(data), size);
+    size_t split = input.find('\0');
+    if (split == std::string_view::npos) return 0;
+    std::string_view pattern = input.substr(0, split);
+    std::string_view text = input.substr(split + 1);
+
+    deep_thonk::Regex regex;
+    if (!regex.compile(pattern)) return 0;
+
+    std::vector<deep_thonk::CaptureSpan> captures;
+    uint64_t budget = UINT64_MAX;
+    deep_thonk::Regex::Outcome outcome = regex.search(text, captures, budget);
+    uint64_t steps = UINT64_MAX - budget;
+    check(outcome != deep_thonk::Regex::Outcome::OutOfBudget);
+    check(steps <= regex.stepBound(text.size()));
+
+    if (outcome == deep_thonk::Regex::Outcome::Match) {
+        check(captures.size() == regex.groupCount() + 1);
+        check(captures[0].matched());
+        for (const auto& span : captures) {
+            check(!span.matched() || (span.begin <= span.end && span.end <= text.size()));
+        }
+    }
+
+    budget = steps;
+    check(regex.search(text, captures, budget) == outcome && budget == 0);
+    if (steps > 0) {
+        budget = steps - 1;
+        check(regex.search(text, captures, budget) == deep_thonk::Regex::Outcome::OutOfBudget);
+    }
+    return 0;
+}
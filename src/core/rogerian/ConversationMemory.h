@@ -0,0 +1,84 @@
+#ifndef DEEPTHONK3D_CONVERSATIONMEMORY_H
+#define DEEPTHONK3D_CONVERSATIONMEMORY_H
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace deep_thonk {
+
+    // The last few turns of a conversation: which rule answered and what it
+    // captured, kept in a fixed ring inside the Session. Nothing here ever
+    // allocates, so a session costs the same number of bytes however long it
+    // runs, and copying one is a memcpy.
+    //
+    // A turn answered by a rule with memory outs is left pending. When a
+    // later message matches nothing, Engine::respond answers the oldest
+    // pending turn from the same pack instead of a neutral probe (ELIZA's
+    // memory queue). Once the ring wraps, the oldest turns are forgotten,
+    // pending or not.
+    class ConversationMemory {
+    public:
+        static constexpr size_t kTurns = 8;
+        // Longer captures are cut at a UTF-8 character boundary.
+        static constexpr size_t kCaptureBytes = 96;
+
+        struct Turn {
+            uint64_t packSerial = 0;  // the rule index below belongs to this pack
+            uint32_t rule = 0;
+            uint16_t captureLength = 0;
+            bool pending = false;
+            std::array<char, kCaptureBytes> capture{};
+
+            std::string_view captureText() const { return {capture.data(), captureLength}; }
+        };
+
+        void record(uint64_t packSerial, uint32_t rule, std::string_view capture, bool pending) {
+            Turn& turn = m_turns[(m_first + m_size) % kTurns];
+            if (m_size < kTurns) ++m_size;
+            else m_first = static_cast<uint32_t>((m_first + 1) % kTurns);
+
+            if (capture.size() > kCaptureBytes) {
+                size_t cut = kCaptureBytes;
+                while (cut > 0 && (static_cast<unsigned char>(capture[cut]) & 0xC0) == 0x80) --cut;
+                capture = capture.substr(0, cut);
+            }
+            turn.packSerial = packSerial;
+            turn.rule = rule;
+            turn.captureLength = static_cast<uint16_t>(capture.size());
+            turn.pending = pending;
+            std::copy(capture.begin(), capture.end(), turn.capture.begin());
+        }
+
+        // The oldest pending turn recorded under `packSerial`, which stops
+        // being pending.
+        std::optional<Turn> takePending(uint64_t packSerial) {
+            for (size_t age = m_size; age-- > 0;) {
+                Turn& turn = m_turns[(m_first + m_size - 1 - age) % kTurns];
+                if (turn.pending && turn.packSerial == packSerial) {
+                    turn.pending = false;
+                    return turn;
+                }
+            }
+            return std::nullopt;
+        }
+
+        size_t size() const { return m_size; }
+        // recent(0) is the latest turn; `age` must be below size().
+        const Turn& recent(size_t age) const { return m_turns[(m_first + m_size - 1 - age) % kTurns]; }
+        void clear() {
+            m_first = 0;
+            m_size = 0;
+        }
+
+    private:
+        std::array<Turn, kTurns> m_turns{};
+        uint32_t m_first = 0; // oldest turn
+        uint32_t m_size = 0;
+    };
+
+}
+
+#endif //DEEPTHONK3D_CONVERSATIONMEMORY_H
@@ -1,138 +1,500 @@
 #include "Engine.h"
-#include "../../third_party/nlohmann/json.hpp"
+#include "Normalizer.h"
+#include "PackFile.h"
+#include "RuleLoader.h"
+#include "Template.h"
+#include "../utils/MappedFile.h"
+#include "../utils/WorkStealingPool.h"
+#include <algorithm>
 #include <fstream>
 #include <iostream>
-#include <regex>
 #include <random>
-
-using json = nlohmann::json;
+#include <stdexcept>
+#include <unordered_map>
 
 namespace deep_thonk {
 
-Engine::Engine() {
-    // Seed for random number generation
-    srand(time(0));
+namespace {
+
+// Draws one of `rule`'s templates under its selection policy. `excluded` is
+// left out of the draw unless it is the only template with any weight.
+uint32_t drawTemplate(Session& session, const RulePack& pack, const Rule& rule, uint32_t excluded) {
+    uint32_t count = rule.templateCount;
+    if (!(rule.selection & kSelectWeighted)) {
+        if (excluded >= count) return session.rng.below(count);
+        uint32_t pick = session.rng.below(count - 1);
+        return pick >= excluded ? pick + 1 : pick;
+    }
+
+    std::span<const RuleTemplate> outs = pack.outs(rule);
+    auto total = static_cast<uint32_t>(pack.totalWeight(rule));
+    if (excluded < count && outs[excluded].weight < total) total -= outs[excluded].weight;
+    else excluded = count;
+
+    uint32_t ticket = session.rng.below(total);
+    for (uint32_t i = 0; i < count; ++i) {
+        if (i == excluded) continue;
+        if (ticket < outs[i].weight) return i;
+        ticket -= outs[i].weight;
+    }
+    return count - 1; // unreachable: the weights sum to `total`
+}
+
+// The next recorded choice when replaying, or `count` when there is none.
+uint32_t replayedChoice(ChoiceLog& log, uint32_t count) {
+    if (log.mode == ChoiceLog::Mode::Replay && log.cursor < log.choices.size()) {
+        return log.choices[log.cursor++];
+    }
+    return count;
+}
+
+void logChoice(ChoiceLog& log, uint32_t choice) {
+    if (log.mode == ChoiceLog::Mode::Record) {
+        log.choices.push_back(choice);
+    }
+}
+
+// Picks the template for a reply from `ruleIndex`: the next recorded choice
+// when replaying, otherwise a draw, which is logged when recording.
+uint32_t pickTemplate(Session& session, const RulePack& pack, uint32_t ruleIndex) {
+    const Rule& rule = pack.rules[ruleIndex];
+
+    auto last = std::find_if(session.lastTemplates.begin(), session.lastTemplates.end(),
+                             [ruleIndex](const auto& entry) { return entry.first == ruleIndex; });
+
+    uint32_t choice = replayedChoice(session.log, rule.templateCount);
+    if (choice >= rule.templateCount) {
+        bool noRepeat = (rule.selection & kSelectNoRepeat) && rule.templateCount > 1;
+        uint32_t excluded = noRepeat && last != session.lastTemplates.end() ? last->second : rule.templateCount;
+        choice = drawTemplate(session, pack, rule, excluded);
+    }
+    logChoice(session.log, choice);
+
+    if (rule.selection & kSelectNoRepeat) {
+        if (last != session.lastTemplates.end()) {
+            last->second = choice;
+        } else {
+            session.lastTemplates.emplace_back(ruleIndex, choice);
+        }
+    }
+    return choice;
+}
+
+// Same for one of `rule`'s memory outs, drawn uniformly.
+uint32_t pickMemory(Session& session, const Rule& rule) {
+    uint32_t choice = replayedChoice(session.log, rule.memoryCount);
+    if (choice >= rule.memoryCount) choice = session.rng.below(rule.memoryCount);
+    logChoice(session.log, choice);
+    return choice;
+}
+
+// Fills a memory out with the capture kept from an earlier turn.
+std::string renderMemory(const RulePack& pack, const RuleTemplate& tmpl, std::string_view capture) {
+    std::string_view source = pack.str(tmpl.text);
+    if (!tmpl.hasCaptures) return std::string(source);
+
+    std::string text;
+    text.reserve(tmpl.literalLength + capture.size() + capture.size() / 2);
+    for (const auto& part : pack.parts(tmpl)) {
+        if (part.slot == 0) {
+            text.append(source.substr(part.offset, part.length));
+        } else {
+            pack.reflection.reflect(capture, text);
+        }
+    }
+    return text;
+}
+
+// SplitMix64 finaliser; turns (seed, index) into well-spread per-message seeds.
+uint64_t mixSeed(uint64_t seed, uint64_t index) {
+    uint64_t z = seed + (index + 1) * 0x9e3779b97f4a7c15ull;
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ull;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebull;
+    return z ^ (z >> 31);
+}
+
+// The message being answered on this thread, normalised once for both the
+// matcher and reflection.
+thread_local NormalizedText t_input;
+// Its match, fresh from the matcher or copied out of the match cache.
+thread_local MatchResult t_match;
+
+// Hit counts follow rule ids across a reload; new rules start at zero.
+void carryOverHits(const RulePack& from, RulePack& to) {
+    std::unordered_map<std::string_view, uint64_t> hits;
+    hits.reserve(from.rules.size());
+    for (const auto& rule : from.rules) {
+        hits.emplace(from.str(rule.id), rule.hits.load());
+    }
+    for (auto& rule : to.rules) {
+        auto it = hits.find(to.str(rule.id));
+        if (it != hits.end()) {
+            rule.hits.value.store(it->second, std::memory_order_relaxed);
+        }
+    }
+}
+
+// Prefers the precompiled blob when it was built from exactly this JSON.
+std::string compilePack(const std::string& blobPath, const std::string& jsonContent, RulePack& pack, bool& usedBlob) {
+    MappedFile file;
+    std::string locale;
+    usedBlob = !blobPath.empty() && file.open(blobPath) &&
+               readPackFile(file.data(), file.size(), hashRuleSource(jsonContent), locale, pack);
+    if (usedBlob) return locale;
+
+    pack = RulePack();
+    return parseRulePack(jsonContent, pack);
+}
+
 }
 
 void Engine::loadRulesFromString(const std::string& jsonContent) {
-    json data = json::parse(jsonContent);
-    
-    std::string localeStr = data["locale"];
     RulePack pack;
-    if (localeStr == "en-US") {
-        pack.locale = Locale::EN_US;
-    } else if (localeStr == "pt-BR") {
-        pack.locale = Locale::PT_BR;
+    std::string locale = parseRulePack(jsonContent, pack);
+    installPack(locale, std::move(pack));
+    std::cout << "Loaded rules for locale: " << locale << std::endl;
+}
+
+void Engine::loadRulesFromStream(std::istream& input, size_t sizeHint) {
+    RulePack pack;
+    std::string locale = parseRulePack(input, pack, sizeHint);
+    installPack(locale, std::move(pack));
+    std::cout << "Loaded rules for locale: " << locale << std::endl;
+}
+
+bool Engine::loadRulesFromFile(const std::string& path) {
+    std::ifstream input(path, std::ios::binary | std::ios::ate);
+    if (!input) {
+        std::cerr << "Cannot open rule file: " << path << std::endl;
+        return false;
     }
+    auto size = static_cast<size_t>(input.tellg());
+    input.seekg(0);
+    loadRulesFromStream(input, size);
+    return true;
+}
 
-    for (const auto& item : data["reflect"]) {
-        pack.reflectPairs.push_back({item[0], item[1]});
+bool Engine::loadRulesFromBinary(const std::string& path, const std::string& jsonContent) {
+    RulePack pack;
+    bool usedBlob = false;
+    std::string locale = compilePack(path, jsonContent, pack, usedBlob);
+    if (!usedBlob) {
+        std::cerr << "Precompiled rules missing or stale, falling back to JSON: " << path << std::endl;
     }
+    installPack(locale, std::move(pack));
+    std::cout << "Loaded " << (usedBlob ? "precompiled " : "") << "rules for locale: " << locale << std::endl;
+    return usedBlob;
+}
+
+void Engine::addLazyRulePack(const std::string& locale, std::function<PackSource()> source) {
+    m_rulePacks.try_emplace(locale, std::make_shared<PackSlot>(nullptr));
+    auto lazy = std::make_unique<LazyPack>();
+    lazy->source = std::move(source);
+    m_lazyPacks[locale] = std::move(lazy);
+}
+
+bool Engine::ensureLoaded(const std::string& locale) {
+    auto slot = m_rulePacks.find(locale);
+    if (slot == m_rulePacks.end()) return false;
+    if (slot->second->load()) return true;
+
+    auto lazy = m_lazyPacks.find(locale);
+    if (lazy == m_lazyPacks.end()) return false;
+
+    std::lock_guard<std::mutex> loadLock(lazy->second->loadMutex);
+    if (slot->second->load()) return true; // another caller got here first
 
-    for (const auto& item : data["rules"]) {
-        Rule rule;
-        rule.id = item["id"];
-        rule.category = item["category"];
-        rule.patternString = item["pattern"].get<std::string>();
-        rule.pattern = std::regex(rule.patternString, std::regex_constants::icase);
-        for (const auto& out : item["outs"]) {
-            rule.outs.push_back({out.get<std::string>()});
+    RulePack pack;
+    bool usedBlob = false;
+    try {
+        PackSource source = lazy->second->source();
+        std::string loaded = compilePack(source.blobPath, source.jsonContent, pack, usedBlob);
+        if (loaded != locale) {
+            throw std::runtime_error("pack declares locale " + loaded);
         }
-        pack.rules.push_back(rule);
+    } catch (const std::exception& error) {
+        std::cerr << "Cannot load rules for locale " << locale << ": " << error.what() << std::endl;
+        return false;
+    }
+    pack.serial = instrumentation::nextPackSerial();
+
+    std::lock_guard<std::mutex> lock(m_reloadMutex);
+    // A reload may have published a pack while this one compiled; it wins.
+    if (!slot->second->load()) {
+        slot->second->store(std::make_shared<const RulePack>(std::move(pack)));
+        std::cout << "Loaded " << (usedBlob ? "precompiled " : "") << "rules for locale: " << locale << std::endl;
+    }
+    return true;
+}
+
+void Engine::installPack(const std::string& locale, RulePack&& pack) {
+    pack.serial = instrumentation::nextPackSerial();
+    std::lock_guard<std::mutex> lock(m_reloadMutex);
+    auto it = m_rulePacks.find(locale);
+    if (it == m_rulePacks.end()) {
+        m_rulePacks.emplace(locale, std::make_shared<PackSlot>(std::make_shared<const RulePack>(std::move(pack))));
+        return;
+    }
+    if (auto current = it->second->load()) {
+        carryOverHits(*current, pack);
+    }
+    it->second->store(std::make_shared<const RulePack>(std::move(pack)));
+}
+
+std::string Engine::reloadRules(const std::string& jsonContent) {
+    RulePack pack;
+    std::string locale = parseRulePack(jsonContent, pack);
+    // The locale map itself is read without locks, so a reload may only
+    // replace a pack (or fill a declared one), never add a locale.
+    if (m_rulePacks.find(locale) == m_rulePacks.end()) {
+        throw std::runtime_error("cannot reload rules for unloaded locale: " + locale);
+    }
+    size_t ruleCount = pack.rules.size();
+    installPack(locale, std::move(pack));
+    std::cout << "Reloaded " << ruleCount << " rules for locale: " << locale << std::endl;
+    return locale;
+}
+
+std::future<std::string> Engine::reloadRulesAsync(std::string jsonContent) {
+    return std::async(std::launch::async, [this, jsonContent = std::move(jsonContent)] {
+        return reloadRules(jsonContent);
+    });
+}
+
+Session Engine::createSession(const std::string& locale) const {
+    Session session;
+    setLocale(session, locale);
+    return session;
+}
+
+Session Engine::createSession(const std::string& locale, uint64_t seed) const {
+    Session session = createSession(locale);
+    session.rng.seed(seed);
+    return session;
+}
+
+bool Engine::setLocale(Session& session, const std::string& locale) const {
+    auto it = m_rulePacks.find(locale);
+    if (it == m_rulePacks.end()) {
+        session.locale.clear();
+        session.slot.reset();
+        session.pack.reset();
+        session.lastTemplates.clear();
+        return false;
     }
+    session.locale = locale;
+    session.slot = it->second;
+    session.generation = session.slot->generation();
+    session.pack = session.slot->load();
+    session.lastTemplates.clear();
+    return true;
+}
 
-    m_rulePacks[localeStr] = pack;
-    std::cout << "Loaded rules for locale: " << localeStr << std::endl;
+void Engine::refreshPack(Session& session) const {
+    if (!session.slot) return;
+    uint64_t generation = session.slot->generation();
+    if (generation != session.generation) {
+        session.generation = generation;
+        session.pack = session.slot->load();
+        session.lastTemplates.clear(); // rule indices belong to the old pack
+    }
 }
 
 void Engine::setLocale(const std::string& locale) {
-    if (m_rulePacks.count(locale)) {
-        m_activePack = &m_rulePacks[locale];
+    if (setLocale(m_session, locale)) {
         std::cout << "Active locale set to: " << locale << std::endl;
     } else {
         std::cerr << "Locale not found: " << locale << std::endl;
-        m_activePack = nullptr;
     }
 }
 
 deep_thonk::Response Engine::respond(const std::string& userText) {
-    if (!m_activePack) {
+    return respond(m_session, userText);
+}
+
+deep_thonk::Response Engine::respond(Session& session, const std::string& userText) const {
+    refreshPack(session);
+    if (!session.pack) {
         return {"I'm sorry, I don't have any rules loaded to respond.", ""};
     }
+    const RulePack& pack = *session.pack;
+    instrumentation::PackCounters* counters = instrumentation::countersFor(pack);
 
-    Rule* bestRule = nullptr;
-    std::smatch bestMatch;
+    uint64_t matchStart = instrumentation::now();
+    NormalizedText& input = t_input;
+    normalize(userText, input);
+    MatchResult& match = t_match;
+    if (!m_matchCache.lookup(pack.serial, input.text(), match)) {
+        pack.matcher.findBest(pack.rules, input.text(), match, counters, m_matchBudget);
+        if (match.rule != Matcher::kOutOfBudget) m_matchCache.insert(pack.serial, input.text(), match);
+    } else if (counters && match.rule >= 0) {
+        instrumentation::recordCachedMatch(counters, static_cast<size_t>(match.rule));
+    }
+    int bestIndex = match.rule;
+    if (counters) instrumentation::recordPhase(counters, Phase::Match, instrumentation::now() - matchStart);
 
-    for (auto& rule : m_activePack->rules) {
-        std::smatch currentMatch;
-        if (std::regex_search(userText, currentMatch, rule.pattern)) {
-            if (!bestRule || rule.patternString.length() > bestRule->patternString.length()) {
-                bestRule = &rule;
-                bestMatch = currentMatch;
-            }
-        }
+    // Too costly to match: answer without a rule rather than keep the caller waiting.
+    if (bestIndex == Matcher::kOutOfBudget) {
+        m_budgetExhausted.fetch_add(1, std::memory_order_relaxed);
+        if (counters) instrumentation::recordResponse(counters, true);
+        return pickNeutralProbe(session);
     }
 
-    if (bestRule) {
-        bestRule->hits++;
-        std::string captured = bestMatch.size() > 1 ? bestMatch[1].str() : "";
-        int choice = rand() % bestRule->outs.size();
-        std::string responseTemplate = bestRule->outs[choice].text;
+    if (bestIndex >= 0 && pack.rules[bestIndex].templateCount > 0) {
+        const Rule& bestRule = pack.rules[bestIndex];
+        bestRule.hits.increment();
+        if (counters) instrumentation::recordResponse(counters, false);
 
-        if (responseTemplate.find("{1}") != std::string::npos) {
-            std::string reflected = reflect(captured);
-            return {std::regex_replace(responseTemplate, std::regex("\\{1\\}"), reflected), bestRule->id};
+        // Remember the turn with the capture its memory outs refer to, or the
+        // first group for rules without any.
+        uint32_t slot = bestRule.memorySlot != 0 ? bestRule.memorySlot : 1;
+        std::string_view capture;
+        if (slot < match.captures.size() && match.captures[slot].matched()) {
+            capture = input.sourceSlice(match.captures[slot].begin, match.captures[slot].end);
         }
-        
-        return {responseTemplate, bestRule->id};
+        session.memory.record(pack.serial, static_cast<uint32_t>(bestIndex), capture, bestRule.memoryCount > 0);
+
+        uint32_t choice = pickTemplate(session, pack, static_cast<uint32_t>(bestIndex));
+        return {renderTemplate(pack, pack.outs(bestRule)[choice], input, match.captures, counters), std::string(pack.str(bestRule.id)), choice};
     }
 
-    return pickNeutralProbe();
+    if (counters) instrumentation::recordResponse(counters, true);
+    if (auto turn = session.memory.takePending(pack.serial)) {
+        const Rule& rule = pack.rules[turn->rule];
+        uint32_t choice = pickMemory(session, rule);
+        return {renderMemory(pack, pack.memories(rule)[choice], turn->captureText()), std::string(pack.str(rule.id)), choice};
+    }
+    return pickNeutralProbe(session);
 }
 
-std::string Engine::reflect(const std::string& text) {
-    std::string result;
-    std::regex tokenizer("([a-zA-Z']+|[^a-zA-Z']+)");
-    auto words_begin = std::sregex_iterator(text.begin(), text.end(), tokenizer);
-    auto words_end = std::sregex_iterator();
+std::vector<Response> Engine::respondBatch(std::span<const std::string> messages, const BatchOptions& options) const {
+    WorkStealingPool pool(options.threads);
+    return respondBatch(messages, pool, options);
+}
 
-    std::map<std::string, std::string> reflectionMap;
-    for(const auto& pair : m_activePack->reflectPairs) {
-        std::string key = pair.first;
-        std::transform(key.begin(), key.end(), key.begin(), ::tolower);
-        reflectionMap[key] = pair.second;
+std::vector<Response> Engine::respondBatch(std::span<const std::string> messages, WorkStealingPool& pool, const BatchOptions& options) const {
+    Session prototype = m_session;
+    if (!options.locale.empty()) {
+        setLocale(prototype, options.locale);
     }
+    prototype.log = {};
+    uint64_t seed = options.seed ? *options.seed : (static_cast<uint64_t>(std::random_device{}()) << 32) ^ std::random_device{}();
 
-    for (std::sregex_iterator i = words_begin; i != words_end; ++i) {
-        std::string token = i->str();
-        std::string lower_token = token;
-        std::transform(lower_token.begin(), lower_token.end(), lower_token.begin(), ::tolower);
+    std::vector<Response> results(messages.size());
+    pool.parallelFor(messages.size(), 64, [&](size_t begin, size_t end) {
+        Session session = prototype;
+        for (size_t i = begin; i < end; ++i) {
+            // Nothing carries over between messages, so chunking cannot change the output.
+            session.rng.seed(mixSeed(seed, i));
+            session.lastTemplates.clear();
+            session.memory.clear();
+            results[i] = respond(session, messages[i]);
+        }
+    });
+    return results;
+}
 
-        auto it = reflectionMap.find(lower_token);
-        if (it != reflectionMap.end()) {
-            result += it->second;
-        } else {
-            result += token;
+std::string Engine::renderTemplate(const RulePack& pack, const RuleTemplate& tmpl, const NormalizedText& input,
+                                   std::span<const CaptureSpan> captures, instrumentation::PackCounters* counters) const {
+    uint64_t renderStart = instrumentation::now();
+    std::string_view source = pack.str(tmpl.text);
+    if (!tmpl.hasCaptures) {
+        std::string text(source);
+        if (counters) instrumentation::recordPhase(counters, Phase::Template, instrumentation::now() - renderStart);
+        return text;
+    }
+
+    uint64_t reflectNs = 0;
+
+    std::span<const TemplatePart> parts = pack.parts(tmpl);
+    size_t capturedLength = 0;
+    for (const auto& part : parts) {
+        if (part.slot != 0 && part.slot < captures.size() && captures[part.slot].matched()) {
+            capturedLength += captures[part.slot].length();
         }
     }
 
-    return result;
+    // Reflection rarely grows a capture by more than half (e.g. "i" -> "you").
+    std::string text;
+    text.reserve(tmpl.literalLength + capturedLength + capturedLength / 2);
+    for (const auto& part : parts) {
+        if (part.slot == 0) {
+            text.append(source.substr(part.offset, part.length));
+        } else if (part.slot < captures.size() && captures[part.slot].matched()) {
+            uint64_t reflectStart = instrumentation::now();
+            pack.reflection.reflect(input, captures[part.slot].begin, captures[part.slot].end, text);
+            reflectNs += instrumentation::now() - reflectStart;
+        }
+    }
+
+    if (counters) {
+        instrumentation::recordPhase(counters, Phase::Reflect, reflectNs);
+        instrumentation::recordPhase(counters, Phase::Template, instrumentation::now() - renderStart - reflectNs);
+    }
+    return text;
 }
 
-deep_thonk::Response Engine::pickNeutralProbe() {
-    if (!m_activePack) return {"I'm not sure what to say.", ""};
+deep_thonk::Response Engine::pickNeutralProbe(Session& session) const {
+    if (!session.pack) return {"I'm not sure what to say.", ""};
 
-    for (const auto& rule : m_activePack->rules) {
-        if (rule.category == "General") {
-            int choice = rand() % rule.outs.size();
-            return {rule.outs[choice].text, rule.id};
+    const RulePack& pack = *session.pack;
+    if (pack.neutralRule != kNoRule) {
+        const Rule& rule = pack.rules[pack.neutralRule];
+        if (rule.templateCount > 0) {
+            uint32_t choice = pickTemplate(session, pack, pack.neutralRule);
+            return {std::string(pack.str(pack.outs(rule)[choice].text)), std::string(pack.str(rule.id)), choice};
         }
     }
     return {"Please, tell me more.", ""};
 }
 
-const std::map<std::string, RulePack> &Engine::getRulePacks() const {
-    return m_rulePacks;
+std::map<std::string, std::shared_ptr<const RulePack>> Engine::getRulePacks() const {
+    std::map<std::string, std::shared_ptr<const RulePack>> packs;
+    for (const auto& [locale, slot] : m_rulePacks) {
+        if (auto pack = slot->load()) {
+            packs.emplace(locale, std::move(pack));
+        }
+    }
+    return packs;
+}
+
+InstrumentationSnapshot Engine::instrumentationSnapshot() const {
+    InstrumentationSnapshot snapshot;
+    for (const auto& [locale, slot] : m_rulePacks) {
+        if (auto pack = slot->load()) {
+            instrumentation::collect(*pack, snapshot.locales[locale]);
+        }
+    }
+    snapshot.matchCache = m_matchCache.stats();
+    snapshot.matchBudgetExhausted = m_budgetExhausted.load(std::memory_order_relaxed);
+    return snapshot;
+}
+
+void Engine::setMatchCacheCapacity(size_t entries) {
+    m_matchCache.setCapacity(entries);
+}
+
+void Engine::setMatchBudget(uint64_t steps) {
+    m_matchBudget = steps;
+    // Cached results may have been found under a larger budget.
+    m_matchCache.clear();
+}
+
+std::shared_ptr<const RulePack> Engine::getRulePack(const std::string& locale) const {
+    auto it = m_rulePacks.find(locale);
+    return it != m_rulePacks.end() ? it->second->load() : nullptr;
+}
+
+bool Engine::restoreHits(const std::string& locale, const std::unordered_map<std::string, uint64_t>& hits) {
+    std::shared_ptr<const RulePack> pack = getRulePack(locale);
+    if (!pack) return false;
+    for (const auto& rule : pack->rules) {
+        auto it = hits.find(std::string(pack->str(rule.id)));
+        if (it != hits.end()) {
+            rule.hits.add(it->second);
+        }
+    }
+    return true;
 }
 
 }
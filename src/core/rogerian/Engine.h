@@ -1,33 +1,151 @@
 #ifndef ENGINE_H
 #define ENGINE_H
 
+#include "Instrumentation.h"
+#include "MatchCache.h"
 #include "Rules.h"
+#include "Session.h"
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <istream>
+#include <memory>
+#include <optional>
+#include <span>
 #include <string>
+#include <string_view>
+#include <unordered_map>
 #include <vector>
 #include <map>
+#include <mutex>
 
 namespace deep_thonk {
 
 struct Response {
     std::string text;
     std::string ruleId;
+    // Which of the rule's outs (or memory outs, for a reply from
+    // conversation memory) was used; 0 when no rule answered.
+    uint32_t templateIndex = 0;
 };
 
+class NormalizedText;
+class WorkStealingPool;
+
+// Where a lazily loaded rule pack comes from: the JSON source, and the path
+// of a precompiled blob to prefer when it was built from exactly that source
+// (empty for none). Produced on demand by the callback given to addLazyRulePack.
+struct PackSource {
+    std::string jsonContent;
+    std::string blobPath;
+};
+
+struct BatchOptions {
+    // Locale to answer in; empty means the default session's locale.
+    std::string locale;
+    // When set, message i draws its randomness from a stream derived from
+    // (seed, i) alone, so the output does not depend on thread count or timing.
+    // Every message is answered as if it opened a conversation: conversation
+    // memory, no-repeat history and choice logs do not apply.
+    std::optional<uint64_t> seed;
+    // Participating threads when respondBatch creates its own pool; 0 = all cores.
+    unsigned threads = 0;
+};
+
+// Loading or declaring rule packs is not thread-safe and must finish before
+// the engine is shared. After that, the Session overloads are safe to call
+// from any number of threads at once, one Session per thread, ensureLoaded may
+// compile a declared pack from any thread, and reloadRules may replace a
+// known locale's pack at any time.
 class Engine {
 public:
-    Engine();
-
     void loadRulesFromString(const std::string& jsonContent);
+    // Streams the pack straight from `input`; `sizeHint` (bytes) pre-sizes the rule vector.
+    void loadRulesFromStream(std::istream& input, size_t sizeHint = 0);
+    bool loadRulesFromFile(const std::string& path);
+    // Loads the precompiled blob at `path` if it was built from exactly
+    // `jsonContent`; otherwise compiles `jsonContent`. Returns true if the blob was used.
+    bool loadRulesFromBinary(const std::string& path, const std::string& jsonContent);
+    // Compiles `jsonContent` and publishes it in place of the loaded pack for
+    // its locale. Replies already running finish on the old pack; sessions
+    // switch on their next reply. Hit counts carry over for rule ids present
+    // in both packs. Returns the locale; throws if the JSON is malformed or
+    // its locale was never loaded.
+    std::string reloadRules(const std::string& jsonContent);
+    // Declares `locale` without compiling anything: `source` is only called,
+    // once, by the first ensureLoaded for it. Until then the locale has no
+    // pack; sessions may select it and switch to the pack once it exists.
+    void addLazyRulePack(const std::string& locale, std::function<PackSource()> source);
+    // Compiles a declared pack unless it is already loaded. Concurrent callers
+    // for one locale wait for a single compile; different locales compile in
+    // parallel. Returns false if the locale is unknown or its pack failed to
+    // load, in which case a later call tries again.
+    bool ensureLoaded(const std::string& locale);
+    // Same, compiled on a background thread. The engine must outlive the future.
+    std::future<std::string> reloadRulesAsync(std::string jsonContent);
+
+    // Snapshots of the currently published packs; declared locales that have
+    // not been compiled yet are left out, and getRulePack returns null for them.
+    std::map<std::string, std::shared_ptr<const RulePack>> getRulePacks() const;
+    std::shared_ptr<const RulePack> getRulePack(const std::string& locale) const;
+    // Adds `hits` (rule id -> count), e.g. replayed from a journal, to the
+    // hit counters of `locale`'s loaded pack. Unknown ids are ignored.
+    // Returns false if the locale has no pack yet.
+    bool restoreHits(const std::string& locale, const std::unordered_map<std::string, uint64_t>& hits);
+
+    // Per-rule regex cost, phase timings and fallback counts for the
+    // published packs. Empty counters unless built with
+    // DEEPTHONK_ENABLE_INSTRUMENTATION.
+    InstrumentationSnapshot instrumentationSnapshot() const;
+
+    // Bounds the cache of match results for repeated messages (entries over
+    // all packs); 0 turns it off. Clears the cache, so call it before the
+    // engine is shared.
+    void setMatchCacheCapacity(size_t entries);
+    MatchCacheStats matchCacheStats() const { return m_matchCache.stats(); }
+
+    // Caps the pattern work of one reply at `steps` (see Regex::search; a
+    // step is one automaton state at one input position, ~10 ns). A message
+    // that needs more is answered with the neutral probe instead, so a long
+    // paste cannot hold a reply up for long. Call before the engine is shared.
+    static constexpr uint64_t kDefaultMatchBudget = 2'000'000;
+    void setMatchBudget(uint64_t steps);
+
+    Session createSession(const std::string& locale) const;
+    // Same, with the session's RNG seeded for a reproducible conversation.
+    Session createSession(const std::string& locale, uint64_t seed) const;
+    bool setLocale(Session& session, const std::string& locale) const;
+    Response respond(Session& session, const std::string& userText) const;
+
+    // Answers every message independently, spread over a work-stealing pool.
+    // Results come back in input order.
+    std::vector<Response> respondBatch(std::span<const std::string> messages, const BatchOptions& options = {}) const;
+    std::vector<Response> respondBatch(std::span<const std::string> messages, WorkStealingPool& pool, const BatchOptions& options = {}) const;
+
+    // Single-conversation convenience API backed by a default session.
     void setLocale(const std::string& locale);
     Response respond(const std::string& userText);
-    const std::map<std::string, RulePack>& getRulePacks() const;
 
 private:
-    std::string reflect(const std::string& text);
-    Response pickNeutralProbe();
+    void installPack(const std::string& locale, RulePack&& pack);
+    void refreshPack(Session& session) const;
+    std::string renderTemplate(const RulePack& pack, const RuleTemplate& tmpl, const NormalizedText& input,
+                               std::span<const CaptureSpan> captures, instrumentation::PackCounters* counters) const;
+    Response pickNeutralProbe(Session& session) const;
+
+    struct LazyPack {
+        std::function<PackSource()> source;
+        std::mutex loadMutex;
+    };
 
-    std::map<std::string, RulePack> m_rulePacks;
-    RulePack* m_activePack = nullptr;
+    std::map<std::string, std::shared_ptr<PackSlot>> m_rulePacks;
+    std::map<std::string, std::unique_ptr<LazyPack>> m_lazyPacks;
+    std::mutex m_reloadMutex;
+    mutable MatchCache m_matchCache;
+    uint64_t m_matchBudget = kDefaultMatchBudget;
+    mutable std::atomic<uint64_t> m_budgetExhausted{0};
+    Session m_session;
 };
 
 }
@@ -0,0 +1,234 @@
+#include "Instrumentation.h"
+#include "Rules.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace deep_thonk::instrumentation {
+
+#if DEEPTHONK_INSTRUMENTATION
+
+namespace {
+
+// Only the owning thread writes a counter, so bumping it is a relaxed load
+// and store; snapshots read it concurrently through the atomic.
+void bump(std::atomic<uint64_t>& counter, uint64_t amount) {
+    counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+}
+
+}
+
+struct RuleCounters {
+    std::atomic<uint64_t> evaluations{0};
+    std::atomic<uint64_t> matches{0};
+    std::atomic<uint64_t> cached{0};
+    std::atomic<uint64_t> evalNs{0};
+};
+
+struct PhaseCounters {
+    std::atomic<uint64_t> count{0};
+    std::atomic<uint64_t> totalNs{0};
+};
+
+struct PackCounters {
+    PackCounters(uint64_t packSerial, size_t count)
+        : serial(packSerial), ruleCount(count), rules(std::make_unique<RuleCounters[]>(count)) {}
+
+    uint64_t serial;
+    size_t ruleCount;
+    std::unique_ptr<RuleCounters[]> rules;
+    std::atomic<uint64_t> responses{0};
+    std::atomic<uint64_t> fallbacks{0};
+    PhaseCounters phases[kPhaseCount];
+};
+
+namespace {
+
+// One per thread. `lock` only guards the map's shape: the owner takes it to
+// add a pack, snapshots take it to walk the map.
+struct ThreadBuffer {
+    std::mutex lock;
+    std::unordered_map<uint64_t, std::unique_ptr<PackCounters>> packs;
+    PackCounters* last = nullptr;
+    uint64_t retirements = 0; // Registry::retirements() when `packs` was last pruned
+};
+
+void addInto(PackCounters& into, const PackCounters& from) {
+    for (size_t i = 0; i < from.ruleCount && i < into.ruleCount; ++i) {
+        bump(into.rules[i].evaluations, from.rules[i].evaluations.load(std::memory_order_relaxed));
+        bump(into.rules[i].matches, from.rules[i].matches.load(std::memory_order_relaxed));
+        bump(into.rules[i].cached, from.rules[i].cached.load(std::memory_order_relaxed));
+        bump(into.rules[i].evalNs, from.rules[i].evalNs.load(std::memory_order_relaxed));
+    }
+    bump(into.responses, from.responses.load(std::memory_order_relaxed));
+    bump(into.fallbacks, from.fallbacks.load(std::memory_order_relaxed));
+    for (size_t p = 0; p < kPhaseCount; ++p) {
+        bump(into.phases[p].count, from.phases[p].count.load(std::memory_order_relaxed));
+        bump(into.phases[p].totalNs, from.phases[p].totalNs.load(std::memory_order_relaxed));
+    }
+}
+
+class Registry {
+public:
+    static Registry& instance() {
+        static Registry registry;
+        return registry;
+    }
+
+    void attach(ThreadBuffer* buffer) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_live.push_back(buffer);
+    }
+
+    // Folds an exiting thread's counts into the retired totals.
+    void detach(ThreadBuffer* buffer) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        std::erase(m_live, buffer);
+        std::lock_guard<std::mutex> bufferLock(buffer->lock);
+        for (auto& [serial, counters] : buffer->packs) {
+            if (!m_published.contains(serial)) continue;
+            auto& retired = m_retired.packs[serial];
+            if (!retired) retired = std::make_unique<PackCounters>(serial, counters->ruleCount);
+            addInto(*retired, *counters);
+        }
+    }
+
+    void publish(uint64_t serial) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        m_published.insert(serial);
+    }
+
+    void retire(uint64_t serial) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (!m_published.erase(serial)) return;
+        m_retired.packs.erase(serial);
+        m_retirements.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    uint64_t retirements() const { return m_retirements.load(std::memory_order_relaxed); }
+
+    // Called by the owning thread: drops its counters for retired packs and
+    // tells whether `serial` may have counters at all.
+    bool prune(ThreadBuffer& buffer, uint64_t serial) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        if (buffer.retirements != retirements()) {
+            std::lock_guard<std::mutex> bufferLock(buffer.lock);
+            std::erase_if(buffer.packs, [this](const auto& entry) { return !m_published.contains(entry.first); });
+            buffer.last = nullptr;
+            buffer.retirements = retirements();
+        }
+        return m_published.contains(serial);
+    }
+
+    template <typename Visit>
+    void forEach(uint64_t serial, Visit&& visit) {
+        std::lock_guard<std::mutex> lock(m_lock);
+        auto visitBuffer = [&](ThreadBuffer& buffer) {
+            std::lock_guard<std::mutex> bufferLock(buffer.lock);
+            auto it = buffer.packs.find(serial);
+            if (it != buffer.packs.end()) visit(*it->second);
+        };
+        for (ThreadBuffer* buffer : m_live) visitBuffer(*buffer);
+        visitBuffer(m_retired);
+    }
+
+private:
+    std::mutex m_lock;
+    std::vector<ThreadBuffer*> m_live;
+    ThreadBuffer m_retired;
+    std::unordered_set<uint64_t> m_published;
+    std::atomic<uint64_t> m_retirements{0};
+};
+
+struct ThreadHandle {
+    ThreadHandle() { Registry::instance().attach(&buffer); }
+    ~ThreadHandle() { Registry::instance().detach(&buffer); }
+
+    ThreadBuffer buffer;
+};
+
+}
+
+PackCounters* countersFor(const RulePack& pack) {
+    thread_local ThreadHandle handle;
+    ThreadBuffer& buffer = handle.buffer;
+    if (buffer.last && buffer.last->serial == pack.serial) return buffer.last;
+
+    Registry& registry = Registry::instance();
+    if (buffer.retirements != registry.retirements() && !registry.prune(buffer, pack.serial)) return nullptr;
+    auto it = buffer.packs.find(pack.serial);
+    if (it == buffer.packs.end()) {
+        // A reply still running on a replaced pack records nothing.
+        if (!registry.prune(buffer, pack.serial)) return nullptr;
+        std::lock_guard<std::mutex> lock(buffer.lock);
+        it = buffer.packs.emplace(pack.serial, std::make_unique<PackCounters>(pack.serial, pack.rules.size())).first;
+    }
+    buffer.last = it->second.get();
+    return buffer.last;
+}
+
+void publishPack(uint64_t serial) {
+    Registry::instance().publish(serial);
+}
+
+void retirePack(uint64_t serial) {
+    Registry::instance().retire(serial);
+}
+
+void recordRule(PackCounters* counters, size_t ruleIndex, bool matched, uint64_t ns) {
+    RuleCounters& rule = counters->rules[ruleIndex];
+    bump(rule.evaluations, 1);
+    if (matched) bump(rule.matches, 1);
+    bump(rule.evalNs, ns);
+}
+
+void recordCachedMatch(PackCounters* counters, size_t ruleIndex) {
+    bump(counters->rules[ruleIndex].cached, 1);
+}
+
+void recordPhase(PackCounters* counters, Phase phase, uint64_t ns) {
+    PhaseCounters& counter = counters->phases[static_cast<size_t>(phase)];
+    bump(counter.count, 1);
+    bump(counter.totalNs, ns);
+}
+
+void recordResponse(PackCounters* counters, bool fallback) {
+    bump(counters->responses, 1);
+    if (fallback) bump(counters->fallbacks, 1);
+}
+
+#endif
+
+uint64_t nextPackSerial() {
+    static std::atomic<uint64_t> serial{0};
+    return serial.fetch_add(1, std::memory_order_relaxed) + 1;
+}
+
+void collect(const RulePack& pack, LocaleStats& stats) {
+    stats = LocaleStats();
+    stats.rules.resize(pack.rules.size());
+    for (size_t i = 0; i < pack.rules.size(); ++i) {
+        stats.rules[i].id = pack.str(pack.rules[i].id);
+    }
+
+#if DEEPTHONK_INSTRUMENTATION
+    Registry::instance().forEach(pack.serial, [&stats](const PackCounters& counters) {
+        for (size_t i = 0; i < counters.ruleCount && i < stats.rules.size(); ++i) {
+            stats.rules[i].evaluations += counters.rules[i].evaluations.load(std::memory_order_relaxed);
+            stats.rules[i].matches += counters.rules[i].matches.load(std::memory_order_relaxed);
+            stats.rules[i].cached += counters.rules[i].cached.load(std::memory_order_relaxed);
+            stats.rules[i].evalNs += counters.rules[i].evalNs.load(std::memory_order_relaxed);
+        }
+        stats.responses += counters.responses.load(std::memory_order_relaxed);
+        stats.fallbacks += counters.fallbacks.load(std::memory_order_relaxed);
+        for (size_t p = 0; p < kPhaseCount; ++p) {
+            stats.phases[p].count += counters.phases[p].count.load(std::memory_order_relaxed);
+            stats.phases[p].totalNs += counters.phases[p].totalNs.load(std::memory_order_relaxed);
+        }
+    });
+#endif
+}
+
+}
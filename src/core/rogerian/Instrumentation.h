@@ -0,0 +1,121 @@
+#ifndef DEEPTHONK3D_INSTRUMENTATION_H
+#define DEEPTHONK3D_INSTRUMENTATION_H
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// Set by the DEEPTHONK_ENABLE_INSTRUMENTATION CMake option. When it is 0 the
+// recording hooks below are empty inlines and the engine's hot path carries
+// no instrumentation code at all.
+#ifndef DEEPTHONK_INSTRUMENTATION
+#define DEEPTHONK_INSTRUMENTATION 0
+#endif
+
+namespace deep_thonk {
+
+    struct RulePack;
+
+    constexpr bool kInstrumentationEnabled = DEEPTHONK_INSTRUMENTATION != 0;
+
+    // Where respond() spends its time: finding the rule (regexes included),
+    // reflecting captures, and assembling the reply around them.
+    enum class Phase : uint8_t { Match, Reflect, Template };
+    constexpr size_t kPhaseCount = 3;
+
+    struct PhaseStats {
+        uint64_t count = 0;
+        uint64_t totalNs = 0;
+    };
+
+    struct RuleStats {
+        std::string id;
+        uint64_t evaluations = 0; // times its regex ran
+        uint64_t matches = 0;
+        uint64_t cached = 0;      // times it won from the match cache, regex not run
+        uint64_t evalNs = 0;      // total time spent in its regex
+
+        uint64_t misses() const { return evaluations - matches; }
+    };
+
+    struct LocaleStats {
+        std::vector<RuleStats> rules; // in pack order
+        uint64_t responses = 0;
+        uint64_t fallbacks = 0;       // replies where no rule matched
+        PhaseStats phases[kPhaseCount];
+    };
+
+    // The engine's match cache (see MatchCache.h). Kept in every build.
+    struct MatchCacheStats {
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        size_t entries = 0;
+        size_t bytes = 0; // approximate heap held by the entries
+        size_t capacity = 0;
+
+        double hitRate() const { return hits + misses ? double(hits) / double(hits + misses) : 0.0; }
+    };
+
+    // Totals over every thread for the currently published packs. Counters
+    // belong to one pack, so a reload starts them from zero and those of the
+    // replaced pack are dropped. `matchCache`
+    // and `matchBudgetExhausted` are engine-wide and filled in every build.
+    struct InstrumentationSnapshot {
+        std::map<std::string, LocaleStats> locales;
+        MatchCacheStats matchCache;
+        uint64_t matchBudgetExhausted = 0; // replies that ran out of match budget (Engine::setMatchBudget)
+    };
+
+    // Recording side, used by Engine and Matcher only. Each thread counts
+    // into its own buffer (plain stores, no atomic read-modify-write and no
+    // shared cache lines); snapshots sum the buffers, including those of
+    // threads that have since exited.
+    namespace instrumentation {
+
+        struct PackCounters;
+
+#if DEEPTHONK_INSTRUMENTATION
+        inline uint64_t now() {
+            return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count());
+        }
+
+        // This thread's counters for `pack`.
+        PackCounters* countersFor(const RulePack& pack);
+        void recordRule(PackCounters* counters, size_t ruleIndex, bool matched, uint64_t ns);
+        void recordCachedMatch(PackCounters* counters, size_t ruleIndex);
+        void recordPhase(PackCounters* counters, Phase phase, uint64_t ns);
+        void recordResponse(PackCounters* counters, bool fallback);
+
+        // Called by PackSlot as packs are published and replaced. Counters
+        // exist only for published packs: retiring one frees its totals, and
+        // threads drop their own buffers for it the next time they look up
+        // another pack.
+        void publishPack(uint64_t serial);
+        void retirePack(uint64_t serial);
+#else
+        inline uint64_t now() { return 0; }
+        inline PackCounters* countersFor(const RulePack&) { return nullptr; }
+        inline void recordRule(PackCounters*, size_t, bool, uint64_t) {}
+        inline void recordCachedMatch(PackCounters*, size_t) {}
+        inline void recordPhase(PackCounters*, Phase, uint64_t) {}
+        inline void recordResponse(PackCounters*, bool) {}
+        inline void publishPack(uint64_t) {}
+        inline void retirePack(uint64_t) {}
+#endif
+
+        // Next RulePack::serial; every compiled pack gets its own, in every
+        // build, since sessions tell packs apart by it.
+        uint64_t nextPackSerial();
+
+        // Fills `stats` with the totals recorded against `pack`.
+        void collect(const RulePack& pack, LocaleStats& stats);
+
+    }
+
+}
+
+#endif //DEEPTHONK3D_INSTRUMENTATION_H
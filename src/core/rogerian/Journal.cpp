@@ -0,0 +1,332 @@
+#include "Journal.h"
+#include "../utils/BinaryIO.h"
+#include "../../third_party/nlohmann/json.hpp"
+#include <cstring>
+#include <filesystem>
+#include <system_error>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <unistd.h>
+#elif defined(_WIN32)
+#include <io.h>
+#endif
+
+namespace deep_thonk {
+
+namespace {
+
+constexpr char kMagic[8] = {'D', 'T', 'J', 'O', 'U', 'R', 'N', 'L'};
+constexpr size_t kHeaderSize = sizeof(kMagic) + 2 * sizeof(uint32_t);
+// Payload size and checksum in front of every record.
+constexpr size_t kRecordHeaderSize = 2 * sizeof(uint32_t);
+// A larger size field can only come from a torn or corrupt record.
+constexpr uint32_t kMaxRecordSize = 16u << 20;
+
+uint32_t checksum(std::string_view payload) {
+    uint64_t hash = fnv1a64(payload.data(), payload.size());
+    return static_cast<uint32_t>(hash ^ (hash >> 32));
+}
+
+void encode(const JournalRecord& record, std::string& out) {
+    BinaryWriter payload;
+    payload.u32(static_cast<uint32_t>(record.type));
+    payload.u64(record.timestampMs);
+    switch (record.type) {
+    case JournalRecord::Type::Start:
+        payload.u64(record.seed);
+        payload.string(record.locale);
+        break;
+    case JournalRecord::Type::Locale:
+        payload.string(record.locale);
+        break;
+    case JournalRecord::Type::Exchange:
+        payload.u32(record.templateIndex);
+        payload.string(record.input);
+        payload.string(record.ruleId);
+        payload.string(record.reply);
+        break;
+    }
+
+    const std::string& bytes = payload.buffer();
+    BinaryWriter header;
+    header.u32(static_cast<uint32_t>(bytes.size()));
+    header.u32(checksum(bytes));
+    out += header.buffer();
+    out += bytes;
+}
+
+bool decode(std::string_view payload, JournalRecord& record) {
+    BinaryReader in(payload.data(), payload.size());
+    uint32_t type = 0;
+    if (!in.u32(type) || !in.u64(record.timestampMs)) return false;
+    record.type = static_cast<JournalRecord::Type>(type);
+    record.seed = 0;
+    record.templateIndex = 0;
+    record.locale = record.input = record.ruleId = record.reply = {};
+    switch (record.type) {
+    case JournalRecord::Type::Start:
+        return in.u64(record.seed) && in.string(record.locale) && in.atEnd();
+    case JournalRecord::Type::Locale:
+        return in.string(record.locale) && in.atEnd();
+    case JournalRecord::Type::Exchange:
+        return in.u32(record.templateIndex) && in.string(record.input) && in.string(record.ruleId) &&
+               in.string(record.reply) && in.atEnd();
+    }
+    return false;
+}
+
+bool syncFile(std::FILE* file) {
+    if (std::fflush(file) != 0) return false;
+#if defined(__APPLE__)
+    return ::fsync(::fileno(file)) == 0;
+#elif defined(__unix__)
+    return ::fdatasync(::fileno(file)) == 0;
+#elif defined(_WIN32)
+    return ::_commit(::_fileno(file)) == 0;
+#else
+    return true;
+#endif
+}
+
+// "2025-08-18 14:03:09" (UTC), without gmtime's shared buffer.
+std::string formatTimestamp(uint64_t timestampMs) {
+    int64_t seconds = static_cast<int64_t>(timestampMs / 1000);
+    int64_t days = seconds / 86400;
+    int64_t secondOfDay = seconds % 86400;
+
+    // Civil date from days since 1970-01-01 (H. Hinnant's algorithm).
+    days += 719468;
+    int64_t era = days / 146097;
+    int64_t dayOfEra = days - era * 146097;
+    int64_t yearOfEra = (dayOfEra - dayOfEra / 1460 + dayOfEra / 36524 - dayOfEra / 146096) / 365;
+    int64_t dayOfYear = dayOfEra - (365 * yearOfEra + yearOfEra / 4 - yearOfEra / 100);
+    int64_t monthIndex = (5 * dayOfYear + 2) / 153;
+    int64_t day = dayOfYear - (153 * monthIndex + 2) / 5 + 1;
+    int64_t month = monthIndex < 10 ? monthIndex + 3 : monthIndex - 9;
+    int64_t year = yearOfEra + era * 400 + (month <= 2);
+
+    char buffer[80];
+    std::snprintf(buffer, sizeof(buffer), "%04lld-%02lld-%02lld %02lld:%02lld:%02lld", static_cast<long long>(year),
+                  static_cast<long long>(month), static_cast<long long>(day), static_cast<long long>(secondOfDay / 3600),
+                  static_cast<long long>(secondOfDay / 60 % 60), static_cast<long long>(secondOfDay % 60));
+    return buffer;
+}
+
+void writeText(const JournalRecord& record, std::ostream& out) {
+    out << formatTimestamp(record.timestampMs);
+    switch (record.type) {
+    case JournalRecord::Type::Start:
+        out << " -- session started (" << record.locale << ", seed " << record.seed << ")\n";
+        break;
+    case JournalRecord::Type::Locale:
+        out << " -- locale " << record.locale << '\n';
+        break;
+    case JournalRecord::Type::Exchange:
+        out << " You: " << record.input << '\n' << formatTimestamp(record.timestampMs) << " Therapist: " << record.reply;
+        if (!record.ruleId.empty()) out << " (rule: " << record.ruleId << ')';
+        out << '\n';
+        break;
+    }
+}
+
+void writeJson(const JournalRecord& record, std::ostream& out) {
+    nlohmann::json entry = {{"time", record.timestampMs}};
+    switch (record.type) {
+    case JournalRecord::Type::Start:
+        entry["type"] = "start";
+        entry["locale"] = record.locale;
+        entry["seed"] = record.seed;
+        break;
+    case JournalRecord::Type::Locale:
+        entry["type"] = "locale";
+        entry["locale"] = record.locale;
+        break;
+    case JournalRecord::Type::Exchange:
+        entry["type"] = "exchange";
+        entry["input"] = record.input;
+        entry["ruleId"] = record.ruleId;
+        entry["template"] = record.templateIndex;
+        entry["reply"] = record.reply;
+        break;
+    }
+    // The journal keeps the user's bytes as typed; invalid UTF-8 becomes U+FFFD.
+    out << entry.dump(-1, ' ', false, nlohmann::json::error_handler_t::replace);
+}
+
+}
+
+JournalWriter::JournalWriter() : JournalWriter(Options{}) {}
+
+JournalWriter::JournalWriter(Options options) : m_options(options) {}
+
+JournalWriter::~JournalWriter() {
+    close();
+}
+
+bool JournalWriter::open(const std::string& path) {
+    close();
+
+    // Keep every whole record of an existing journal and cut off a torn one.
+    std::error_code error;
+    uintmax_t existingSize = std::filesystem::file_size(path, error);
+    bool fresh = error || existingSize == 0;
+    if (!fresh) {
+        JournalReader reader;
+        if (!reader.open(path)) return false;
+        JournalRecord record;
+        while (reader.next(record)) {
+        }
+        size_t validSize = reader.validSize();
+        bool torn = reader.truncated();
+        reader.close();
+        if (torn) {
+            std::filesystem::resize_file(path, validSize, error);
+            if (error) return false;
+        }
+    }
+
+    m_file = std::fopen(path.c_str(), "ab");
+    if (!m_file) return false;
+    if (fresh) {
+        BinaryWriter header;
+        header.raw(kMagic, sizeof(kMagic));
+        header.u32(kJournalVersion);
+        header.u32(0);
+        if (std::fwrite(header.buffer().data(), 1, kHeaderSize, m_file) != kHeaderSize || !syncFile(m_file)) {
+            std::fclose(m_file);
+            m_file = nullptr;
+            return false;
+        }
+    }
+
+    m_pending.clear();
+    m_appended = m_committed = m_syncs = 0;
+    m_flushRequested = m_stopping = m_failed = false;
+    m_thread = std::thread(&JournalWriter::commitLoop, this);
+    return true;
+}
+
+void JournalWriter::close() {
+    if (!m_thread.joinable()) return;
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_one();
+    m_thread.join();
+    std::fclose(m_file);
+    m_file = nullptr;
+}
+
+void JournalWriter::append(const JournalRecord& record) {
+    {
+        std::lock_guard lock(m_mutex);
+        encode(record, m_pending);
+        ++m_appended;
+    }
+    m_wake.notify_one();
+}
+
+bool JournalWriter::flush() {
+    std::unique_lock lock(m_mutex);
+    uint64_t target = m_appended;
+    if (m_committed < target) {
+        m_flushRequested = true;
+        m_wake.notify_one();
+        m_durable.wait(lock, [this, target] { return m_committed >= target; });
+    }
+    return !m_failed;
+}
+
+uint64_t JournalWriter::syncCount() const {
+    std::lock_guard lock(m_mutex);
+    return m_syncs;
+}
+
+void JournalWriter::commitLoop() {
+    std::string batch;
+    std::unique_lock lock(m_mutex);
+    while (true) {
+        m_wake.wait(lock, [this] { return m_stopping || !m_pending.empty(); });
+        if (m_pending.empty()) break; // stopping with nothing left to write
+
+        // Let the records of the next few moments share this fsync.
+        m_wake.wait_for(lock, m_options.commitInterval, [this] {
+            return m_stopping || m_flushRequested || m_pending.size() >= m_options.commitBytes;
+        });
+        m_flushRequested = false;
+        batch.clear();
+        batch.swap(m_pending);
+        uint64_t sequence = m_appended;
+        lock.unlock();
+
+        bool written = std::fwrite(batch.data(), 1, batch.size(), m_file) == batch.size() && syncFile(m_file);
+
+        lock.lock();
+        m_committed = sequence;
+        ++m_syncs;
+        m_failed = m_failed || !written;
+        m_durable.notify_all();
+    }
+}
+
+bool JournalReader::open(const std::string& path) {
+    close();
+    if (!m_file.open(path) || m_file.size() < kHeaderSize) {
+        m_file.close();
+        return false;
+    }
+    BinaryReader header(m_file.data(), kHeaderSize);
+    char magic[sizeof(kMagic)];
+    uint32_t version = 0;
+    if (!header.raw(magic, sizeof(magic)) || std::memcmp(magic, kMagic, sizeof(kMagic)) != 0 ||
+        !header.u32(version) || version != kJournalVersion) {
+        m_file.close();
+        return false;
+    }
+    m_pos = kHeaderSize;
+    return true;
+}
+
+void JournalReader::close() {
+    m_file.close();
+    m_pos = 0;
+    m_truncated = false;
+}
+
+bool JournalReader::next(JournalRecord& record) {
+    if (m_truncated || m_pos >= m_file.size()) return false;
+
+    BinaryReader in(m_file.data() + m_pos, m_file.size() - m_pos);
+    uint32_t size = 0;
+    uint32_t sum = 0;
+    std::string_view payload;
+    if (!in.u32(size) || !in.u32(sum) || size > kMaxRecordSize || !in.view(size, payload) ||
+        checksum(payload) != sum || !decode(payload, record)) {
+        m_truncated = true;
+        return false;
+    }
+    m_pos += kRecordHeaderSize + size;
+    return true;
+}
+
+bool exportJournal(const std::string& path, std::ostream& out, JournalFormat format) {
+    JournalReader reader;
+    if (!reader.open(path)) return false;
+
+    JournalRecord record;
+    if (format == JournalFormat::Text) {
+        while (reader.next(record)) writeText(record, out);
+        return true;
+    }
+
+    out << '[';
+    for (bool first = true; reader.next(record); first = false) {
+        out << (first ? "\n  " : ",\n  ");
+        writeJson(record, out);
+    }
+    out << "\n]\n";
+    return true;
+}
+
+}
@@ -0,0 +1,130 @@
+#ifndef DEEPTHONK3D_JOURNAL_H
+#define DEEPTHONK3D_JOURNAL_H
+
+#include "../utils/MappedFile.h"
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+
+namespace deep_thonk {
+
+    // Append-only log of a conversation, so the chat and the rule hit counts
+    // survive a restart. The file is a 16-byte header followed by records,
+    // each a payload size, a checksum of the payload, and the payload itself.
+    // A crash can only tear the last record; readers stop there and the
+    // writer cuts it off before appending again.
+    //
+    // Exchanges keep the reply text as well as the rule and template that
+    // produced it, so history and hit counts come back from the journal
+    // alone, without running the matcher again.
+    struct JournalRecord {
+        enum class Type : uint32_t {
+            Start = 1,    // a session began: `seed`, `locale`
+            Locale = 2,   // the session switched to `locale`
+            Exchange = 3  // `input` was answered with `reply` by `ruleId`
+        };
+
+        Type type = Type::Exchange;
+        uint64_t timestampMs = 0; // since the epoch
+        uint64_t seed = 0;
+        uint32_t templateIndex = 0;
+        std::string_view locale;
+        std::string_view input;
+        std::string_view ruleId;
+        std::string_view reply;
+    };
+
+    constexpr uint32_t kJournalVersion = 1;
+
+    // Appends records from any number of threads. append() only copies the
+    // record into a buffer; a commit thread writes the buffer out and fsyncs
+    // it once per `commitInterval` (group commit), or sooner once
+    // `commitBytes` are waiting or someone calls flush(). A crash loses at
+    // most the records of the last interval.
+    class JournalWriter {
+    public:
+        struct Options {
+            std::chrono::milliseconds commitInterval{50};
+            size_t commitBytes = 64 * 1024;
+        };
+
+        JournalWriter();
+        explicit JournalWriter(Options options);
+        // Commits whatever is still buffered.
+        ~JournalWriter();
+
+        JournalWriter(const JournalWriter&) = delete;
+        JournalWriter& operator=(const JournalWriter&) = delete;
+
+        // Creates the journal at `path`, or reopens it for appending after
+        // dropping a torn last record. Fails, leaving the file alone, if it
+        // exists but is not a journal of this version.
+        bool open(const std::string& path);
+        void close();
+        bool isOpen() const { return m_thread.joinable(); }
+
+        void append(const JournalRecord& record);
+        // Blocks until every record appended so far is on disk. False if any
+        // write or fsync has failed since the journal was opened.
+        bool flush();
+
+        // fsyncs issued so far; one per group commit.
+        uint64_t syncCount() const;
+
+    private:
+        void commitLoop();
+
+        Options m_options;
+        std::FILE* m_file = nullptr;
+        std::thread m_thread;
+
+        mutable std::mutex m_mutex;
+        std::condition_variable m_wake;    // commit thread: records waiting, flush or stop
+        std::condition_variable m_durable; // flush(): a commit finished
+        std::string m_pending;
+        uint64_t m_appended = 0;  // records appended
+        uint64_t m_committed = 0; // records on disk
+        uint64_t m_syncs = 0;
+        bool m_flushRequested = false;
+        bool m_stopping = false;
+        bool m_failed = false;
+    };
+
+    // Reads a journal through a memory map, one record at a time. Record
+    // views point into the map and stay valid until the reader is closed.
+    class JournalReader {
+    public:
+        // False if the file is missing, empty or not a journal of this version.
+        bool open(const std::string& path);
+        void close();
+
+        // False at the end, or at a torn or corrupt record (see truncated()).
+        bool next(JournalRecord& record);
+
+        // True once next() has stopped before the end of the file.
+        bool truncated() const { return m_truncated; }
+        // Bytes up to the end of the last record read.
+        size_t validSize() const { return m_pos; }
+
+    private:
+        MappedFile m_file;
+        size_t m_pos = 0;
+        bool m_truncated = false;
+    };
+
+    enum class JournalFormat { Text, Json };
+
+    // Writes the journal at `path` to `out` one record at a time: as a
+    // plain-text transcript, or as a JSON array of records. Returns false if
+    // the journal cannot be opened.
+    bool exportJournal(const std::string& path, std::ostream& out, JournalFormat format);
+
+}
+
+#endif //DEEPTHONK3D_JOURNAL_H
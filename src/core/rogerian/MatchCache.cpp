@@ -0,0 +1,116 @@
+#include "MatchCache.h"
+#include "../utils/BinaryIO.h"
+
+namespace deep_thonk {
+
+namespace {
+
+// Rough per-entry overhead of the list node and the index node.
+constexpr size_t kNodeBytes = 64;
+
+uint64_t keyHash(uint64_t packSerial, std::string_view text) {
+    uint64_t hash = fnv1a64(text.data(), text.size());
+    hash ^= packSerial * 0x9e3779b97f4a7c15ull;
+    // Finalise so the shard (high bits) and bucket (low bits) are both well mixed.
+    hash = (hash ^ (hash >> 33)) * 0xff51afd7ed558ccdull;
+    return hash ^ (hash >> 33);
+}
+
+}
+
+MatchCache::MatchCache(size_t capacity) {
+    setCapacity(capacity);
+}
+
+void MatchCache::setCapacity(size_t capacity) {
+    m_capacity = capacity;
+    // Split exactly: the first capacity % kShards shards take one more, and
+    // below kShards some shards hold nothing.
+    for (size_t i = 0; i < kShards; ++i) {
+        std::lock_guard lock(m_shards[i].mutex);
+        m_shards[i].capacity = capacity / kShards + (i < capacity % kShards ? 1 : 0);
+    }
+    clear();
+}
+
+bool MatchCache::lookup(uint64_t packSerial, std::string_view text, MatchResult& out) {
+    if (m_capacity == 0 || text.size() > kMaxTextBytes) return false;
+
+    uint64_t hash = keyHash(packSerial, text);
+    Shard& shard = shardFor(hash);
+    std::lock_guard lock(shard.mutex);
+    auto it = shard.index.find(hash);
+    if (it == shard.index.end() || it->second->packSerial != packSerial || it->second->text != text) {
+        ++shard.misses;
+        return false;
+    }
+    ++shard.hits;
+    shard.entries.splice(shard.entries.begin(), shard.entries, it->second);
+    const Entry& entry = *it->second;
+    out.rule = entry.rule;
+    out.captures.assign(entry.captures.begin(), entry.captures.end());
+    return true;
+}
+
+void MatchCache::insert(uint64_t packSerial, std::string_view text, const MatchResult& result) {
+    if (m_capacity == 0 || text.size() > kMaxTextBytes) return;
+
+    uint64_t hash = keyHash(packSerial, text);
+    Shard& shard = shardFor(hash);
+    std::lock_guard lock(shard.mutex);
+    if (shard.capacity == 0) return;
+
+    auto existing = shard.index.find(hash);
+    std::list<Entry>::iterator slot;
+    if (existing != shard.index.end()) {
+        // Same key (another thread got here first) or a hash collision: overwrite.
+        slot = existing->second;
+        shard.entries.splice(shard.entries.begin(), shard.entries, slot);
+    } else if (shard.entries.size() >= shard.capacity) {
+        // Reuse the least recently used entry and its buffers.
+        slot = std::prev(shard.entries.end());
+        shard.index.erase(slot->hash);
+        shard.entries.splice(shard.entries.begin(), shard.entries, slot);
+        shard.index.emplace(hash, slot);
+    } else {
+        slot = shard.entries.emplace(shard.entries.begin());
+        shard.index.emplace(hash, slot);
+        shard.bytes += kNodeBytes + entryBytes(*slot);
+    }
+
+    shard.bytes -= entryBytes(*slot);
+    slot->hash = hash;
+    slot->packSerial = packSerial;
+    slot->text.assign(text);
+    slot->rule = result.rule;
+    slot->captures.assign(result.captures.begin(), result.captures.end());
+    shard.bytes += entryBytes(*slot);
+}
+
+void MatchCache::clear() {
+    for (Shard& shard : m_shards) {
+        std::lock_guard lock(shard.mutex);
+        shard.entries.clear();
+        shard.index.clear();
+        shard.bytes = 0;
+    }
+}
+
+MatchCacheStats MatchCache::stats() const {
+    MatchCacheStats stats;
+    stats.capacity = m_capacity;
+    for (const Shard& shard : m_shards) {
+        std::lock_guard lock(shard.mutex);
+        stats.hits += shard.hits;
+        stats.misses += shard.misses;
+        stats.entries += shard.entries.size();
+        stats.bytes += shard.bytes;
+    }
+    return stats;
+}
+
+size_t MatchCache::entryBytes(const Entry& entry) {
+    return sizeof(Entry) + entry.text.capacity() + entry.captures.capacity() * sizeof(CaptureSpan);
+}
+
+}
@@ -0,0 +1,74 @@
+#ifndef DEEPTHONK3D_MATCHCACHE_H
+#define DEEPTHONK3D_MATCHCACHE_H
+
+#include "Instrumentation.h"
+#include "Matcher.h"
+#include <array>
+#include <cstdint>
+#include <list>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace deep_thonk {
+
+    // Bounded LRU of match results in front of the matcher, keyed by a hash
+    // of the normalised text and the serial of the pack that produced them,
+    // so entries of a replaced pack are never returned and simply age out.
+    // Messages that repeat ("yes", "I don't know") skip the prefilter and
+    // every regex; only template selection and rendering run again.
+    //
+    // The cache is split into shards, each with its own lock and LRU list,
+    // so concurrent sessions rarely wait on each other. Evicted entries are
+    // reused in place, so a warm cache allocates only for longer texts.
+    class MatchCache {
+    public:
+        static constexpr size_t kShards = 16;
+        static constexpr size_t kDefaultCapacity = 4096;
+        // Longer messages rarely repeat and are not cached.
+        static constexpr size_t kMaxTextBytes = 256;
+
+        explicit MatchCache(size_t capacity = kDefaultCapacity);
+
+        // Total entries across all shards; 0 turns the cache off. Clears it.
+        void setCapacity(size_t capacity);
+        size_t capacity() const { return m_capacity; }
+
+        // Copies the cached result for `text` under `packSerial` into `out`.
+        bool lookup(uint64_t packSerial, std::string_view text, MatchResult& out);
+        void insert(uint64_t packSerial, std::string_view text, const MatchResult& result);
+        void clear();
+
+        MatchCacheStats stats() const;
+
+    private:
+        struct Entry {
+            uint64_t hash = 0;
+            uint64_t packSerial = 0;
+            std::string text;
+            int rule = -1;
+            std::vector<CaptureSpan> captures;
+        };
+
+        struct alignas(64) Shard {
+            mutable std::mutex mutex;
+            std::list<Entry> entries; // most recently used first
+            std::unordered_map<uint64_t, std::list<Entry>::iterator> index;
+            size_t capacity = 0;
+            size_t bytes = 0;
+            uint64_t hits = 0;
+            uint64_t misses = 0;
+        };
+
+        static size_t entryBytes(const Entry& entry);
+        Shard& shardFor(uint64_t hash) { return m_shards[(hash >> 48) % kShards]; }
+
+        std::array<Shard, kShards> m_shards;
+        size_t m_capacity = 0;
+    };
+
+}
+
+#endif //DEEPTHONK3D_MATCHCACHE_H
@@ -0,0 +1,564 @@
+#include "Matcher.h"
+#include "Instrumentation.h"
+#include "Normalizer.h"
+#include "Rules.h"
+#include "../utils/BinaryIO.h"
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <deque>
+#include <map>
+
+#if defined(__AVX2__) || defined(__SSE2__)
+#include <immintrin.h>
+#endif
+
+namespace deep_thonk {
+
+namespace {
+
+char foldAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+bool isLowerAscii(uint8_t byte) {
+    return byte >= 'a' && byte <= 'z';
+}
+
+// Past this many distinct start bytes the per-byte compares cost more than
+// the table lookup they replace.
+constexpr size_t kMaxVectorStartBytes = 16;
+
+// A set of literals at least one of which every match must contain.
+// An empty set means "no requirement could be proven".
+using LiteralSet = std::vector<std::string>;
+
+size_t shortestLength(const LiteralSet& set) {
+    size_t shortest = std::string::npos;
+    for (const auto& literal : set) {
+        shortest = std::min(shortest, literal.size());
+    }
+    return shortest;
+}
+
+// True if `a` filters better than `b`: longer shortest literal, then fewer alternatives.
+bool moreSelective(const LiteralSet& a, const LiteralSet& b) {
+    if (a.empty()) return false;
+    if (b.empty()) return true;
+    size_t lengthA = shortestLength(a);
+    size_t lengthB = shortestLength(b);
+    if (lengthA != lengthB) return lengthA > lengthB;
+    return a.size() < b.size();
+}
+
+// Walks an ECMAScript pattern and proves which literal text any match must
+// contain. Anything it does not understand simply yields no requirement, so
+// the result is always safe to filter on.
+class LiteralExtractor {
+public:
+    explicit LiteralExtractor(std::string_view pattern) : m_p(pattern) {}
+
+    LiteralSet run() {
+        LiteralSet result = alternation();
+        if (m_failed || m_pos != m_p.size()) return {};
+        return result;
+    }
+
+private:
+    struct Quantifier {
+        unsigned minimum = 1;
+        bool repeats = false;
+    };
+
+    bool atEnd() const { return m_pos >= m_p.size(); }
+
+    LiteralSet alternation() {
+        LiteralSet result = sequence();
+        bool required = !result.empty();
+        while (!m_failed && !atEnd() && m_p[m_pos] == '|') {
+            ++m_pos;
+            LiteralSet branch = sequence();
+            if (branch.empty()) {
+                required = false;
+            } else {
+                result.insert(result.end(), branch.begin(), branch.end());
+            }
+        }
+        if (!required) return {};
+        std::sort(result.begin(), result.end());
+        result.erase(std::unique(result.begin(), result.end()), result.end());
+        return result;
+    }
+
+    LiteralSet sequence() {
+        LiteralSet best;
+        std::string run;
+        auto consider = [&best](LiteralSet candidate) {
+            if (moreSelective(candidate, best)) best = std::move(candidate);
+        };
+        auto flush = [&]() {
+            if (!run.empty()) {
+                consider({run});
+                run.clear();
+            }
+        };
+
+        while (!m_failed && !atEnd()) {
+            char c = m_p[m_pos];
+            if (c == '|' || c == ')') break;
+
+            if (c == '^' || c == '$') {
+                ++m_pos; // zero-width, does not break a literal run
+                continue;
+            }
+            if (c == '*' || c == '+' || c == '?') {
+                m_failed = true; // quantifier with nothing to repeat
+                break;
+            }
+            if (c == '(') {
+                flush();
+                bool lookaround = false;
+                LiteralSet inner = group(lookaround);
+                Quantifier q = quantifier();
+                if (!lookaround && q.minimum > 0) consider(std::move(inner));
+                continue;
+            }
+            if (c == '[') {
+                flush();
+                skipClass();
+                quantifier();
+                continue;
+            }
+            if (c == '.') {
+                flush();
+                ++m_pos;
+                quantifier();
+                continue;
+            }
+
+            int literal = c == '\\' ? escape() : static_cast<unsigned char>(m_p[m_pos++]);
+            Quantifier q = quantifier();
+            if (literal < 0 || q.minimum == 0) {
+                flush();
+                continue;
+            }
+            run += foldAscii(static_cast<char>(literal));
+            if (q.repeats) flush();
+        }
+
+        flush();
+        return best;
+    }
+
+    LiteralSet group(bool& lookaround) {
+        ++m_pos; // '('
+        if (!atEnd() && m_p[m_pos] == '?') {
+            ++m_pos;
+            char kind = atEnd() ? '\0' : m_p[m_pos];
+            if (kind == ':') {
+                ++m_pos;
+            } else if (kind == '=' || kind == '!') {
+                lookaround = true;
+                ++m_pos;
+            } else if (kind == '<' && m_pos + 1 < m_p.size() && (m_p[m_pos + 1] == '=' || m_p[m_pos + 1] == '!')) {
+                lookaround = true;
+                m_pos += 2;
+            } else if (kind == '<') {
+                size_t close = m_p.find('>', m_pos);
+                if (close == std::string::npos) {
+                    m_failed = true;
+                    return {};
+                }
+                m_pos = close + 1;
+            } else {
+                m_failed = true;
+                return {};
+            }
+        }
+
+        LiteralSet inner = alternation();
+        if (atEnd() || m_p[m_pos] != ')') {
+            m_failed = true;
+            return {};
+        }
+        ++m_pos;
+        return lookaround ? LiteralSet{} : inner;
+    }
+
+    void skipClass() {
+        ++m_pos; // '['
+        if (!atEnd() && m_p[m_pos] == '^') ++m_pos;
+        if (!atEnd() && m_p[m_pos] == ']') ++m_pos;
+        while (!atEnd() && m_p[m_pos] != ']') {
+            if (m_p[m_pos] == '\\') ++m_pos;
+            ++m_pos;
+        }
+        if (atEnd()) {
+            m_failed = true;
+            return;
+        }
+        ++m_pos; // ']'
+    }
+
+    // Consumes an escape sequence; returns its literal byte or -1 for classes,
+    // assertions, back-references and anything not worth tracking.
+    int escape() {
+        ++m_pos; // '\\'
+        if (atEnd()) {
+            m_failed = true;
+            return -1;
+        }
+        char e = m_p[m_pos++];
+        switch (e) {
+            case 'n': return '\n';
+            case 't': return '\t';
+            case 'x': m_pos += 2; return -1;
+            case 'u': m_pos += 4; return -1;
+            case 'c': m_pos += 1; return -1;
+            default: break;
+        }
+        if (std::isalnum(static_cast<unsigned char>(e))) {
+            while (std::isdigit(static_cast<unsigned char>(e)) && !atEnd() && std::isdigit(static_cast<unsigned char>(m_p[m_pos]))) {
+                ++m_pos;
+            }
+            return -1;
+        }
+        return static_cast<unsigned char>(e);
+    }
+
+    Quantifier quantifier() {
+        Quantifier q;
+        if (atEnd()) return q;
+
+        char c = m_p[m_pos];
+        if (c == '*') {
+            q.minimum = 0;
+            q.repeats = true;
+            ++m_pos;
+        } else if (c == '+') {
+            q.repeats = true;
+            ++m_pos;
+        } else if (c == '?') {
+            q.minimum = 0;
+            ++m_pos;
+        } else if (c == '{' && m_pos + 1 < m_p.size() && std::isdigit(static_cast<unsigned char>(m_p[m_pos + 1]))) {
+            size_t close = m_p.find('}', m_pos);
+            if (close == std::string::npos) return q; // a literal '{'
+            std::string body(m_p.substr(m_pos + 1, close - m_pos - 1));
+            q.minimum = static_cast<unsigned>(std::stoul(body));
+            q.repeats = body != "1" && body != "1,1";
+            m_pos = close + 1;
+        } else {
+            return q;
+        }
+
+        if (!atEnd() && m_p[m_pos] == '?') ++m_pos; // non-greedy
+        return q;
+    }
+
+    std::string_view m_p;
+    size_t m_pos = 0;
+    bool m_failed = false;
+};
+
+}
+
+std::vector<std::string> Matcher::requiredLiterals(std::string_view pattern) {
+    return LiteralExtractor(pattern).run();
+}
+
+void Matcher::build(const RulePack& pack) {
+    const std::vector<Rule>& rules = pack.rules;
+    m_ruleCount = rules.size();
+    m_nodes.clear();
+    m_edges.clear();
+    m_outputs.clear();
+    m_filtered.assign(rules.size(), 0);
+    std::fill(std::begin(m_rootNext), std::end(m_rootNext), 0);
+
+    // Build a plain trie first, then flatten it.
+    std::vector<std::map<uint8_t, uint32_t>> children(1);
+    std::vector<std::vector<uint32_t>> outputs(1);
+    for (uint32_t index = 0; index < rules.size(); ++index) {
+        for (const auto& literal : requiredLiterals(foldPattern(pack.str(rules[index].patternString)))) {
+            uint32_t state = 0;
+            for (char c : literal) {
+                auto byte = static_cast<uint8_t>(c);
+                auto it = children[state].find(byte);
+                if (it == children[state].end()) {
+                    auto next = static_cast<uint32_t>(children.size());
+                    children[state][byte] = next;
+                    children.emplace_back();
+                    outputs.emplace_back();
+                    state = next;
+                } else {
+                    state = it->second;
+                }
+            }
+            if (outputs[state].empty() || outputs[state].back() != index) {
+                outputs[state].push_back(index);
+            }
+            m_filtered[index] = 1;
+        }
+    }
+
+    m_nodes.resize(children.size());
+    for (uint32_t state = 0; state < children.size(); ++state) {
+        Node& node = m_nodes[state];
+        node.firstEdge = static_cast<uint32_t>(m_edges.size());
+        node.edgeCount = static_cast<uint32_t>(children[state].size());
+        for (auto [byte, target] : children[state]) {
+            m_edges.push_back({byte, target});
+        }
+        node.firstOutput = static_cast<uint32_t>(m_outputs.size());
+        node.outputCount = static_cast<uint32_t>(outputs[state].size());
+        m_outputs.insert(m_outputs.end(), outputs[state].begin(), outputs[state].end());
+    }
+    for (auto [byte, target] : children[0]) {
+        m_rootNext[byte] = target;
+    }
+
+    // Breadth-first failure and dictionary-suffix links.
+    std::deque<uint32_t> queue;
+    for (auto [byte, target] : children[0]) {
+        queue.push_back(target);
+    }
+    while (!queue.empty()) {
+        uint32_t state = queue.front();
+        queue.pop_front();
+        for (auto [byte, target] : children[state]) {
+            uint32_t fail = step(m_nodes[state].fail, byte);
+            m_nodes[target].fail = fail;
+            m_nodes[target].outputLink = m_nodes[fail].outputCount ? fail : m_nodes[fail].outputLink;
+            queue.push_back(target);
+        }
+    }
+
+    m_order.resize(rules.size());
+    for (uint32_t index = 0; index < rules.size(); ++index) {
+        m_order[index] = index;
+    }
+    std::stable_sort(m_order.begin(), m_order.end(), [&rules](uint32_t a, uint32_t b) {
+        if (rules[a].rank != rules[b].rank) return rules[a].rank > rules[b].rank;
+        return rules[a].patternString.length > rules[b].patternString.length;
+    });
+    indexStartBytes();
+}
+
+void Matcher::indexStartBytes() {
+    m_startBytes.clear();
+    for (unsigned byte = 0; byte < 256; ++byte) {
+        if (m_rootNext[byte]) m_startBytes.push_back(static_cast<uint8_t>(byte));
+    }
+    if (m_startBytes.size() > kMaxVectorStartBytes) m_startBytes.clear();
+}
+
+// Literals are stored folded, so a lower-case letter must also be found in
+// its upper-case form: OR-ing 0x20 into the input maps exactly 'A'..'Z' onto
+// 'a'..'z' for those compares. Every other byte is compared as is, which
+// keeps the vector result identical to the scalar loop's.
+size_t Matcher::skipToStart(const char* data, size_t pos, size_t size) const {
+#if defined(__AVX2__)
+    constexpr size_t kWidth = 32;
+    const __m256i caseBit = _mm256_set1_epi8(0x20);
+    while (!m_startBytes.empty() && pos + kWidth <= size) {
+        __m256i chunk = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data + pos));
+        __m256i folded = _mm256_or_si256(chunk, caseBit);
+        __m256i hits = _mm256_setzero_si256();
+        for (uint8_t byte : m_startBytes) {
+            __m256i probe = isLowerAscii(byte) ? folded : chunk;
+            hits = _mm256_or_si256(hits, _mm256_cmpeq_epi8(probe, _mm256_set1_epi8(static_cast<char>(byte))));
+        }
+        auto mask = static_cast<uint32_t>(_mm256_movemask_epi8(hits));
+        if (mask) return pos + std::countr_zero(mask);
+        pos += kWidth;
+    }
+#elif defined(__SSE2__)
+    constexpr size_t kWidth = 16;
+    const __m128i caseBit = _mm_set1_epi8(0x20);
+    while (!m_startBytes.empty() && pos + kWidth <= size) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + pos));
+        __m128i folded = _mm_or_si128(chunk, caseBit);
+        __m128i hits = _mm_setzero_si128();
+        for (uint8_t byte : m_startBytes) {
+            __m128i probe = isLowerAscii(byte) ? folded : chunk;
+            hits = _mm_or_si128(hits, _mm_cmpeq_epi8(probe, _mm_set1_epi8(static_cast<char>(byte))));
+        }
+        auto mask = static_cast<uint32_t>(_mm_movemask_epi8(hits));
+        if (mask) return pos + std::countr_zero(mask);
+        pos += kWidth;
+    }
+#endif
+    while (pos < size && !m_rootNext[static_cast<uint8_t>(foldAscii(data[pos]))]) {
+        ++pos;
+    }
+    return pos;
+}
+
+uint32_t Matcher::step(uint32_t state, uint8_t byte) const {
+    while (state != 0) {
+        const Node& node = m_nodes[state];
+        auto first = m_edges.begin() + node.firstEdge;
+        auto last = first + node.edgeCount;
+        auto it = std::lower_bound(first, last, byte, [](const Edge& edge, uint32_t b) { return edge.byte < b; });
+        if (it != last && it->byte == byte) return it->target;
+        state = node.fail;
+    }
+    return m_rootNext[byte];
+}
+
+void Matcher::save(BinaryWriter& out) const {
+    out.array(m_nodes);
+    out.array(m_edges);
+    out.array(m_outputs);
+    out.array(m_rootNext, 256);
+    out.array(m_filtered);
+    out.array(m_order);
+}
+
+bool Matcher::load(BinaryReader& in, size_t ruleCount) {
+    m_ruleCount = ruleCount;
+    if (!in.array(m_nodes) || !in.array(m_edges) || !in.array(m_outputs) || !in.array(m_rootNext, 256) ||
+        !in.array(m_filtered) || !in.array(m_order)) {
+        return false;
+    }
+    if (m_filtered.size() != ruleCount || m_order.size() != ruleCount || m_nodes.empty()) return false;
+    for (uint32_t index : m_order) {
+        if (index >= ruleCount) return false;
+    }
+    for (uint32_t index : m_outputs) {
+        if (index >= ruleCount) return false;
+    }
+
+    // The tables are walked without bounds checks, so every edge range,
+    // output range and state link must stay inside them, and following
+    // fail or output links must always end at the root.
+    const size_t nodeCount = m_nodes.size();
+    for (const Node& node : m_nodes) {
+        if (size_t(node.firstEdge) + node.edgeCount > m_edges.size() ||
+            size_t(node.firstOutput) + node.outputCount > m_outputs.size() ||
+            node.fail >= nodeCount || node.outputLink >= nodeCount) {
+            return false;
+        }
+    }
+    for (const Edge& edge : m_edges) {
+        if (edge.byte > 0xff || edge.target >= nodeCount) return false;
+    }
+    for (uint32_t target : m_rootNext) {
+        if (target >= nodeCount) return false;
+    }
+    if (m_nodes[0].fail != 0 || m_nodes[0].outputLink != 0 || !linksReachRoot(&Node::fail) ||
+        !linksReachRoot(&Node::outputLink)) {
+        return false;
+    }
+
+    indexStartBytes();
+    return true;
+}
+
+bool Matcher::linksReachRoot(uint32_t Node::*link) const {
+    // 0 = not seen, 1 = on the chain being followed, 2 = reaches the root.
+    std::vector<uint8_t> state(m_nodes.size(), 0);
+    state[0] = 2;
+    std::vector<uint32_t> chain;
+    for (uint32_t start = 1; start < m_nodes.size(); ++start) {
+        uint32_t node = start;
+        while (state[node] == 0) {
+            state[node] = 1;
+            chain.push_back(node);
+            node = m_nodes[node].*link;
+        }
+        if (state[node] == 1) return false; // a cycle
+        for (uint32_t seen : chain) state[seen] = 2;
+        chain.clear();
+    }
+    return true;
+}
+
+template <typename Visit>
+void Matcher::scan(std::string_view text, Visit&& visit) const {
+    if (m_edges.empty()) return;
+
+    const char* data = text.data();
+    const size_t size = text.size();
+    uint32_t state = 0;
+    for (size_t pos = 0; pos < size; ++pos) {
+        if (state == 0) {
+            pos = skipToStart(data, pos, size);
+            if (pos == size) break;
+        }
+        state = step(state, static_cast<uint8_t>(foldAscii(data[pos])));
+        uint32_t hit = m_nodes[state].outputCount ? state : m_nodes[state].outputLink;
+        for (; hit != 0; hit = m_nodes[hit].outputLink) {
+            const Node& node = m_nodes[hit];
+            for (uint32_t i = 0; i < node.outputCount; ++i) {
+                visit(m_outputs[node.firstOutput + i]);
+            }
+        }
+    }
+}
+
+namespace {
+
+// Per-thread candidate marks. Bumping the epoch clears every mark at once.
+struct CandidateMarks {
+    std::vector<uint32_t> stamps;
+    uint32_t epoch = 0;
+
+    void begin(size_t ruleCount) {
+        if (stamps.size() < ruleCount) stamps.resize(ruleCount, 0);
+        if (++epoch == 0) {
+            std::fill(stamps.begin(), stamps.end(), 0);
+            epoch = 1;
+        }
+    }
+};
+
+thread_local CandidateMarks t_marks;
+
+}
+
+int Matcher::findBest(const std::vector<Rule>& rules, std::string_view text, MatchResult& match,
+                      instrumentation::PackCounters* counters, uint64_t stepBudget) const {
+    CandidateMarks& marks = t_marks;
+    marks.begin(m_ruleCount);
+    scan(text, [&marks](uint32_t index) { marks.stamps[index] = marks.epoch; });
+
+    for (uint32_t index : m_order) {
+        if (m_filtered[index] && marks.stamps[index] != marks.epoch) continue;
+        Regex::Outcome outcome;
+        if (kInstrumentationEnabled && counters) {
+            uint64_t start = instrumentation::now();
+            outcome = rules[index].pattern.search(text, match.captures, stepBudget);
+            instrumentation::recordRule(counters, index, outcome == Regex::Outcome::Match, instrumentation::now() - start);
+        } else {
+            outcome = rules[index].pattern.search(text, match.captures, stepBudget);
+        }
+        if (outcome == Regex::Outcome::Match) {
+            match.rule = static_cast<int>(index);
+            return match.rule;
+        }
+        if (outcome == Regex::Outcome::OutOfBudget) {
+            match.rule = kOutOfBudget;
+            match.captures.clear();
+            return match.rule;
+        }
+    }
+    match.rule = -1;
+    match.captures.clear();
+    return -1;
+}
+
+void Matcher::collectCandidates(const std::string& text, std::vector<uint32_t>& out) const {
+    CandidateMarks& marks = t_marks;
+    marks.begin(m_ruleCount);
+    scan(text, [&marks](uint32_t index) { marks.stamps[index] = marks.epoch; });
+
+    for (uint32_t index = 0; index < m_ruleCount; ++index) {
+        if (!m_filtered[index] || marks.stamps[index] == marks.epoch) {
+            out.push_back(index);
+        }
+    }
+}
+
+}
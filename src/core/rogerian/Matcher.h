@@ -0,0 +1,110 @@
+#ifndef DEEPTHONK3D_MATCHER_H
+#define DEEPTHONK3D_MATCHER_H
+
+#include "Regex.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace deep_thonk {
+
+    struct Rule;
+    struct RulePack;
+    class BinaryReader;
+    namespace instrumentation { struct PackCounters; }
+    class BinaryWriter;
+
+    // The outcome of Matcher::findBest for one text: the winning rule (-1 for
+    // none) and its groups, [0] being the whole match.
+    struct MatchResult {
+        int rule = -1;
+        std::vector<CaptureSpan> captures;
+    };
+
+    // Compiled multi-pattern index over the rules of one RulePack.
+    //
+    // At load time every pattern is scanned for the literal text any match of
+    // it must contain (e.g. "i think" for "^I think (.*)$", or one of
+    // {"hello", "hi", "hey"} for "(?:Hello|Hi|Hey)"). Those literals are folded
+    // into a single Aho-Corasick automaton, so one pass over the input yields
+    // every rule that can possibly match. Only those candidates run their
+    // pattern, in winner order, and the first one that matches wins.
+    //
+    // While the automaton sits at its root, the scan jumps straight to the
+    // next byte that can begin a literal, 16 or 32 bytes at a time with
+    // SSE2/AVX2 where available and one table lookup per byte elsewhere.
+    class Matcher {
+    public:
+        // findBest gave up: its step budget ran out before a rule matched.
+        static constexpr int kOutOfBudget = -2;
+        static constexpr uint64_t kUnlimitedSteps = UINT64_MAX;
+
+        // Rebuilds the index for the rules of `pack`. Must be called again
+        // whenever the rule vector changes.
+        void build(const RulePack& pack);
+
+        // Returns the index of the winning rule, or -1 if nothing matches,
+        // and fills `match` with it. The winner is the rule with the highest
+        // rank, then the longest patternString; ties go to the rule that
+        // comes first in the pack. The patterns run share `stepBudget` (see
+        // Regex::search); if it runs out first, returns kOutOfBudget. With
+        // `counters`, every pattern run is timed and counted (instrumented
+        // builds only).
+        int findBest(const std::vector<Rule>& rules, std::string_view text, MatchResult& match,
+                     instrumentation::PackCounters* counters = nullptr, uint64_t stepBudget = kUnlimitedSteps) const;
+
+        // Appends, in pack order, the indices of the rules whose required
+        // literals occur in `text`, plus the rules that have none.
+        void collectCandidates(const std::string& text, std::vector<uint32_t>& out) const;
+
+        // The literal alternatives at least one of which every match of
+        // `pattern` contains, lower-cased. Empty if no such set exists.
+        static std::vector<std::string> requiredLiterals(std::string_view pattern);
+
+        // Binary form used by precompiled rule packs (see PackFile.h).
+        void save(BinaryWriter& out) const;
+        bool load(BinaryReader& in, size_t ruleCount);
+
+    private:
+        struct Node {
+            uint32_t firstEdge = 0;
+            uint32_t edgeCount = 0;
+            uint32_t fail = 0;
+            uint32_t outputLink = 0; // nearest suffix state with outputs, 0 if none
+            uint32_t firstOutput = 0;
+            uint32_t outputCount = 0;
+        };
+
+        struct Edge {
+            uint32_t byte; // widened from a byte so the struct has no padding
+            uint32_t target;
+        };
+
+        uint32_t step(uint32_t state, uint8_t byte) const;
+        // True if following `link` from any state ends at the root; load()
+        // rejects tables that would send step() or scan() round in a loop.
+        bool linksReachRoot(uint32_t Node::*link) const;
+        // Derives m_startBytes from m_rootNext; run after build() and load().
+        void indexStartBytes();
+        // First position at or after `pos` whose folded byte has a root edge,
+        // or `size` if there is none.
+        size_t skipToStart(const char* data, size_t pos, size_t size) const;
+        template <typename Visit>
+        void scan(std::string_view text, Visit&& visit) const;
+
+        std::vector<Node> m_nodes;
+        std::vector<Edge> m_edges;
+        std::vector<uint32_t> m_outputs; // rule indices, grouped per node
+        uint32_t m_rootNext[256] = {};
+        // Distinct bytes with a root edge, for the vector skip. Left empty when
+        // there are too many to be worth comparing one by one.
+        std::vector<uint8_t> m_startBytes;
+        std::vector<uint8_t> m_filtered;    // 1 if the rule has required literals
+        std::vector<uint32_t> m_order;      // rule indices in winner order
+        size_t m_ruleCount = 0;
+    };
+
+}
+
+#endif //DEEPTHONK3D_MATCHER_H
@@ -0,0 +1,322 @@
+#include "Normalizer.h"
+#include <algorithm>
+#include <vector>
+
+namespace deep_thonk {
+
+namespace {
+
+constexpr uint32_t kInvalid = UINT32_MAX;
+
+// Base letter of U+00C0..U+017F. '*' marks the ones that fold to two letters
+// or are not letters at all; fold() handles those by hand.
+constexpr std::string_view kLatinBase =
+    "aaaaaa*ceeeeiiiidnooooo*ouuuuy**"  // U+00C0
+    "aaaaaa*ceeeeiiiidnooooo*ouuuuy*y"  // U+00E0
+    "aaaaaaccccccccddddeeeeeeeeeegggg"  // U+0100
+    "gggghhhhiiiiiiiiii**jjkkklllllll"  // U+0120
+    "lllnnnnnnnnnoooooo**rrrrrrssssss"  // U+0140
+    "ssttttttuuuuuuuuuuuuwwyyyzzzzzzs"; // U+0160
+
+struct Decoded {
+    uint32_t codepoint;
+    uint32_t length;
+};
+
+// Malformed sequences decode as one kInvalid byte, so any input round-trips.
+Decoded decode(std::string_view s, size_t pos) {
+    auto lead = static_cast<uint8_t>(s[pos]);
+    if (lead < 0x80) return {lead, 1};
+
+    uint32_t length = lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC2 ? 2 : 0;
+    if (length == 0 || lead > 0xF4 || pos + length > s.size()) return {kInvalid, 1};
+    uint32_t codepoint = lead & (0x7F >> length);
+    for (uint32_t i = 1; i < length; ++i) {
+        auto next = static_cast<uint8_t>(s[pos + i]);
+        if ((next & 0xC0) != 0x80) return {kInvalid, 1};
+        codepoint = (codepoint << 6) | (next & 0x3F);
+    }
+    constexpr uint32_t kShortest[] = {0, 0, 0x80, 0x800, 0x10000};
+    if (codepoint < kShortest[length] || (codepoint >= 0xD800 && codepoint <= 0xDFFF) || codepoint > 0x10FFFF) {
+        return {kInvalid, 1};
+    }
+    return {codepoint, length};
+}
+
+bool isAsciiWord(uint8_t c) {
+    uint8_t lower = c | 0x20;
+    return (lower >= 'a' && lower <= 'z') || c == '\'';
+}
+
+char foldAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+// What one codepoint folds to.
+struct Folded {
+    char bytes[2] = {};
+    uint8_t length = 0;
+    bool word = false;
+    bool keep = false; // copy the source bytes unchanged instead of `bytes`
+
+    static Folded text(std::string_view s, bool word) {
+        Folded f;
+        f.length = static_cast<uint8_t>(s.size());
+        for (size_t i = 0; i < s.size(); ++i) f.bytes[i] = s[i];
+        f.word = word;
+        return f;
+    }
+    static Folded kept(bool word) {
+        Folded f;
+        f.word = word;
+        f.keep = true;
+        return f;
+    }
+    static Folded encoded(uint32_t codepoint) { // U+0080..U+07FF, a letter
+        Folded f;
+        f.bytes[0] = static_cast<char>(0xC0 | (codepoint >> 6));
+        f.bytes[1] = static_cast<char>(0x80 | (codepoint & 0x3F));
+        f.length = 2;
+        f.word = true;
+        return f;
+    }
+};
+
+// Latin letters lose their accents; Greek and Cyrillic capitals are
+// lower-cased. Anything else outside ASCII is kept as written and counts as a
+// letter unless it sits in a punctuation or symbol block.
+Folded fold(uint32_t codepoint) {
+    if (codepoint < 0x80) {
+        char c = foldAscii(static_cast<char>(codepoint));
+        return Folded::text(std::string_view(&c, 1), isAsciiWord(static_cast<uint8_t>(codepoint)));
+    }
+    if (codepoint == kInvalid) return Folded::kept(false);
+
+    if (codepoint >= 0xC0 && codepoint <= 0x17F) {
+        switch (codepoint) {
+            case 0xC6: case 0xE6: return Folded::text("ae", true);
+            case 0xDE: case 0xFE: return Folded::text("th", true);
+            case 0xDF: return Folded::text("ss", true);
+            case 0x132: case 0x133: return Folded::text("ij", true);
+            case 0x152: case 0x153: return Folded::text("oe", true);
+            case 0xD7: case 0xF7: return Folded::kept(false); // multiplication and division signs
+            default: return Folded::text(kLatinBase.substr(codepoint - 0xC0, 1), true);
+        }
+    }
+    if (codepoint < 0xC0) {
+        if (codepoint == 0xA0) return Folded::text(" ", false);
+        bool letter = codepoint == 0xAA || codepoint == 0xB5 || codepoint == 0xBA; // ª µ º
+        return Folded::kept(letter);
+    }
+
+    switch (codepoint) {
+        case 0x02BC: case 0x2018: case 0x2019: return Folded::text("'", true);
+        case 0x202F: case 0x205F: case 0x3000: return Folded::text(" ", false);
+        case 0xFEFF: return Folded::kept(false);
+        default: break;
+    }
+    if (codepoint >= 0x0300 && codepoint <= 0x036F) return Folded::text("", true); // combining accents
+    if (codepoint >= 0x0391 && codepoint <= 0x03A9 && codepoint != 0x03A2) return Folded::encoded(codepoint + 0x20);
+    if (codepoint >= 0x0410 && codepoint <= 0x042F) return Folded::encoded(codepoint + 0x20);
+    if (codepoint >= 0x0400 && codepoint <= 0x040F) return Folded::encoded(codepoint + 0x50);
+    if (codepoint >= 0x2000 && codepoint <= 0x200A) return Folded::text(" ", false);
+
+    bool separator = (codepoint >= 0x2000 && codepoint <= 0x2BFF) || (codepoint >= 0x3000 && codepoint <= 0x303F) ||
+                     (codepoint >= 0xFE30 && codepoint <= 0xFE4F) || (codepoint >= 0xFF00 && codepoint <= 0xFF0F) ||
+                     (codepoint >= 0xFF1A && codepoint <= 0xFF20);
+    return Folded::kept(!separator);
+}
+
+}
+
+void normalize(std::string_view source, NormalizedText& out) {
+    std::string& text = out.m_text;
+    std::vector<uint32_t>& offsets = out.m_sourceOffsets;
+    text.clear();
+    text.reserve(source.size());
+    offsets.clear();
+    out.m_words.clear();
+    out.m_source = source;
+    out.m_identity = true;
+
+    bool inWord = false;
+    uint32_t wordBegin = 0;
+    auto boundary = [&](bool word) {
+        if (word == inWord) return;
+        auto here = static_cast<uint32_t>(text.size());
+        if (word) {
+            wordBegin = here;
+        } else if (here > wordBegin) {
+            out.m_words.push_back({wordBegin, here});
+        }
+        inWord = word;
+    };
+
+    size_t pos = 0;
+    while (pos < source.size()) {
+        auto lead = static_cast<uint8_t>(source[pos]);
+        if (lead < 0x80) {
+            boundary(isAsciiWord(lead));
+            text += foldAscii(static_cast<char>(lead));
+            if (!out.m_identity) offsets.push_back(static_cast<uint32_t>(pos));
+            ++pos;
+            continue;
+        }
+
+        if (out.m_identity) {
+            // Everything so far was ASCII and mapped one to one.
+            out.m_identity = false;
+            offsets.reserve(source.size());
+            for (uint32_t i = 0; i < text.size(); ++i) offsets.push_back(i);
+        }
+
+        Decoded decoded = decode(source, pos);
+        Folded folded = fold(decoded.codepoint);
+        boundary(folded.word);
+        if (folded.keep) {
+            text.append(source.substr(pos, decoded.length));
+            for (uint32_t i = 0; i < decoded.length; ++i) offsets.push_back(static_cast<uint32_t>(pos + i));
+        } else {
+            text.append(folded.bytes, folded.length);
+            offsets.insert(offsets.end(), folded.length, static_cast<uint32_t>(pos));
+        }
+        pos += decoded.length;
+    }
+    boundary(false);
+}
+
+namespace {
+
+// Folds the class starting at pattern[pos] == '[' onto `out` and returns the
+// position after its ']'. A member that folds to several characters cannot
+// stay in the class, which matches one character, so "[æs]" becomes
+// "(?:ae|[s])". Returns npos, with the reason in `error`, when that cannot
+// keep the meaning: in a negated class or as a range endpoint.
+size_t foldClass(std::string_view pattern, size_t pos, std::string& out, std::string* error) {
+    struct Member {
+        size_t begin; // offset in `body`
+        size_t length;
+        size_t source; // offset in `pattern`
+        size_t sourceLength;
+        bool sequence; // folds to several characters
+        bool dash;     // an unescaped '-'
+    };
+    std::string body;
+    std::vector<Member> members;
+    bool negated = pos + 1 < pattern.size() && pattern[pos + 1] == '^';
+    size_t at = pos + (negated ? 2 : 1);
+    while (at < pattern.size() && pattern[at] != ']') {
+        char c = pattern[at];
+        if (c == '\\') {
+            size_t length = at + 1 < pattern.size() ? 1 + decode(pattern, at + 1).length : 1;
+            members.push_back({body.size(), length, at, length, false, false});
+            body.append(pattern.substr(at, length));
+            at += length;
+            continue;
+        }
+        Decoded decoded = decode(pattern, at);
+        Folded folded = fold(decoded.codepoint);
+        bool sequence = !folded.keep && folded.length > 1 && static_cast<uint8_t>(folded.bytes[0]) < 0x80;
+        members.push_back({body.size(), 0, at, decoded.length, sequence, c == '-'});
+        if (folded.keep) {
+            body.append(pattern.substr(at, decoded.length));
+        } else {
+            body.append(folded.bytes, folded.length);
+        }
+        members.back().length = body.size() - members.back().begin;
+        at += decoded.length;
+    }
+
+    std::string_view opening = negated ? "[^" : "[";
+    if (at == pattern.size()) {
+        // Unterminated; left for the regex compiler to reject.
+        out.append(opening);
+        out += body;
+        return at;
+    }
+
+    auto reject = [&](const Member& member, const char* where) {
+        if (error) {
+            *error = "\"" + std::string(pattern.substr(member.source, member.sourceLength)) + "\" folds to \"" +
+                     body.substr(member.begin, member.length) + "\" and cannot be " + where;
+        }
+        return std::string_view::npos;
+    };
+
+    std::vector<std::string_view> sequences;
+    std::string rest;
+    for (size_t i = 0; i < members.size(); ++i) {
+        const Member& member = members[i];
+        std::string_view text(body.data() + member.begin, member.length);
+        if (member.dash && i > 0 && i + 1 < members.size()) {
+            if (members[i - 1].sequence) return reject(members[i - 1], "a range endpoint");
+            if (members[i + 1].sequence) return reject(members[i + 1], "a range endpoint");
+        }
+        if (!member.sequence) {
+            rest.append(text);
+        } else if (negated) {
+            return reject(member, "in a negated class");
+        } else if (std::find(sequences.begin(), sequences.end(), text) == sequences.end()) {
+            sequences.push_back(text);
+        }
+    }
+
+    if (sequences.empty()) {
+        out.append(opening);
+        out += rest;
+        out += ']';
+        return at + 1;
+    }
+    out += "(?:";
+    for (size_t i = 0; i < sequences.size(); ++i) {
+        if (i) out += '|';
+        out.append(sequences[i]);
+    }
+    if (!rest.empty()) {
+        out += "|[";
+        out += rest;
+        out += ']';
+    }
+    out += ')';
+    return at + 1;
+}
+
+}
+
+std::string foldPattern(std::string_view pattern, std::string* error) {
+    std::string out;
+    out.reserve(pattern.size());
+
+    size_t pos = 0;
+    while (pos < pattern.size()) {
+        char c = pattern[pos];
+        if (c == '\\') {
+            size_t length = pos + 1 < pattern.size() ? 1 + decode(pattern, pos + 1).length : 1;
+            out.append(pattern.substr(pos, length));
+            pos += length;
+            continue;
+        }
+        if (c == '[') {
+            pos = foldClass(pattern, pos, out, error);
+            if (pos == std::string_view::npos) return {};
+            continue;
+        }
+
+        Decoded decoded = decode(pattern, pos);
+        Folded folded = fold(decoded.codepoint);
+        if (folded.keep) {
+            out.append(pattern.substr(pos, decoded.length));
+        } else if (folded.length > 1 && static_cast<uint8_t>(folded.bytes[0]) < 0x80) {
+            // "æ+" must repeat "ae", not just the "e".
+            out += "(?:";
+            out.append(folded.bytes, folded.length);
+            out += ')';
+        } else {
+            out.append(folded.bytes, folded.length);
+        }
+        pos += decoded.length;
+    }
+    return out;
+}
+
+}
@@ -0,0 +1,76 @@
+#ifndef DEEPTHONK3D_NORMALIZER_H
+#define DEEPTHONK3D_NORMALIZER_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace deep_thonk {
+
+    // A user message folded for matching: UTF-8 decoded, lower-cased,
+    // stripped of accents ("Você" -> "voce", "NÃO" -> "nao"), with typographic
+    // apostrophes turned into '\'' and Unicode spaces into ' ', and split into
+    // words. Rule patterns are folded the same way (foldPattern), so the
+    // prefilter and the regexes run on text(), and reflection looks words up
+    // by their folded form.
+    //
+    // Every byte of text() remembers where it came from in the source, so
+    // captures and unreflected words are copied from the user's own text with
+    // their case and accents intact.
+    //
+    // The buffers are reused from one normalize() to the next; after the
+    // first few messages normalising allocates nothing.
+    class NormalizedText {
+    public:
+        // A word of text(): a run of letters and apostrophes. Digits,
+        // punctuation and symbols separate words.
+        struct Word {
+            uint32_t begin = 0;
+            uint32_t end = 0;
+        };
+
+        const std::string& text() const { return m_text; }
+        std::span<const Word> words() const { return m_words; }
+        std::string_view source() const { return m_source; }
+
+        // Source offset of text()[offset]; text().size() maps to the end of
+        // the source.
+        size_t sourceOffset(size_t offset) const {
+            if (offset >= m_text.size()) return m_source.size();
+            return m_identity ? offset : m_sourceOffsets[offset];
+        }
+
+        // The source text that text()[begin, end) was folded from.
+        std::string_view sourceSlice(size_t begin, size_t end) const {
+            size_t from = sourceOffset(begin);
+            return m_source.substr(from, sourceOffset(end) - from);
+        }
+
+    private:
+        friend void normalize(std::string_view source, NormalizedText& out);
+
+        std::string m_text;
+        std::vector<uint32_t> m_sourceOffsets; // unused while m_identity holds
+        std::vector<Word> m_words;
+        std::string_view m_source;
+        bool m_identity = true; // pure ASCII input: offsets map one to one
+    };
+
+    // Folds `source` into `out`. `out` refers to `source`, which must stay
+    // alive for as long as `out` is read.
+    void normalize(std::string_view source, NormalizedText& out);
+
+    // `pattern` with its literal characters folded like normalize() folds
+    // text, so a pattern compiled from the result matches normalised text
+    // without case-insensitive matching. Escapes (`\S`, `\x41`, ...) are
+    // kept as written; a letter spelled as an escape must be lower case.
+    // A class member that folds to several characters ("[æ]") becomes an
+    // alternative ("(?:ae)"). In a negated class or as a range endpoint it
+    // cannot be, so the result is then empty and `error` says why.
+    std::string foldPattern(std::string_view pattern, std::string* error = nullptr);
+
+}
+
+#endif //DEEPTHONK3D_NORMALIZER_H
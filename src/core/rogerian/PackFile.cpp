@@ -0,0 +1,153 @@
+#include "PackFile.h"
+#include "Normalizer.h"
+#include "Template.h"
+#include "../utils/BinaryIO.h"
+#include <cstring>
+
+namespace deep_thonk {
+
+namespace {
+
+constexpr char kMagic[8] = {'D', 'T', 'P', 'A', 'C', 'K', '\0', '\0'};
+
+// A rule as stored in the blob; its regex is compiled again on load.
+struct RuleRecord {
+    StringRef id;
+    StringRef patternString;
+    uint32_t category;
+    uint32_t firstTemplate;
+    uint32_t templateCount;
+    uint32_t selection;
+    int32_t rank;
+    uint32_t firstMemory;
+    uint32_t memoryCount;
+    uint32_t memorySlot;
+};
+
+bool inPool(StringRef ref, size_t poolSize) {
+    return size_t(ref.offset) + ref.length <= poolSize;
+}
+
+bool inRange(uint32_t first, uint32_t count, size_t size) {
+    return size_t(first) + count <= size;
+}
+
+}
+
+uint64_t hashRuleSource(std::string_view jsonContent) {
+    return fnv1a64(jsonContent.data(), jsonContent.size());
+}
+
+std::string writePackFile(const std::string& locale, const RulePack& pack, uint64_t sourceHash) {
+    BinaryWriter payload;
+
+    payload.string(locale);
+    payload.u32(static_cast<uint32_t>(pack.locale));
+    payload.string(pack.strings);
+    payload.array(pack.categories);
+    payload.array(pack.reflectPairs);
+    pack.reflection.save(payload);
+
+    std::vector<RuleRecord> records;
+    records.reserve(pack.rules.size());
+    for (const auto& rule : pack.rules) {
+        records.push_back({rule.id, rule.patternString, rule.category, rule.firstTemplate, rule.templateCount, rule.selection,
+                           rule.rank, rule.firstMemory, rule.memoryCount, rule.memorySlot});
+    }
+    payload.array(records);
+    payload.array(pack.templates);
+    payload.array(pack.templateParts);
+    payload.u32(pack.neutralRule);
+    pack.matcher.save(payload);
+
+    PackFileHeader header{};
+    std::memcpy(header.magic, kMagic, sizeof(kMagic));
+    header.version = kPackFileVersion;
+    header.sourceHash = sourceHash;
+    header.payloadSize = payload.buffer().size();
+    header.checksum = fnv1a64(payload.buffer().data(), payload.buffer().size());
+
+    std::string blob(reinterpret_cast<const char*>(&header), sizeof(header));
+    blob += payload.buffer();
+    return blob;
+}
+
+bool readPackFile(const char* data, size_t size, uint64_t expectedSourceHash, std::string& locale, RulePack& pack) {
+    PackFileHeader header{};
+    if (size < sizeof(header)) return false;
+    std::memcpy(&header, data, sizeof(header));
+    if (std::memcmp(header.magic, kMagic, sizeof(kMagic)) != 0 || header.version != kPackFileVersion ||
+        header.sourceHash != expectedSourceHash || header.payloadSize != size - sizeof(header)) {
+        return false;
+    }
+
+    const char* payload = data + sizeof(header);
+    if (fnv1a64(payload, header.payloadSize) != header.checksum) return false;
+
+    BinaryReader in(payload, header.payloadSize);
+    std::string_view localeName;
+    std::string_view strings;
+    uint32_t localeValue = 0;
+    if (!in.string(localeName) || !in.u32(localeValue) || !in.string(strings)) return false;
+    locale.assign(localeName);
+    pack.locale = static_cast<Locale>(localeValue);
+    // The whole pool is copied in one go; every other string is a reference into it.
+    pack.strings.assign(strings);
+
+    if (!in.array(pack.categories) || !in.array(pack.reflectPairs) || !pack.reflection.load(in)) return false;
+    for (StringRef category : pack.categories) {
+        if (!inPool(category, strings.size())) return false;
+    }
+    for (const auto& [from, to] : pack.reflectPairs) {
+        if (!inPool(from, strings.size()) || !inPool(to, strings.size())) return false;
+    }
+
+    std::vector<RuleRecord> records;
+    if (!in.array(records) || !in.array(pack.templates) || !in.array(pack.templateParts) || !in.u32(pack.neutralRule)) {
+        return false;
+    }
+    if (pack.neutralRule != kNoRule && pack.neutralRule >= records.size()) return false;
+
+    for (const auto& tmpl : pack.templates) {
+        if (!inPool(tmpl.text, strings.size()) || !inRange(tmpl.firstPart, tmpl.partCount, pack.templateParts.size())) {
+            return false;
+        }
+        for (const auto& part : pack.parts(tmpl)) {
+            if (part.slot == 0 && size_t(part.offset) + part.length > tmpl.text.length) return false;
+        }
+    }
+
+    pack.rules.clear();
+    pack.rules.reserve(records.size());
+    std::vector<std::string> groupNames;
+    for (const auto& record : records) {
+        if (!inPool(record.id, strings.size()) || !inPool(record.patternString, strings.size()) ||
+            record.category >= pack.categories.size() ||
+            !inRange(record.firstTemplate, record.templateCount, pack.templates.size()) ||
+            !inRange(record.firstMemory, record.memoryCount, pack.templates.size())) {
+            return false;
+        }
+        Rule& rule = pack.rules.emplace_back();
+        rule.id = record.id;
+        rule.patternString = record.patternString;
+        rule.category = record.category;
+        rule.firstTemplate = record.firstTemplate;
+        rule.templateCount = record.templateCount;
+        rule.selection = record.selection;
+        rule.rank = record.rank;
+        rule.firstMemory = record.firstMemory;
+        rule.memoryCount = record.memoryCount;
+        rule.memorySlot = record.memorySlot;
+        if (rule.selection & kSelectWeighted) {
+            uint64_t total = pack.totalWeight(rule);
+            if (total == 0 || total > UINT32_MAX) return false;
+        }
+        std::string error;
+        std::string folded = foldPattern(stripGroupNames(pack.str(rule.patternString), groupNames), &error);
+        if (!error.empty() || !rule.pattern.compile(folded)) return false;
+    }
+
+    return pack.matcher.load(in, pack.rules.size()) && in.atEnd();
+}
+
+}
@@ -0,0 +1,47 @@
+#ifndef DEEPTHONK3D_PACKFILE_H
+#define DEEPTHONK3D_PACKFILE_H
+
+#include "Rules.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+namespace deep_thonk {
+
+    // Precompiled rule packs (".dtpack").
+    //
+    // Layout: a fixed PackFileHeader followed by the payload. The payload
+    // holds the pack's interned string pool exactly as it is kept in memory,
+    // then the categories, rules, templates and template parts (all
+    // referencing the pool by offset), the reflection table and the matcher
+    // automaton as flat arrays. The header carries a checksum of the payload and a
+    // fingerprint of the JSON it was compiled from, so a blob that no longer
+    // matches its source is rejected and the caller falls back to the JSON.
+    //
+    // Rule patterns are compiled again when a blob is read (a pattern
+    // compiles in microseconds); everything else is taken as-is. Reflection keys and
+    // matcher literals are stored folded (see Normalizer.h), so a change to
+    // the folding rules needs a new version.
+    constexpr uint32_t kPackFileVersion = 5;
+
+    struct PackFileHeader {
+        char magic[8];
+        uint32_t version;
+        uint32_t reserved;
+        uint64_t sourceHash;
+        uint64_t payloadSize;
+        uint64_t checksum;
+    };
+
+    // Fingerprint of a JSON rule source, as stored in PackFileHeader::sourceHash.
+    uint64_t hashRuleSource(std::string_view jsonContent);
+
+    std::string writePackFile(const std::string& locale, const RulePack& pack, uint64_t sourceHash);
+
+    // Rebuilds a pack from a blob. Returns false if the blob is truncated,
+    // corrupt, from another format version or compiled from another source.
+    bool readPackFile(const char* data, size_t size, uint64_t expectedSourceHash, std::string& locale, RulePack& pack);
+
+}
+
+#endif //DEEPTHONK3D_PACKFILE_H
@@ -0,0 +1,71 @@
+#ifndef DEEPTHONK3D_PACKSLOT_H
+#define DEEPTHONK3D_PACKSLOT_H
+
+#include "Instrumentation.h"
+#include "Rules.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+namespace deep_thonk {
+
+    // The published pack for one locale; null until a lazily declared locale
+    // is first compiled (see Engine::addLazyRulePack). Readers take a snapshot
+    // and keep using it for as long as they hold it; a reload builds a complete new
+    // pack and swaps the pointer, so a reply in flight always finishes on the
+    // pack it started with and nothing ever waits on a lock. The old pack is
+    // freed when its last reader lets go.
+    //
+    // `generation` is bumped after every swap. Sessions compare it against the
+    // generation of their cached snapshot, so the common case costs one
+    // relaxed load instead of a reference-count round trip.
+    //
+    // The slot also tells instrumentation which packs are published, so the
+    // counters of a replaced pack are dropped with it.
+    class PackSlot {
+    public:
+        explicit PackSlot(std::shared_ptr<const RulePack> pack) : m_pack(std::move(pack)) {
+            if (auto published = load()) instrumentation::publishPack(published->serial);
+        }
+
+        ~PackSlot() {
+            if (auto published = load()) instrumentation::retirePack(published->serial);
+        }
+
+        PackSlot(const PackSlot&) = delete;
+        PackSlot& operator=(const PackSlot&) = delete;
+
+        std::shared_ptr<const RulePack> load() const {
+#if defined(__cpp_lib_atomic_shared_ptr)
+            return m_pack.load(std::memory_order_acquire);
+#else
+            return std::atomic_load_explicit(&m_pack, std::memory_order_acquire);
+#endif
+        }
+
+        // Publishes `pack`; callers serialise stores (Engine holds its reload mutex).
+        void store(std::shared_ptr<const RulePack> pack) {
+            if (pack) instrumentation::publishPack(pack->serial);
+#if defined(__cpp_lib_atomic_shared_ptr)
+            std::shared_ptr<const RulePack> replaced = m_pack.exchange(std::move(pack), std::memory_order_acq_rel);
+#else
+            std::shared_ptr<const RulePack> replaced = std::atomic_exchange_explicit(&m_pack, std::move(pack), std::memory_order_acq_rel);
+#endif
+            m_generation.fetch_add(1, std::memory_order_release);
+            if (replaced) instrumentation::retirePack(replaced->serial);
+        }
+
+        uint64_t generation() const { return m_generation.load(std::memory_order_acquire); }
+
+    private:
+#if defined(__cpp_lib_atomic_shared_ptr)
+        std::atomic<std::shared_ptr<const RulePack>> m_pack;
+#else
+        std::shared_ptr<const RulePack> m_pack;
+#endif
+        std::atomic<uint64_t> m_generation{0};
+    };
+
+}
+
+#endif //DEEPTHONK3D_PACKSLOT_H
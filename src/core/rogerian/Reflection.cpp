@@ -0,0 +1,141 @@
+#include "Reflection.h"
+#include "Normalizer.h"
+#include "../utils/BinaryIO.h"
+#include <algorithm>
+
+namespace deep_thonk {
+
+namespace {
+
+char foldAscii(char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+uint64_t hashFolded(std::string_view word) {
+    uint64_t hash = 14695981039346656037ull; // FNV-1a
+    for (char c : word) {
+        hash ^= static_cast<unsigned char>(foldAscii(c));
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+bool equalsFolded(std::string_view folded, std::string_view word) {
+    if (folded.size() != word.size()) return false;
+    for (size_t i = 0; i < word.size(); ++i) {
+        if (folded[i] != foldAscii(word[i])) return false;
+    }
+    return true;
+}
+
+// Scratch for the string_view entry points.
+thread_local NormalizedText t_scratch;
+
+}
+
+void ReflectionTable::build(const std::vector<std::pair<std::string_view, std::string_view>>& pairs) {
+    m_pool.clear();
+    size_t capacity = 8;
+    while (capacity < pairs.size() * 2) capacity *= 2;
+    m_slots.assign(capacity, Slot{});
+
+    NormalizedText folded;
+    for (const auto& [source, value] : pairs) {
+        normalize(source, folded);
+        std::string_view key = folded.text();
+        if (key.empty() || key.size() > UINT16_MAX || value.size() > UINT16_MAX) continue;
+
+        uint64_t hash = hashFolded(key);
+        size_t mask = m_slots.size() - 1;
+        size_t index = hash & mask;
+        while (m_slots[index].keyLength != 0 &&
+               !equalsFolded(std::string_view(m_pool).substr(m_slots[index].keyOffset, m_slots[index].keyLength), key)) {
+            index = (index + 1) & mask;
+        }
+
+        Slot& slot = m_slots[index];
+        if (slot.keyLength == 0) {
+            slot.keyOffset = static_cast<uint32_t>(m_pool.size());
+            slot.keyLength = static_cast<uint16_t>(key.size());
+            m_pool += key;
+        }
+        slot.valueOffset = static_cast<uint32_t>(m_pool.size());
+        slot.valueLength = static_cast<uint16_t>(value.size());
+        m_pool += value;
+    }
+}
+
+void ReflectionTable::save(BinaryWriter& out) const {
+    out.string(m_pool);
+    out.array(m_slots);
+}
+
+bool ReflectionTable::load(BinaryReader& in) {
+    std::string_view pool;
+    if (!in.string(pool) || !in.array(m_slots)) return false;
+    m_pool.assign(pool);
+
+    if (m_slots.empty() || (m_slots.size() & (m_slots.size() - 1)) != 0) return false;
+    bool hasEmptySlot = false;
+    for (const Slot& slot : m_slots) {
+        if (size_t(slot.keyOffset) + slot.keyLength > m_pool.size() || size_t(slot.valueOffset) + slot.valueLength > m_pool.size()) {
+            return false;
+        }
+        hasEmptySlot |= slot.keyLength == 0;
+    }
+    return hasEmptySlot; // lookups stop at the first empty slot
+}
+
+const ReflectionTable::Slot* ReflectionTable::find(std::string_view word, uint64_t hash) const {
+    if (m_slots.empty()) return nullptr;
+
+    size_t mask = m_slots.size() - 1;
+    for (size_t index = hash & mask;; index = (index + 1) & mask) {
+        const Slot& slot = m_slots[index];
+        if (slot.keyLength == 0) return nullptr;
+        if (equalsFolded(std::string_view(m_pool).substr(slot.keyOffset, slot.keyLength), word)) return &slot;
+    }
+}
+
+std::string_view ReflectionTable::lookup(std::string_view word) const {
+    NormalizedText& folded = t_scratch;
+    normalize(word, folded);
+    const Slot* slot = find(folded.text(), hashFolded(folded.text()));
+    if (!slot) return {};
+    return std::string_view(m_pool).substr(slot->valueOffset, slot->valueLength);
+}
+
+void ReflectionTable::reflect(std::string_view text, std::string& out) const {
+    NormalizedText& folded = t_scratch;
+    normalize(text, folded);
+    reflect(folded, 0, folded.text().size(), out);
+}
+
+void ReflectionTable::reflect(const NormalizedText& text, size_t begin, size_t end, std::string& out) const {
+    std::string_view folded = text.text();
+    std::span<const NormalizedText::Word> words = text.words();
+    size_t sourceLength = text.sourceOffset(end) - text.sourceOffset(begin);
+    out.reserve(out.size() + sourceLength + sourceLength / 2);
+
+    // Words cut by the range are reflected as far as they reach into it.
+    auto word = std::lower_bound(words.begin(), words.end(), begin,
+                                 [](const NormalizedText::Word& w, size_t offset) { return w.end <= offset; });
+    size_t pos = begin;
+    for (; word != words.end() && word->begin < end; ++word) {
+        size_t wordBegin = std::max<size_t>(word->begin, begin);
+        size_t wordEnd = std::min<size_t>(word->end, end);
+        out.append(text.sourceSlice(pos, wordBegin));
+
+        std::string_view token = folded.substr(wordBegin, wordEnd - wordBegin);
+        const Slot* slot = find(token, hashFolded(token));
+        if (slot) {
+            out.append(m_pool, slot->valueOffset, slot->valueLength);
+        } else {
+            out.append(text.sourceSlice(wordBegin, wordEnd));
+        }
+        pos = wordEnd;
+    }
+    out.append(text.sourceSlice(pos, end));
+}
+
+}
@@ -0,0 +1,61 @@
+#ifndef DEEPTHONK3D_REFLECTION_H
+#define DEEPTHONK3D_REFLECTION_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace deep_thonk {
+
+    class BinaryReader;
+    class BinaryWriter;
+    class NormalizedText;
+
+    // Pronoun reflection dictionary ("i" -> "you", "my" -> "your", ...),
+    // compiled once per RulePack.
+    //
+    // Keys and values live in one string pool; lookups go through a small
+    // open-addressed table hashed on the folded word (see NormalizedText), so
+    // "Você", "VOCE" and "você" all find the same entry and reflecting a
+    // phrase neither allocates nor lower-cases into temporaries.
+    class ReflectionTable {
+    public:
+        // Later pairs override earlier ones with the same folded key.
+        void build(const std::vector<std::pair<std::string_view, std::string_view>>& pairs);
+
+        // Appends `text` to `out`, replacing every word (a run of letters and
+        // apostrophes, in any script) found in the table. Everything between
+        // words is copied through untouched.
+        void reflect(std::string_view text, std::string& out) const;
+
+        // Same for the source of `text.text()[begin, end)`, reusing the words
+        // found when the message was normalised. Unreplaced words keep their
+        // original case and accents.
+        void reflect(const NormalizedText& text, size_t begin, size_t end, std::string& out) const;
+
+        // The replacement for `word`, or an empty view if it has none.
+        std::string_view lookup(std::string_view word) const;
+
+        // Binary form used by precompiled rule packs (see PackFile.h).
+        void save(BinaryWriter& out) const;
+        bool load(BinaryReader& in);
+
+    private:
+        struct Slot {
+            uint32_t keyOffset = 0;
+            uint32_t valueOffset = 0;
+            uint16_t keyLength = 0; // 0 marks an empty slot
+            uint16_t valueLength = 0;
+        };
+
+        const Slot* find(std::string_view word, uint64_t hash) const;
+
+        std::string m_pool;
+        std::vector<Slot> m_slots; // power-of-two sized, at most half full
+    };
+
+}
+
+#endif //DEEPTHONK3D_REFLECTION_H
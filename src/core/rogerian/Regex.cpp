@@ -0,0 +1,911 @@
+#include "Regex.h"
+#include <algorithm>
+#include <cctype>
+#include <cstddef>
+#include <limits>
+
+namespace deep_thonk {
+
+namespace {
+
+using ByteSet = std::array<uint64_t, 4>;
+
+void addByte(ByteSet& set, uint8_t byte) {
+    set[byte >> 6] |= uint64_t(1) << (byte & 63);
+}
+
+bool hasByte(const ByteSet& set, uint8_t byte) {
+    return (set[byte >> 6] >> (byte & 63)) & 1;
+}
+
+void addRange(ByteSet& set, uint8_t first, uint8_t last) {
+    for (unsigned byte = first; byte <= last; ++byte) addByte(set, static_cast<uint8_t>(byte));
+}
+
+void addSet(ByteSet& set, const ByteSet& other) {
+    for (size_t i = 0; i < set.size(); ++i) set[i] |= other[i];
+}
+
+ByteSet complement(ByteSet set) {
+    for (auto& word : set) word = ~word;
+    return set;
+}
+
+bool isWordByte(uint8_t byte) {
+    return (byte < 0x80 && std::isalnum(byte)) || byte == '_';
+}
+
+// \d, \w and \s as std::regex sees them on char in the "C" locale.
+ByteSet classSet(char name) {
+    ByteSet set{};
+    switch (std::tolower(static_cast<unsigned char>(name))) {
+    case 'd':
+        addRange(set, '0', '9');
+        break;
+    case 'w':
+        addRange(set, '0', '9');
+        addRange(set, 'A', 'Z');
+        addRange(set, 'a', 'z');
+        addByte(set, '_');
+        break;
+    case 's':
+        for (char c : {' ', '\t', '\n', '\v', '\f', '\r'}) addByte(set, static_cast<uint8_t>(c));
+        break;
+    }
+    return std::isupper(static_cast<unsigned char>(name)) ? complement(set) : set;
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') return c - '0';
+    if (c >= 'a' && c <= 'f') return c - 'a' + 10;
+    if (c >= 'A' && c <= 'F') return c - 'A' + 10;
+    return -1;
+}
+
+void appendUtf8(uint32_t code, std::string& out) {
+    if (code < 0x80) {
+        out += static_cast<char>(code);
+    } else if (code < 0x800) {
+        out += static_cast<char>(0xc0 | (code >> 6));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+    } else {
+        out += static_cast<char>(0xe0 | (code >> 12));
+        out += static_cast<char>(0x80 | ((code >> 6) & 0x3f));
+        out += static_cast<char>(0x80 | (code & 0x3f));
+    }
+}
+
+// Ordered list of live threads (program counters) with their capture slots.
+// A sparse set, so membership tests and clearing are O(1).
+struct ThreadList {
+    std::vector<uint32_t> sparse;
+    std::vector<uint32_t> dense;
+    std::vector<uint32_t> captures; // `slots` per dense entry
+    uint32_t size = 0;
+
+    void reset(size_t programSize, size_t slots) {
+        if (sparse.size() < programSize) {
+            sparse.resize(programSize);
+            dense.resize(programSize);
+        }
+        if (captures.size() < programSize * slots) captures.resize(programSize * slots);
+        size = 0;
+    }
+
+    bool contains(uint32_t pc) const {
+        uint32_t index = sparse[pc];
+        return index < size && dense[index] == pc;
+    }
+
+    uint32_t insert(uint32_t pc) {
+        sparse[pc] = size;
+        dense[size] = pc;
+        return size++;
+    }
+};
+
+// One entry of the explicit stack that follows empty transitions: either a
+// state to explore or, with slot != kExplore, a capture slot to restore.
+struct Frame {
+    static constexpr uint32_t kExplore = UINT32_MAX;
+
+    uint32_t pc = 0;
+    uint32_t slot = kExplore;
+    uint32_t value = 0;
+};
+
+struct Scratch {
+    ThreadList lists[2];
+    std::vector<Frame> stack;
+    std::vector<uint32_t> captures;
+    std::vector<uint32_t> best;
+    std::vector<uint64_t> visited; // backtracker: one bit per (state, position)
+};
+
+// Texts short enough that a bit per (state, position) fits in 32 KB are
+// searched by the backtracker.
+constexpr size_t kMaxBacktrackStates = 256 * 1024;
+
+bool isWordAt(std::string_view text, size_t pos) {
+    return pos < text.size() && isWordByte(static_cast<uint8_t>(text[pos]));
+}
+
+bool isWordBoundary(std::string_view text, size_t pos) {
+    return (pos > 0 && isWordAt(text, pos - 1)) != isWordAt(text, pos);
+}
+
+// Per-thread VM state, reused by every search so a warm search never allocates.
+thread_local Scratch t_scratch;
+
+}
+
+// Recursive-descent parser that emits code as it goes. Each piece of the
+// pattern becomes a Fragment: instructions whose jump targets are relative
+// to the fragment's first instruction, leaving through fragment.size().
+// That lets a fragment be copied for counted repetition and appended
+// anywhere by shifting its targets.
+class Regex::Compiler {
+public:
+    Compiler(std::string_view pattern, Regex& regex) : m_p(pattern), m_regex(regex) {}
+
+    bool run(std::string& error) {
+        Fragment body = alternation();
+        if (!m_failed && !atEnd()) fail("unmatched ')'");
+        if (m_failed) {
+            error = m_error;
+            return false;
+        }
+
+        Fragment program{{Op::Save, 0, 0}};
+        append(program, body);
+        program.push_back({Op::Save, 1, 0});
+        program.push_back({Op::Match, 0, 0});
+        if (program.size() > kMaxProgramSize) {
+            error = "pattern is too large";
+            return false;
+        }
+        m_regex.m_program = std::move(program);
+        m_regex.m_groupCount = m_groupCount;
+        return true;
+    }
+
+private:
+    using Fragment = std::vector<Inst>;
+
+    bool atEnd() const { return m_pos >= m_p.size(); }
+
+    void fail(const std::string& message) {
+        if (m_failed) return;
+        m_failed = true;
+        m_error = message + " at offset " + std::to_string(m_pos);
+    }
+
+    void append(Fragment& to, const Fragment& from) {
+        if (to.size() + from.size() > kMaxProgramSize) {
+            fail("pattern is too large");
+            return;
+        }
+        auto shift = static_cast<uint32_t>(to.size());
+        for (Inst inst : from) {
+            if (inst.op == Op::Split) {
+                inst.arg += shift;
+                inst.alt += shift;
+            } else if (inst.op == Op::Jump) {
+                inst.arg += shift;
+            }
+            to.push_back(inst);
+        }
+    }
+
+    // `first` before `second`, or the other way round for lazy quantifiers.
+    static Inst split(uint32_t first, uint32_t second, bool lazy) {
+        return lazy ? Inst{Op::Split, second, first} : Inst{Op::Split, first, second};
+    }
+
+    Fragment optional(const Fragment& inner, bool lazy) {
+        auto size = static_cast<uint32_t>(inner.size());
+        Fragment out{split(1, size + 1, lazy)};
+        append(out, inner);
+        return out;
+    }
+
+    Fragment star(const Fragment& inner, bool lazy) {
+        auto size = static_cast<uint32_t>(inner.size());
+        Fragment out{split(1, size + 2, lazy)};
+        append(out, inner);
+        out.push_back({Op::Jump, 0, 0});
+        return out;
+    }
+
+    Fragment plus(const Fragment& inner, bool lazy) {
+        auto size = static_cast<uint32_t>(inner.size());
+        Fragment out = inner;
+        out.push_back(split(0, size + 1, lazy));
+        return out;
+    }
+
+    // `inner` repeated `minimum` to `maximum` times (kUnbounded for no limit).
+    Fragment repeat(const Fragment& inner, uint32_t minimum, uint32_t maximum, bool lazy) {
+        uint64_t copies = maximum == kUnbounded ? std::max<uint32_t>(minimum, 1) : maximum;
+        if (copies * (inner.size() + 2) > kMaxProgramSize) {
+            fail("pattern is too large");
+            return {};
+        }
+
+        Fragment out;
+        if (maximum == kUnbounded) {
+            for (uint32_t i = 1; i < minimum; ++i) append(out, inner);
+            append(out, minimum > 0 ? plus(inner, lazy) : star(inner, lazy));
+            return out;
+        }
+        for (uint32_t i = 0; i < minimum; ++i) append(out, inner);
+        // x{2,4} is xx(?:x(?:x)?)?: nested, so the optional copies are tried
+        // in order instead of as independent choices.
+        Fragment tail;
+        for (uint32_t i = minimum; i < maximum; ++i) {
+            Fragment copy = inner;
+            append(copy, tail);
+            tail = optional(copy, lazy);
+        }
+        append(out, tail);
+        return out;
+    }
+
+    Fragment alternation() {
+        Fragment first = sequence();
+        if (m_failed || atEnd() || m_p[m_pos] != '|') return first;
+        ++m_pos;
+        Fragment rest = alternation();
+
+        auto firstSize = static_cast<uint32_t>(first.size());
+        auto restSize = static_cast<uint32_t>(rest.size());
+        Fragment out{{Op::Split, 1, firstSize + 2}};
+        append(out, first);
+        out.push_back({Op::Jump, firstSize + restSize + 2, 0});
+        append(out, rest);
+        return out;
+    }
+
+    Fragment sequence() {
+        Fragment out;
+        while (!m_failed && !atEnd() && m_p[m_pos] != '|' && m_p[m_pos] != ')') {
+            bool assertion = false;
+            Fragment piece = atom(assertion);
+            uint32_t minimum = 1;
+            uint32_t maximum = 1;
+            bool lazy = false;
+            if (quantifier(minimum, maximum, lazy)) {
+                if (assertion) {
+                    fail("nothing to repeat");
+                    break;
+                }
+                piece = repeat(piece, minimum, maximum, lazy);
+            }
+            append(out, piece);
+        }
+        return out;
+    }
+
+    Fragment atom(bool& assertion) {
+        char c = m_p[m_pos];
+        switch (c) {
+        case '(':
+            return group();
+        case '[':
+            return {{Op::Set, internSet(characterClass()), 0}};
+        case '.': {
+            ByteSet set{};
+            addByte(set, '\n');
+            addByte(set, '\r');
+            ++m_pos;
+            return {{Op::Set, internSet(complement(set)), 0}};
+        }
+        case '^':
+        case '$':
+            ++m_pos;
+            assertion = true;
+            return {{c == '^' ? Op::Begin : Op::End, 0, 0}};
+        case '\\':
+            return escape(assertion);
+        case '*':
+        case '+':
+        case '?':
+            fail("nothing to repeat");
+            return {};
+        case '{': {
+            uint32_t minimum = 0;
+            uint32_t maximum = 0;
+            bool lazy = false;
+            if (quantifier(minimum, maximum, lazy)) {
+                fail("nothing to repeat");
+                return {};
+            }
+            break;
+        }
+        default:
+            break;
+        }
+        ++m_pos;
+        return {{Op::Byte, static_cast<uint8_t>(c), 0}};
+    }
+
+    Fragment group() {
+        ++m_pos; // '('
+        uint32_t group = 0;
+        if (!atEnd() && m_p[m_pos] == '?') {
+            ++m_pos;
+            char kind = atEnd() ? '\0' : m_p[m_pos];
+            if (kind == '=' || kind == '!') {
+                fail("lookahead cannot be matched in linear time");
+                return {};
+            }
+            if (kind == '<' && m_pos + 1 < m_p.size() && (m_p[m_pos + 1] == '=' || m_p[m_pos + 1] == '!')) {
+                fail("lookbehind cannot be matched in linear time");
+                return {};
+            }
+            if (kind != ':') {
+                fail("unsupported group syntax");
+                return {};
+            }
+            ++m_pos;
+        } else {
+            group = static_cast<uint32_t>(++m_groupCount);
+        }
+
+        Fragment inner = alternation();
+        if (m_failed) return {};
+        if (atEnd()) {
+            fail("missing ')'");
+            return {};
+        }
+        ++m_pos; // ')'
+        if (group == 0) return inner;
+
+        Fragment out{{Op::Save, 2 * group, 0}};
+        append(out, inner);
+        out.push_back({Op::Save, 2 * group + 1, 0});
+        return out;
+    }
+
+    Fragment escape(bool& assertion) {
+        ++m_pos; // '\\'
+        if (atEnd()) {
+            fail("pattern ends in '\\'");
+            return {};
+        }
+        char e = m_p[m_pos];
+        switch (e) {
+        case 'b':
+        case 'B':
+            ++m_pos;
+            assertion = true;
+            return {{e == 'b' ? Op::WordBoundary : Op::NotWordBoundary, 0, 0}};
+        case 'd':
+        case 'D':
+        case 'w':
+        case 'W':
+        case 's':
+        case 'S':
+            ++m_pos;
+            return {{Op::Set, internSet(classSet(e)), 0}};
+        case 'u': {
+            uint32_t code = 0;
+            if (!unicodeEscape(code)) return {};
+            std::string bytes;
+            appendUtf8(code, bytes);
+            Fragment out;
+            for (char byte : bytes) out.push_back({Op::Byte, static_cast<uint8_t>(byte), 0});
+            return out;
+        }
+        default: {
+            int byte = escapedByte();
+            if (byte < 0) return {};
+            return {{Op::Byte, static_cast<uint32_t>(byte), 0}};
+        }
+        }
+    }
+
+    // The byte of a single-byte escape (`\n`, `\x41`, `\.`), or -1 after
+    // reporting an error.
+    int escapedByte() {
+        char e = m_p[m_pos++];
+        switch (e) {
+        case 'n': return '\n';
+        case 'r': return '\r';
+        case 't': return '\t';
+        case 'f': return '\f';
+        case 'v': return '\v';
+        case '0': return 0;
+        case 'x': {
+            int high = m_pos + 1 < m_p.size() ? hexValue(m_p[m_pos]) : -1;
+            int low = high >= 0 ? hexValue(m_p[m_pos + 1]) : -1;
+            if (low < 0) {
+                fail("malformed \\x escape");
+                return -1;
+            }
+            m_pos += 2;
+            return high * 16 + low;
+        }
+        case 'c':
+            if (atEnd() || !std::isalpha(static_cast<unsigned char>(m_p[m_pos]))) {
+                fail("malformed \\c escape");
+                return -1;
+            }
+            return m_p[m_pos++] % 32;
+        case 'k':
+            --m_pos;
+            fail("back-references cannot be matched in linear time");
+            return -1;
+        default:
+            break;
+        }
+        if (e >= '1' && e <= '9') {
+            --m_pos;
+            fail("back-references cannot be matched in linear time");
+            return -1;
+        }
+        if (std::isalnum(static_cast<unsigned char>(e))) {
+            --m_pos;
+            fail(std::string("unknown escape '\\") + e + "'");
+            return -1;
+        }
+        return static_cast<uint8_t>(e);
+    }
+
+    bool unicodeEscape(uint32_t& code) {
+        ++m_pos; // 'u'
+        code = 0;
+        for (int i = 0; i < 4; ++i) {
+            int digit = m_pos < m_p.size() ? hexValue(m_p[m_pos]) : -1;
+            if (digit < 0) {
+                fail("malformed \\u escape");
+                return false;
+            }
+            code = code * 16 + static_cast<uint32_t>(digit);
+            ++m_pos;
+        }
+        return true;
+    }
+
+    ByteSet characterClass() {
+        ++m_pos; // '['
+        bool negate = !atEnd() && m_p[m_pos] == '^';
+        if (negate) ++m_pos;
+
+        ByteSet set{};
+        while (!m_failed) {
+            if (atEnd()) {
+                fail("unterminated character class");
+                break;
+            }
+            if (m_p[m_pos] == ']') {
+                ++m_pos;
+                break;
+            }
+            int first = classAtom(set);
+            if (first < 0 || m_pos + 1 >= m_p.size() || m_p[m_pos] != '-' || m_p[m_pos + 1] == ']') {
+                if (first >= 0) addByte(set, static_cast<uint8_t>(first));
+                continue;
+            }
+            ++m_pos; // '-'
+            int last = classAtom(set);
+            if (m_failed) break;
+            if (last < 0) {
+                fail("class escape used as a range bound");
+            } else if (last < first) {
+                fail("character range out of order");
+            } else {
+                addRange(set, static_cast<uint8_t>(first), static_cast<uint8_t>(last));
+            }
+        }
+        return negate ? complement(set) : set;
+    }
+
+    // One member of a class: returns its byte, or -1 if it was a class
+    // escape (added to `set` already) or an error.
+    int classAtom(ByteSet& set) {
+        char c = m_p[m_pos];
+        if (c == '[' && m_pos + 1 < m_p.size() && (m_p[m_pos + 1] == ':' || m_p[m_pos + 1] == '.' || m_p[m_pos + 1] == '=')) {
+            fail("character class names are not supported");
+            return -1;
+        }
+        if (c != '\\') {
+            ++m_pos;
+            return static_cast<uint8_t>(c);
+        }
+
+        ++m_pos; // '\\'
+        if (atEnd()) {
+            fail("pattern ends in '\\'");
+            return -1;
+        }
+        char e = m_p[m_pos];
+        switch (e) {
+        case 'b':
+            ++m_pos;
+            return '\b';
+        case 'd':
+        case 'D':
+        case 'w':
+        case 'W':
+        case 's':
+        case 'S':
+            ++m_pos;
+            addSet(set, classSet(e));
+            return -1;
+        case 'u': {
+            uint32_t code = 0;
+            if (!unicodeEscape(code)) return -1;
+            if (code >= 0x80) {
+                fail("\\u escapes in a class must be ASCII");
+                return -1;
+            }
+            return static_cast<int>(code);
+        }
+        default:
+            return escapedByte();
+        }
+    }
+
+    // Parses `*`, `+`, `?` or `{n}`, `{n,}`, `{n,m}` plus a lazy `?`.
+    // A `{` that does not start a valid count is left alone as a literal.
+    bool quantifier(uint32_t& minimum, uint32_t& maximum, bool& lazy) {
+        if (atEnd()) return false;
+        char c = m_p[m_pos];
+        if (c == '*' || c == '+' || c == '?') {
+            minimum = c == '+' ? 1 : 0;
+            maximum = c == '?' ? 1 : kUnbounded;
+            ++m_pos;
+        } else if (c == '{') {
+            size_t pos = m_pos + 1;
+            uint64_t low = 0;
+            uint64_t high = 0;
+            if (!number(pos, low)) return false;
+            high = low;
+            if (pos < m_p.size() && m_p[pos] == ',') {
+                ++pos;
+                high = kUnbounded;
+                if (pos < m_p.size() && m_p[pos] != '}' && !number(pos, high)) return false;
+            }
+            if (pos >= m_p.size() || m_p[pos] != '}') return false;
+            m_pos = pos + 1;
+            if (low > kMaxRepeat || (high != kUnbounded && high > kMaxRepeat)) {
+                fail("repetition count above " + std::to_string(kMaxRepeat));
+                return false;
+            }
+            if (high < low) {
+                fail("repetition range out of order");
+                return false;
+            }
+            minimum = static_cast<uint32_t>(low);
+            maximum = static_cast<uint32_t>(high);
+        } else {
+            return false;
+        }
+        lazy = !atEnd() && m_p[m_pos] == '?';
+        if (lazy) ++m_pos;
+        return true;
+    }
+
+    bool number(size_t& pos, uint64_t& value) const {
+        size_t start = pos;
+        value = 0;
+        while (pos < m_p.size() && std::isdigit(static_cast<unsigned char>(m_p[pos]))) {
+            value = std::min<uint64_t>(value * 10 + static_cast<uint64_t>(m_p[pos] - '0'), kUnbounded - 1);
+            ++pos;
+        }
+        return pos > start;
+    }
+
+    uint32_t internSet(const ByteSet& set) {
+        m_regex.m_sets.push_back(set);
+        return static_cast<uint32_t>(m_regex.m_sets.size() - 1);
+    }
+
+    static constexpr uint32_t kUnbounded = UINT32_MAX;
+
+    std::string_view m_p;
+    size_t m_pos = 0;
+    Regex& m_regex;
+    size_t m_groupCount = 0;
+    bool m_failed = false;
+    std::string m_error;
+};
+
+bool Regex::compile(std::string_view pattern, std::string* error) {
+    *this = Regex();
+    std::string message;
+    if (!Compiler(pattern, *this).run(message)) {
+        *this = Regex();
+        if (error) *error = message;
+        return false;
+    }
+    analyse();
+    return true;
+}
+
+void Regex::analyse() {
+    // Follow empty transitions from the start. A path that reaches a Match
+    // can match the empty string anywhere, so nothing can be skipped; a path
+    // that passes ^ can only start a match at offset 0.
+    std::vector<uint8_t> seen(m_program.size());
+    std::vector<std::pair<uint32_t, bool>> pending{{0, false}}; // pc, passed ^
+    bool unanchored = false;
+    bool emptyMatch = false;
+    m_firstBytes = {};
+    while (!pending.empty()) {
+        auto [pc, anchored] = pending.back();
+        pending.pop_back();
+        // Visited once unanchored and once anchored at most.
+        uint8_t mark = anchored ? 2 : 1;
+        if (seen[pc] & mark) continue;
+        seen[pc] |= mark;
+
+        const Inst& inst = m_program[pc];
+        switch (inst.op) {
+        case Op::Byte:
+            addByte(m_firstBytes, static_cast<uint8_t>(inst.arg));
+            unanchored = unanchored || !anchored;
+            break;
+        case Op::Set:
+            addSet(m_firstBytes, m_sets[inst.arg]);
+            unanchored = unanchored || !anchored;
+            break;
+        case Op::Match:
+            emptyMatch = true;
+            unanchored = unanchored || !anchored;
+            break;
+        case Op::Split:
+            pending.push_back({inst.alt, anchored});
+            pending.push_back({inst.arg, anchored});
+            break;
+        case Op::Jump:
+            pending.push_back({inst.arg, anchored});
+            break;
+        case Op::Begin:
+            pending.push_back({pc + 1, true});
+            break;
+        default:
+            pending.push_back({pc + 1, anchored});
+            break;
+        }
+    }
+    m_anchored = !unanchored;
+    m_hasFirstBytes = !emptyMatch;
+}
+
+Regex::Outcome Regex::search(std::string_view text, std::vector<CaptureSpan>& captures, uint64_t& budget) const {
+    if (m_program.empty()) return Outcome::NoMatch;
+    if (m_program.size() * (text.size() + 1) <= kMaxBacktrackStates) return backtrack(text, captures, budget);
+    return pikeVm(text, captures, budget);
+}
+
+// Depth-first, in priority order, like a backtracking matcher, but a
+// (state, position) pair that was explored once is never explored again:
+// from there it failed before and would fail again, whatever the captures
+// or the start position. That bounds a search at one step per pair.
+Regex::Outcome Regex::backtrack(std::string_view text, std::vector<CaptureSpan>& captures, uint64_t& budget) const {
+    const size_t size = text.size();
+    const size_t positions = size + 1;
+    Scratch& scratch = t_scratch;
+    scratch.visited.assign((m_program.size() * positions + 63) / 64, 0);
+    scratch.captures.resize(2 * (m_groupCount + 1));
+    std::vector<uint32_t>& caps = scratch.captures;
+    std::vector<Frame>& stack = scratch.stack;
+    uint64_t steps = 0;
+
+    for (size_t start = 0; start <= size; ++start) {
+        if (m_anchored && start > 0) break;
+        if (m_hasFirstBytes) {
+            while (start < size && !hasByte(m_firstBytes, static_cast<uint8_t>(text[start]))) ++start;
+            if (start == size) break;
+        }
+        std::fill(caps.begin(), caps.end(), CaptureSpan::kUnmatched);
+        stack.push_back({0, Frame::kExplore, static_cast<uint32_t>(start)});
+
+        while (!stack.empty()) {
+            Frame frame = stack.back();
+            stack.pop_back();
+            if (frame.slot != Frame::kExplore) {
+                caps[frame.slot] = frame.value;
+                continue;
+            }
+            uint32_t pc = frame.pc;
+            size_t pos = frame.value;
+            while (true) {
+                size_t bit = pc * positions + pos;
+                uint64_t mask = uint64_t(1) << (bit & 63);
+                if (scratch.visited[bit >> 6] & mask) break;
+                scratch.visited[bit >> 6] |= mask;
+                if (++steps > budget) {
+                    stack.clear();
+                    budget = 0;
+                    return Outcome::OutOfBudget;
+                }
+
+                const Inst& inst = m_program[pc];
+                bool follow = true;
+                switch (inst.op) {
+                case Op::Byte:
+                    follow = pos < size && static_cast<uint8_t>(text[pos]) == inst.arg;
+                    ++pos;
+                    break;
+                case Op::Set:
+                    follow = pos < size && hasByte(m_sets[inst.arg], static_cast<uint8_t>(text[pos]));
+                    ++pos;
+                    break;
+                case Op::Split:
+                    stack.push_back({inst.alt, Frame::kExplore, static_cast<uint32_t>(pos)});
+                    pc = inst.arg;
+                    continue;
+                case Op::Jump:
+                    pc = inst.arg;
+                    continue;
+                case Op::Save:
+                    stack.push_back({0, inst.arg, caps[inst.arg]});
+                    caps[inst.arg] = static_cast<uint32_t>(pos);
+                    break;
+                case Op::Begin:
+                    follow = pos == 0;
+                    break;
+                case Op::End:
+                    follow = pos == size;
+                    break;
+                case Op::WordBoundary:
+                    follow = isWordBoundary(text, pos);
+                    break;
+                case Op::NotWordBoundary:
+                    follow = !isWordBoundary(text, pos);
+                    break;
+                case Op::Match:
+                    stack.clear();
+                    budget -= steps;
+                    fillCaptures(caps.data(), captures);
+                    return Outcome::Match;
+                }
+                if (!follow) break;
+                ++pc;
+            }
+        }
+    }
+    budget -= steps;
+    return Outcome::NoMatch;
+}
+
+// Lock-step simulation for long texts, where the backtracker's bit per
+// (state, position) would cost too much memory to clear.
+Regex::Outcome Regex::pikeVm(std::string_view text, std::vector<CaptureSpan>& captures, uint64_t& budget) const {
+    const size_t slots = 2 * (m_groupCount + 1);
+    const size_t size = text.size();
+    Scratch& scratch = t_scratch;
+    ThreadList* current = &scratch.lists[0];
+    ThreadList* next = &scratch.lists[1];
+    current->reset(m_program.size(), slots);
+    next->reset(m_program.size(), slots);
+    scratch.captures.resize(slots);
+    std::vector<Frame>& stack = scratch.stack;
+    uint64_t steps = 0;
+    bool matched = false;
+
+    // Adds `start` and every state reachable from it without consuming input
+    // to `list`, in priority order, with scratch.captures as the captures so
+    // far. Each state is added once per position.
+    auto addThread = [&](ThreadList& list, uint32_t start, size_t pos) {
+        std::vector<uint32_t>& caps = scratch.captures;
+        stack.push_back({start, Frame::kExplore, 0});
+        while (!stack.empty()) {
+            Frame frame = stack.back();
+            stack.pop_back();
+            if (frame.slot != Frame::kExplore) {
+                caps[frame.slot] = frame.value;
+                continue;
+            }
+            for (uint32_t pc = frame.pc; !list.contains(pc);) {
+                uint32_t index = list.insert(pc);
+                ++steps;
+                const Inst& inst = m_program[pc];
+                bool follow = true;
+                switch (inst.op) {
+                case Op::Jump:
+                    pc = inst.arg;
+                    continue;
+                case Op::Split:
+                    stack.push_back({inst.alt, Frame::kExplore, 0});
+                    pc = inst.arg;
+                    continue;
+                case Op::Save:
+                    stack.push_back({0, inst.arg, caps[inst.arg]});
+                    caps[inst.arg] = static_cast<uint32_t>(pos);
+                    break;
+                case Op::Begin:
+                    follow = pos == 0;
+                    break;
+                case Op::End:
+                    follow = pos == size;
+                    break;
+                case Op::WordBoundary:
+                    follow = isWordBoundary(text, pos);
+                    break;
+                case Op::NotWordBoundary:
+                    follow = !isWordBoundary(text, pos);
+                    break;
+                default:
+                    // Consumes input or matches: the thread waits here.
+                    std::copy(caps.begin(), caps.end(), list.captures.begin() + static_cast<ptrdiff_t>(index * slots));
+                    follow = false;
+                    break;
+                }
+                if (!follow) break;
+                ++pc;
+            }
+        }
+    };
+
+    current->size = 0;
+    for (size_t pos = 0; pos <= size; ++pos) {
+        if (!matched && (pos == 0 || !m_anchored)) {
+            if (current->size == 0 && m_hasFirstBytes) {
+                while (pos < size && !hasByte(m_firstBytes, static_cast<uint8_t>(text[pos]))) ++pos;
+                if (pos == size) break;
+            }
+            std::fill(scratch.captures.begin(), scratch.captures.end(), CaptureSpan::kUnmatched);
+            addThread(*current, 0, pos);
+        }
+        if (current->size == 0) break;
+
+        next->size = 0;
+        for (uint32_t i = 0; i < current->size; ++i) {
+            const Inst& inst = m_program[current->dense[i]];
+            const uint32_t* caps = current->captures.data() + i * slots;
+            bool advance = false;
+            switch (inst.op) {
+            case Op::Byte:
+                ++steps;
+                advance = pos < size && static_cast<uint8_t>(text[pos]) == inst.arg;
+                break;
+            case Op::Set:
+                ++steps;
+                advance = pos < size && hasByte(m_sets[inst.arg], static_cast<uint8_t>(text[pos]));
+                break;
+            case Op::Match:
+                // Threads after this one have lower priority: drop them.
+                ++steps;
+                matched = true;
+                scratch.best.assign(caps, caps + slots);
+                i = current->size;
+                break;
+            default:
+                break; // empty transitions were followed when the thread was added
+            }
+            if (advance) {
+                std::copy(caps, caps + slots, scratch.captures.begin());
+                addThread(*next, current->dense[i] + 1, pos + 1);
+            }
+        }
+        std::swap(current, next);
+        if (steps > budget) {
+            budget = 0;
+            return Outcome::OutOfBudget;
+        }
+    }
+    budget -= steps;
+    if (!matched) return Outcome::NoMatch;
+    fillCaptures(scratch.best.data(), captures);
+    return Outcome::Match;
+}
+
+void Regex::fillCaptures(const uint32_t* slots, std::vector<CaptureSpan>& captures) const {
+    captures.resize(m_groupCount + 1);
+    for (size_t group = 0; group <= m_groupCount; ++group) {
+        uint32_t begin = slots[2 * group];
+        uint32_t end = slots[2 * group + 1];
+        captures[group] = begin != CaptureSpan::kUnmatched && end != CaptureSpan::kUnmatched ? CaptureSpan{begin, end} : CaptureSpan{};
+    }
+}
+
+bool Regex::search(std::string_view text, std::vector<CaptureSpan>& captures) const {
+    uint64_t budget = std::numeric_limits<uint64_t>::max();
+    return search(text, captures, budget) == Outcome::Match;
+}
+
+}
@@ -0,0 +1,112 @@
+#ifndef DEEPTHONK3D_REGEX_H
+#define DEEPTHONK3D_REGEX_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace deep_thonk {
+
+    // Where one capture group matched, as byte offsets into the searched text.
+    struct CaptureSpan {
+        static constexpr uint32_t kUnmatched = UINT32_MAX;
+
+        uint32_t begin = kUnmatched;
+        uint32_t end = kUnmatched;
+
+        bool matched() const { return begin != kUnmatched; }
+        uint32_t length() const { return end - begin; }
+    };
+
+    // Rule patterns, compiled to a Thompson automaton. Short texts are
+    // searched by a backtracker that remembers every (state, position) it
+    // has tried, longer ones by a Pike VM that advances every state over the
+    // text in lock step; either way a search costs at most O(text length x
+    // program size) whatever the pattern or input. std::regex backtracks
+    // without memory, and "(.+) (.+) you" against a long pasted message
+    // could take seconds.
+    //
+    // The syntax is the ECMAScript subset that has a linear-time match:
+    // literals, `.`, classes (`[a-z]`, `[^...]`, `\d\w\s` and negations),
+    // groups (`(...)`, `(?:...)`), `|`, greedy and lazy `* + ? {n} {n,}
+    // {n,m}`, and the assertions `^ $ \b \B`. Back-references and lookaround
+    // need backtracking and are rejected, as are repetition counts above
+    // kMaxRepeat and programs above kMaxProgramSize. Matching works on bytes
+    // like std::regex over std::string (`\uHHHH` stands for the UTF-8 bytes
+    // of the character), and prefers the same match: the leftmost one, and
+    // among those the one a backtracking engine would find first. As in
+    // ECMAScript, a loop never repeats an iteration that consumed nothing;
+    // libstdc++ sometimes does, so captures inside such loops can differ.
+    class Regex {
+    public:
+        static constexpr uint32_t kMaxRepeat = 1000;
+        static constexpr size_t kMaxProgramSize = 10000;
+
+        enum class Outcome { NoMatch, Match, OutOfBudget };
+
+        // Compiles `pattern`. On failure returns false, leaves the regex
+        // empty (matching nothing) and describes the problem in `error`.
+        bool compile(std::string_view pattern, std::string* error = nullptr);
+
+        // Capture groups, not counting group 0 (the whole match).
+        size_t groupCount() const { return m_groupCount; }
+        size_t programSize() const { return m_program.size(); }
+
+        // Finds the first match in `text`, like std::regex_search. On a match
+        // `captures` holds groupCount() + 1 spans. Each automaton state
+        // visited at each position costs one step from `budget`; once it
+        // runs out the search stops with OutOfBudget. A search never takes
+        // more than stepBound(text.size()) steps.
+        Outcome search(std::string_view text, std::vector<CaptureSpan>& captures, uint64_t& budget) const;
+        bool search(std::string_view text, std::vector<CaptureSpan>& captures) const;
+
+        uint64_t stepBound(size_t textSize) const { return 2 * uint64_t(m_program.size()) * (uint64_t(textSize) + 1); }
+
+    private:
+        enum class Op : uint8_t {
+            Byte,         // consume `arg` exactly
+            Set,          // consume a byte of m_sets[arg]
+            Split,        // try `arg` first, then `alt`
+            Jump,         // continue at `arg`
+            Save,         // record the position in capture slot `arg`
+            Begin,        // ^
+            End,          // $
+            WordBoundary, // \b
+            NotWordBoundary,
+            Match
+        };
+
+        struct Inst {
+            Op op = Op::Match;
+            uint32_t arg = 0;
+            uint32_t alt = 0;
+        };
+
+        using ByteSet = std::array<uint64_t, 4>;
+
+        class Compiler;
+        friend class Compiler;
+
+        // Derives m_anchored and m_firstBytes from the compiled program.
+        void analyse();
+        // The two ways search() runs the program; both find the same match.
+        Outcome backtrack(std::string_view text, std::vector<CaptureSpan>& captures, uint64_t& budget) const;
+        Outcome pikeVm(std::string_view text, std::vector<CaptureSpan>& captures, uint64_t& budget) const;
+        void fillCaptures(const uint32_t* slots, std::vector<CaptureSpan>& captures) const;
+
+        std::vector<Inst> m_program;
+        std::vector<ByteSet> m_sets;
+        size_t m_groupCount = 0;
+        // Every match starts at offset 0 (the pattern begins with ^).
+        bool m_anchored = false;
+        // Bytes a match can start with, when every match starts by
+        // consuming one; lets a search skip ahead while no thread is alive.
+        bool m_hasFirstBytes = false;
+        ByteSet m_firstBytes{};
+    };
+
+}
+
+#endif //DEEPTHONK3D_REGEX_H
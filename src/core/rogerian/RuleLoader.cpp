@@ -0,0 +1,349 @@
+#include "RuleLoader.h"
+#include "Normalizer.h"
+#include "Template.h"
+#include "../../third_party/nlohmann/json.hpp"
+#include <optional>
+#include <stdexcept>
+#include <unordered_map>
+
+using json = nlohmann::json;
+
+namespace deep_thonk {
+
+namespace {
+
+// Rough size of one rule in the JSON sources; only used to pre-size vectors.
+constexpr size_t kBytesPerRuleEstimate = 256;
+
+// Appends each distinct string to a pack's pool once.
+class StringInterner {
+public:
+    explicit StringInterner(std::string& pool) : m_pool(pool) {}
+
+    StringRef intern(std::string&& value) {
+        auto length = static_cast<uint32_t>(value.size());
+        auto [it, inserted] = m_offsets.try_emplace(std::move(value), static_cast<uint32_t>(m_pool.size()));
+        if (inserted) m_pool += it->first;
+        return {it->second, length};
+    }
+
+private:
+    std::string& m_pool;
+    std::unordered_map<std::string, uint32_t> m_offsets;
+};
+
+class RulePackSax {
+public:
+    using number_integer_t = json::number_integer_t;
+    using number_unsigned_t = json::number_unsigned_t;
+    using number_float_t = json::number_float_t;
+    using string_t = json::string_t;
+    using binary_t = json::binary_t;
+
+    RulePackSax(RulePack& pack, size_t sizeHint) : m_pack(pack), m_strings(pack.strings), m_sizeHint(sizeHint) {}
+
+    bool null() { return scalar(); }
+    bool boolean(bool value) {
+        if (m_skipDepth == 0 && !m_stack.empty() && top() == Frame::Rule && m_key == "noRepeat") {
+            if (value) m_pack.rules.back().selection |= kSelectNoRepeat;
+            return true;
+        }
+        return scalar();
+    }
+    bool number_integer(number_integer_t value) { return number(static_cast<int64_t>(value)); }
+    bool number_unsigned(number_unsigned_t value) {
+        return number(value > static_cast<number_unsigned_t>(INT64_MAX) ? INT64_MAX : static_cast<int64_t>(value));
+    }
+    bool number_float(number_float_t, const string_t&) { return number(std::nullopt); }
+    bool binary(binary_t&) { return scalar(); }
+
+    bool string(string_t& value) {
+        if (m_skipDepth > 0) return true;
+
+        switch (top()) {
+            case Frame::Root:
+                if (m_key == "locale") m_locale = std::move(value);
+                break;
+            case Frame::ReflectPair: {
+                auto& pair = m_pack.reflectPairs.back();
+                if (m_pairIndex == 0) pair.from = m_strings.intern(std::move(value));
+                else if (m_pairIndex == 1) pair.to = m_strings.intern(std::move(value));
+                ++m_pairIndex;
+                break;
+            }
+            case Frame::Rule: {
+                Rule& rule = m_pack.rules.back();
+                if (m_key == "id") {
+                    rule.id = m_strings.intern(std::move(value));
+                    m_ruleFields |= kHasId;
+                } else if (m_key == "category") {
+                    rule.category = categoryId(std::move(value));
+                    m_ruleFields |= kHasCategory;
+                } else if (m_key == "pattern") {
+                    rule.patternString = m_strings.intern(std::move(value));
+                    m_ruleFields |= kHasPattern;
+                }
+                break;
+            }
+            case Frame::Outs:
+                m_pack.templates.emplace_back().text = m_strings.intern(std::move(value));
+                ++m_pack.rules.back().templateCount;
+                break;
+            case Frame::Memory:
+                m_memoryTexts.push_back(std::move(value));
+                break;
+            case Frame::Weights:
+                return scalar();
+            default:
+                break;
+        }
+        return true;
+    }
+
+    bool start_object(std::size_t) {
+        if (m_skipDepth > 0 || (!m_stack.empty() && top() != Frame::Rules)) {
+            ++m_skipDepth;
+        } else if (m_stack.empty()) {
+            m_stack.push_back(Frame::Root);
+        } else {
+            m_pack.rules.emplace_back().firstTemplate = static_cast<uint32_t>(m_pack.templates.size());
+            m_ruleFields = 0;
+            m_stack.push_back(Frame::Rule);
+        }
+        return true;
+    }
+
+    bool key(string_t& name) {
+        if (m_skipDepth == 0) m_key = std::move(name);
+        return true;
+    }
+
+    bool end_object() {
+        if (m_skipDepth > 0) {
+            --m_skipDepth;
+            return true;
+        }
+        if (top() == Frame::Rule) finishRule(m_pack.rules.back());
+        m_stack.pop_back();
+        return true;
+    }
+
+    bool start_array(std::size_t elements) {
+        if (m_skipDepth > 0 || m_stack.empty()) {
+            ++m_skipDepth;
+            return true;
+        }
+
+        Frame frame = top();
+        if (frame == Frame::Root && m_key == "reflect") {
+            m_stack.push_back(Frame::Reflect);
+        } else if (frame == Frame::Root && m_key == "rules") {
+            // Text JSON never announces its element count; fall back to the input size.
+            size_t expected = elements != static_cast<std::size_t>(-1) ? elements : m_sizeHint / kBytesPerRuleEstimate;
+            m_pack.rules.reserve(expected);
+            m_stack.push_back(Frame::Rules);
+        } else if (frame == Frame::Reflect) {
+            m_pack.reflectPairs.emplace_back();
+            m_pairIndex = 0;
+            m_stack.push_back(Frame::ReflectPair);
+        } else if (frame == Frame::Rule && m_key == "outs") {
+            m_stack.push_back(Frame::Outs);
+        } else if (frame == Frame::Rule && m_key == "memory") {
+            m_stack.push_back(Frame::Memory);
+        } else if (frame == Frame::Rule && m_key == "weights") {
+            m_pack.rules.back().selection |= kSelectWeighted;
+            m_stack.push_back(Frame::Weights);
+        } else {
+            ++m_skipDepth;
+        }
+        return true;
+    }
+
+    bool end_array() {
+        if (m_skipDepth > 0) {
+            --m_skipDepth;
+            return true;
+        }
+        m_stack.pop_back();
+        return true;
+    }
+
+    bool parse_error(std::size_t, const std::string&, const nlohmann::detail::exception& error) {
+        throw std::runtime_error(error.what());
+    }
+
+    const std::string& locale() const { return m_locale; }
+
+private:
+    enum class Frame { Root, Reflect, ReflectPair, Rules, Rule, Outs, Memory, Weights };
+
+    static constexpr int64_t kMaxWeight = 65535;
+
+    static constexpr unsigned kHasId = 1;
+    static constexpr unsigned kHasCategory = 2;
+    static constexpr unsigned kHasPattern = 4;
+
+    Frame top() const { return m_stack.back(); }
+
+    // Template weights and rule ranks are the only numbers read; both must
+    // be whole. Fractions arrive as nullopt.
+    bool number(std::optional<int64_t> value) {
+        if (m_skipDepth > 0 || m_stack.empty()) return true;
+        Frame frame = top();
+        if (frame == Frame::Weights) {
+            if (!value || *value < 0 || *value > kMaxWeight) {
+                throw std::runtime_error("rule pack: template weights must be whole numbers from 0 to " +
+                                         std::to_string(kMaxWeight));
+            }
+            m_weights.push_back(static_cast<uint32_t>(*value));
+            return true;
+        }
+        if (frame == Frame::Rule && m_key == "rank") {
+            if (!value || *value < INT32_MIN || *value > INT32_MAX) {
+                throw std::runtime_error("rule pack: \"rank\" must be a 32-bit whole number");
+            }
+            m_pack.rules.back().rank = static_cast<int32_t>(*value);
+            return true;
+        }
+        return scalar();
+    }
+
+    // Other numbers, booleans and nulls carry nothing we read, but they must
+    // not stand in for a string the pack requires.
+    bool scalar() {
+        if (m_skipDepth == 0 && !m_stack.empty()) {
+            Frame frame = top();
+            if (frame == Frame::Weights) {
+                throw std::runtime_error("rule pack: template weights must be whole numbers from 0 to " +
+                                         std::to_string(kMaxWeight));
+            }
+            if ((frame == Frame::Root && m_key == "locale") || frame == Frame::ReflectPair || frame == Frame::Outs ||
+                frame == Frame::Memory ||
+                (frame == Frame::Rule && (m_key == "id" || m_key == "category" || m_key == "pattern"))) {
+                throw std::runtime_error("rule pack: expected a string for \"" + m_key + "\"");
+            }
+        }
+        return true;
+    }
+
+    void finishRule(Rule& rule) {
+        if (m_ruleFields != (kHasId | kHasCategory | kHasPattern)) {
+            throw std::runtime_error("rule pack: rule " + std::to_string(m_pack.rules.size() - 1) +
+                                     " needs \"id\", \"category\" and \"pattern\"");
+        }
+        std::string error;
+        std::string folded = foldPattern(stripGroupNames(m_pack.str(rule.patternString), m_groupNames), &error);
+        if (!error.empty() || !rule.pattern.compile(folded, &error)) {
+            throw std::runtime_error("rule pack: rule " + std::string(m_pack.str(rule.id)) + " has an unsupported pattern: " + error);
+        }
+        for (uint32_t i = rule.firstTemplate; i < rule.firstTemplate + rule.templateCount; ++i) {
+            RuleTemplate& out = m_pack.templates[i];
+            compileTemplate(m_pack.str(out.text), out, m_pack.templateParts, m_groupNames);
+        }
+
+        if (rule.selection & kSelectWeighted) {
+            if (m_weights.size() != rule.templateCount) {
+                throw std::runtime_error("rule pack: rule " + std::string(m_pack.str(rule.id)) + " has " +
+                                         std::to_string(m_weights.size()) + " weights for " +
+                                         std::to_string(rule.templateCount) + " outs");
+            }
+            for (uint32_t i = 0; i < rule.templateCount; ++i) {
+                m_pack.templates[rule.firstTemplate + i].weight = m_weights[i];
+            }
+            if (m_pack.totalWeight(rule) == 0 || m_pack.totalWeight(rule) > UINT32_MAX) {
+                throw std::runtime_error("rule pack: rule " + std::string(m_pack.str(rule.id)) +
+                                         " needs a non-zero total weight that fits in 32 bits");
+            }
+        }
+        m_weights.clear();
+
+        // Memory outs go after the outs so each block stays contiguous.
+        rule.firstMemory = static_cast<uint32_t>(m_pack.templates.size());
+        rule.memoryCount = static_cast<uint32_t>(m_memoryTexts.size());
+        for (auto& text : m_memoryTexts) {
+            RuleTemplate& memory = m_pack.templates.emplace_back();
+            memory.text = m_strings.intern(std::move(text));
+            compileTemplate(m_pack.str(memory.text), memory, m_pack.templateParts, m_groupNames);
+            for (const auto& part : m_pack.parts(memory)) {
+                if (part.slot == 0 || part.slot == rule.memorySlot) continue;
+                if (rule.memorySlot != 0) {
+                    throw std::runtime_error("rule pack: memory outs of rule " + std::string(m_pack.str(rule.id)) +
+                                             " may refer to one capture group only");
+                }
+                rule.memorySlot = part.slot;
+            }
+        }
+        m_memoryTexts.clear();
+    }
+
+    uint32_t categoryId(std::string&& name) {
+        auto [it, inserted] = m_categoryIds.try_emplace(std::move(name), static_cast<uint32_t>(m_pack.categories.size()));
+        if (inserted) {
+            m_pack.categories.push_back(m_strings.intern(std::string(it->first)));
+        }
+        return it->second;
+    }
+
+    RulePack& m_pack;
+    StringInterner m_strings;
+    std::unordered_map<std::string, uint32_t> m_categoryIds;
+    size_t m_sizeHint;
+    std::vector<Frame> m_stack;
+    std::string m_key;
+    std::string m_locale;
+    std::vector<std::string> m_groupNames;
+    std::vector<uint32_t> m_weights; // of the rule being read
+    std::vector<std::string> m_memoryTexts;
+    size_t m_skipDepth = 0;
+    size_t m_pairIndex = 0;
+    unsigned m_ruleFields = 0;
+};
+
+std::string finishPack(const RulePackSax& sax, RulePack& pack) {
+    const std::string& locale = sax.locale();
+    if (locale.empty()) {
+        throw std::runtime_error("rule pack: missing \"locale\"");
+    }
+    if (locale == "en-US") {
+        pack.locale = Locale::EN_US;
+    } else if (locale == "pt-BR") {
+        pack.locale = Locale::PT_BR;
+    }
+
+    pack.strings.shrink_to_fit();
+    pack.rules.shrink_to_fit();
+    pack.templates.shrink_to_fit();
+    pack.templateParts.shrink_to_fit();
+
+    std::vector<std::pair<std::string_view, std::string_view>> reflectPairs;
+    reflectPairs.reserve(pack.reflectPairs.size());
+    for (const auto& [from, to] : pack.reflectPairs) {
+        reflectPairs.emplace_back(pack.str(from), pack.str(to));
+    }
+    pack.reflection.build(reflectPairs);
+    pack.matcher.build(pack);
+
+    for (uint32_t i = 0; i < pack.rules.size(); ++i) {
+        if (pack.category(pack.rules[i]) == "General") {
+            pack.neutralRule = i;
+            break;
+        }
+    }
+    return locale;
+}
+
+}
+
+std::string parseRulePack(std::string_view jsonContent, RulePack& pack) {
+    RulePackSax sax(pack, jsonContent.size());
+    json::sax_parse(jsonContent.begin(), jsonContent.end(), &sax);
+    return finishPack(sax, pack);
+}
+
+std::string parseRulePack(std::istream& input, RulePack& pack, size_t sizeHint) {
+    RulePackSax sax(pack, sizeHint);
+    json::sax_parse(input, &sax);
+    return finishPack(sax, pack);
+}
+
+}
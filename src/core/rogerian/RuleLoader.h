@@ -0,0 +1,23 @@
+#ifndef DEEPTHONK3D_RULELOADER_H
+#define DEEPTHONK3D_RULELOADER_H
+
+#include "Rules.h"
+#include <istream>
+#include <string>
+#include <string_view>
+
+namespace deep_thonk {
+
+    // Streaming rule-pack parser built on nlohmann's SAX interface. Rules are
+    // constructed in place inside `pack` while the JSON is read, so no DOM
+    // and no intermediate copies of rules or strings are ever held. Unknown
+    // keys are skipped. Returns the pack's locale; throws on malformed input.
+    //
+    // `sizeHint` is the input size in bytes when known; it is used to reserve
+    // the rule vector up front.
+    std::string parseRulePack(std::string_view jsonContent, RulePack& pack);
+    std::string parseRulePack(std::istream& input, RulePack& pack, size_t sizeHint = 0);
+
+}
+
+#endif //DEEPTHONK3D_RULELOADER_H
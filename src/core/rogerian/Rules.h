@@ -2,9 +2,14 @@
 #define DEEPTHONK3D_RULES_H
 
 #include <string>
+#include <string_view>
+#include <span>
 #include <vector>
-#include <regex>
+#include <atomic>
 #include <cstdint>
+#include "Matcher.h"
+#include "Regex.h"
+#include "Reflection.h"
 
 namespace deep_thonk {
 
@@ -13,23 +18,120 @@ namespace deep_thonk {
         EN_US
     };
 
+    // A string in its pack's pool (RulePack::strings).
+    struct StringRef {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+    };
+
+    // One piece of a compiled template: either the literal span
+    // text[offset, offset + length) of the template's text or, when
+    // slot != 0, capture group `slot`.
+    struct TemplatePart {
+        uint32_t offset = 0;
+        uint32_t length = 0;
+        uint32_t slot = 0;
+    };
+
+    struct ReflectPair {
+        StringRef from;
+        StringRef to;
+    };
+
+    // Text and parts live in the pack's shared blocks; see RulePack::parts().
     struct RuleTemplate {
-        std::string text;
+        StringRef text;
+        uint32_t firstPart = 0;
+        uint32_t partCount = 0;
+        uint32_t literalLength = 0;
+        uint32_t hasCaptures = 0; // widened from a bool so the struct has no padding
+        uint32_t weight = 1;      // relative odds under kSelectWeighted
     };
 
+    // Template selection policy bits (Rule::selection). With neither, every
+    // template is equally likely.
+    constexpr uint32_t kSelectWeighted = 1; // draw by RuleTemplate::weight
+    constexpr uint32_t kSelectNoRepeat = 2; // never the template this session got last time
+
+    // A match counter that can be bumped through a const Rule from any thread.
+    // Copying snapshots the current value.
+    struct HitCounter {
+        HitCounter() = default;
+        HitCounter(const HitCounter& other) noexcept : value(other.load()) {}
+        HitCounter& operator=(const HitCounter& other) noexcept {
+            value.store(other.load(), std::memory_order_relaxed);
+            return *this;
+        }
+
+        void increment() const { value.fetch_add(1, std::memory_order_relaxed); }
+        void add(uint64_t count) const { value.fetch_add(count, std::memory_order_relaxed); }
+        uint64_t load() const { return value.load(std::memory_order_relaxed); }
+
+        mutable std::atomic<uint64_t> value{0};
+    };
+
+    // Strings are read through the owning pack: pack.str(rule.id).
     struct Rule {
-        std::string id;
-        std::string category;
-        std::string patternString;
-        std::regex pattern;
-        std::vector<RuleTemplate> outs;
-        uint64_t hits = 0;
+        StringRef id;
+        StringRef patternString;
+        uint32_t category = 0;      // index into RulePack::categories
+        uint32_t firstTemplate = 0; // RulePack::templates[firstTemplate, firstTemplate + templateCount)
+        uint32_t templateCount = 0;
+        uint32_t selection = 0;     // kSelect* bits
+        int32_t rank = 0;           // keyword rank: higher ranks win before longer patterns
+        // Memory outs (RulePack::memories) are kept with the conversation when
+        // the rule answers and used later, when nothing matches. They may
+        // refer to one capture group, `memorySlot` (0 for none).
+        uint32_t firstMemory = 0;
+        uint32_t memoryCount = 0;
+        uint32_t memorySlot = 0;
+        Regex pattern;
+        HitCounter hits;
     };
 
+    constexpr uint32_t kNoRule = UINT32_MAX;
+
+    // A compiled rule pack. Every id, category, pattern, template and
+    // reflection string is interned once into `strings`, and all templates
+    // and their parts sit in one block each, so a pack is a handful of
+    // allocations however many rules it has (plus each pattern's program).
+    // Categories are numbered in order of first appearance and compared as
+    // integers.
     struct RulePack {
-        Locale locale;
+        Locale locale = Locale::EN_US;
+        // Tells compiled packs apart, e.g. across reloads; see Instrumentation.h.
+        uint64_t serial = 0;
+        std::string strings;
+        std::vector<StringRef> categories;
         std::vector<Rule> rules;
-        std::vector<std::pair<std::string, std::string>> reflectPairs;
+        std::vector<RuleTemplate> templates;
+        std::vector<TemplatePart> templateParts;
+        std::vector<ReflectPair> reflectPairs;
+        ReflectionTable reflection;
+        Matcher matcher;
+        // First rule of the "General" category, answered when nothing matches.
+        uint32_t neutralRule = kNoRule;
+
+        std::string_view str(StringRef ref) const {
+            return std::string_view(strings).substr(ref.offset, ref.length);
+        }
+        std::string_view category(const Rule& rule) const { return str(categories[rule.category]); }
+        std::span<const RuleTemplate> outs(const Rule& rule) const {
+            return std::span<const RuleTemplate>(templates).subspan(rule.firstTemplate, rule.templateCount);
+        }
+        std::span<const RuleTemplate> memories(const Rule& rule) const {
+            return std::span<const RuleTemplate>(templates).subspan(rule.firstMemory, rule.memoryCount);
+        }
+        // Sum of the weights of the rule's templates. A weighted rule needs
+        // it to be non-zero and to fit in 32 bits.
+        uint64_t totalWeight(const Rule& rule) const {
+            uint64_t total = 0;
+            for (const auto& tmpl : outs(rule)) total += tmpl.weight;
+            return total;
+        }
+        std::span<const TemplatePart> parts(const RuleTemplate& tmpl) const {
+            return std::span<const TemplatePart>(templateParts).subspan(tmpl.firstPart, tmpl.partCount);
+        }
     };
 
 }
@@ -0,0 +1,56 @@
+#ifndef DEEPTHONK3D_SESSION_H
+#define DEEPTHONK3D_SESSION_H
+
+#include "ConversationMemory.h"
+#include "PackSlot.h"
+#include "Rules.h"
+#include "../utils/Random.h"
+#include <cstdint>
+#include <memory>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace deep_thonk {
+
+    // Template choices made by Engine::respond, in order. While recording,
+    // every choice is appended to `choices`; while replaying, choices are
+    // read back from it instead of being drawn, so a transcript reproduces
+    // exactly even if the seed or a rule's selection policy has changed.
+    // A recorded choice that no longer fits its rule, or running out of
+    // choices, falls back to drawing.
+    struct ChoiceLog {
+        enum class Mode : uint8_t { Off, Record, Replay };
+
+        Mode mode = Mode::Off;
+        std::vector<uint32_t> choices;
+        size_t cursor = 0; // next choice to replay
+    };
+
+    // Everything that belongs to one conversation. The compiled RulePacks are
+    // immutable and shared, so any number of sessions can call
+    // Engine::respond concurrently as long as each session is only used by
+    // one thread at a time.
+    //
+    // `pack` is a snapshot of `slot`; Engine::respond refreshes it whenever
+    // the slot's generation moves on, so a session picks up a reloaded pack
+    // on its next reply.
+    //
+    // `rng` starts from a random seed; call rng.seed() (or create the session
+    // with Engine::createSession(locale, seed)) for a reproducible run.
+    struct Session {
+        std::string locale;
+        std::shared_ptr<const PackSlot> slot;
+        std::shared_ptr<const RulePack> pack;
+        uint64_t generation = 0;
+        Pcg32 rng{(uint64_t(std::random_device{}()) << 32) ^ std::random_device{}()};
+        ChoiceLog log;
+        // (rule index, template) last answered by each no-repeat rule of `pack`.
+        std::vector<std::pair<uint32_t, uint32_t>> lastTemplates;
+        ConversationMemory memory;
+    };
+
+}
+
+#endif //DEEPTHONK3D_SESSION_H
@@ -0,0 +1,111 @@
+#include "Template.h"
+#include "Rules.h"
+#include <algorithm>
+#include <string_view>
+
+namespace deep_thonk {
+
+namespace {
+
+bool isNameByte(char c, bool first) {
+    return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_' || (!first && c >= '0' && c <= '9');
+}
+
+}
+
+std::string stripGroupNames(std::string_view pattern, std::vector<std::string>& groupNames) {
+    std::string out;
+    out.reserve(pattern.size());
+    groupNames.assign(1, std::string());
+
+    size_t pos = 0;
+    while (pos < pattern.size()) {
+        char c = pattern[pos];
+        if (c == '\\') {
+            out.append(pattern.substr(pos, 2));
+            pos += 2;
+            continue;
+        }
+        if (c == '[') {
+            size_t end = pos + 1;
+            if (end < pattern.size() && pattern[end] == '^') ++end;
+            if (end < pattern.size() && pattern[end] == ']') ++end;
+            while (end < pattern.size() && pattern[end] != ']') {
+                if (pattern[end] == '\\') ++end;
+                ++end;
+            }
+            end = std::min(end + 1, pattern.size());
+            out.append(pattern.substr(pos, end - pos));
+            pos = end;
+            continue;
+        }
+        if (c == '(' && pattern.compare(pos, 3, "(?<") == 0 && pos + 3 < pattern.size() &&
+            pattern[pos + 3] != '=' && pattern[pos + 3] != '!') {
+            size_t close = pattern.find('>', pos + 3);
+            if (close != std::string_view::npos) {
+                groupNames.emplace_back(pattern.substr(pos + 3, close - pos - 3));
+                out += '(';
+                pos = close + 1;
+                continue;
+            }
+        }
+        if (c == '(' && (pos + 1 >= pattern.size() || pattern[pos + 1] != '?')) {
+            groupNames.emplace_back();
+        }
+        out += c;
+        ++pos;
+    }
+    return out;
+}
+
+void compileTemplate(std::string_view text, RuleTemplate& tmpl, std::vector<TemplatePart>& parts,
+                     const std::vector<std::string>& groupNames) {
+    tmpl.firstPart = static_cast<uint32_t>(parts.size());
+    tmpl.literalLength = 0;
+    tmpl.hasCaptures = 0;
+
+    auto addLiteral = [&](size_t begin, size_t end) {
+        if (end <= begin) return;
+        if (parts.size() > tmpl.firstPart && parts.back().slot == 0 &&
+            parts.back().offset + parts.back().length == begin) {
+            parts.back().length += static_cast<uint32_t>(end - begin);
+        } else {
+            parts.push_back({static_cast<uint32_t>(begin), static_cast<uint32_t>(end - begin), 0});
+        }
+        tmpl.literalLength += static_cast<uint32_t>(end - begin);
+    };
+
+    size_t literalStart = 0;
+    size_t pos = 0;
+    while ((pos = text.find('{', pos)) != std::string_view::npos) {
+        size_t close = text.find('}', pos + 1);
+        if (close == std::string_view::npos) break;
+
+        std::string_view name = text.substr(pos + 1, close - pos - 1);
+        uint32_t slot = 0;
+        if (name.size() == 1 && name[0] >= '1' && name[0] <= '9') {
+            slot = static_cast<uint32_t>(name[0] - '0');
+        } else if (!name.empty() && isNameByte(name[0], true)) {
+            for (size_t group = 1; group < groupNames.size(); ++group) {
+                if (groupNames[group] == name) {
+                    slot = static_cast<uint32_t>(group);
+                    break;
+                }
+            }
+        }
+
+        if (slot == 0) {
+            ++pos;
+            continue;
+        }
+        addLiteral(literalStart, pos);
+        parts.push_back({0, 0, slot});
+        tmpl.hasCaptures = 1;
+        pos = close + 1;
+        literalStart = pos;
+    }
+    addLiteral(literalStart, text.size());
+    tmpl.partCount = static_cast<uint32_t>(parts.size()) - tmpl.firstPart;
+}
+
+}
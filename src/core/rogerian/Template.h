@@ -0,0 +1,28 @@
+#ifndef DEEPTHONK3D_TEMPLATE_H
+#define DEEPTHONK3D_TEMPLATE_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace deep_thonk {
+
+    struct RuleTemplate;
+    struct TemplatePart;
+
+    // Rule patterns may write `(?<name>...)` and have it rewritten to a plain
+    // capturing group here; Regex only numbers groups.
+    // `groupNames[n]` receives the name of group n (index 0 is the whole
+    // match); unnamed groups get an empty string.
+    std::string stripGroupNames(std::string_view pattern, std::vector<std::string>& groupNames);
+
+    // Splits the template `text` into literal spans and capture slots,
+    // appending them to `parts` and recording their range in `tmpl`.
+    // `{1}`..`{9}` refer to groups by number, `{name}` to a named group of
+    // the rule. Braces that are neither stay literal text.
+    void compileTemplate(std::string_view text, RuleTemplate& tmpl, std::vector<TemplatePart>& parts,
+                         const std::vector<std::string>& groupNames);
+
+}
+
+#endif //DEEPTHONK3D_TEMPLATE_H
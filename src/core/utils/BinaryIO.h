@@ -0,0 +1,136 @@
+#ifndef DEEPTHONK3D_BINARYIO_H
+#define DEEPTHONK3D_BINARYIO_H
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <vector>
+
+namespace deep_thonk {
+
+    // FNV-1a, 64 bit. Used for checksums and source fingerprints, not security.
+    inline uint64_t fnv1a64(const void* data, size_t size, uint64_t hash = 14695981039346656037ull) {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    // Appends native-endian (little-endian on every supported target) values
+    // to a byte buffer. Arrays and strings are length-prefixed and padded to
+    // 4 bytes so a reader can view them in place.
+    class BinaryWriter {
+    public:
+        void u8(uint8_t value) { m_buffer.push_back(static_cast<char>(value)); }
+        void u32(uint32_t value) { raw(&value, sizeof(value)); }
+        void u64(uint64_t value) { raw(&value, sizeof(value)); }
+
+        void string(std::string_view value) {
+            u32(static_cast<uint32_t>(value.size()));
+            raw(value.data(), value.size());
+            align();
+        }
+
+        template <typename T>
+        void array(const T* data, size_t count) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            u32(static_cast<uint32_t>(count));
+            raw(data, count * sizeof(T));
+            align();
+        }
+
+        template <typename T>
+        void array(const std::vector<T>& values) { array(values.data(), values.size()); }
+
+        void raw(const void* data, size_t size) { m_buffer.append(static_cast<const char*>(data), size); }
+
+        void align() {
+            while (m_buffer.size() % 4 != 0) m_buffer.push_back('\0');
+        }
+
+        std::string& buffer() { return m_buffer; }
+
+    private:
+        std::string m_buffer;
+    };
+
+    // Bounds-checked counterpart of BinaryWriter. Every read fails (and keeps
+    // failing) once the input is exhausted or malformed.
+    class BinaryReader {
+    public:
+        BinaryReader(const char* data, size_t size) : m_data(data), m_size(size) {}
+
+        bool u8(uint8_t& value) { return raw(&value, sizeof(value)); }
+        bool u32(uint32_t& value) { return raw(&value, sizeof(value)); }
+        bool u64(uint64_t& value) { return raw(&value, sizeof(value)); }
+
+        bool string(std::string_view& value) {
+            uint32_t size = 0;
+            if (!u32(size) || !view(size, value)) return false;
+            return align();
+        }
+
+        template <typename T>
+        bool array(std::vector<T>& values) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            uint32_t count = 0;
+            std::string_view bytes;
+            if (!u32(count) || !view(static_cast<size_t>(count) * sizeof(T), bytes)) return false;
+            values.resize(count);
+            if (count) std::memcpy(values.data(), bytes.data(), bytes.size());
+            return align();
+        }
+
+        template <typename T>
+        bool array(T* data, size_t expectedCount) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            uint32_t count = 0;
+            std::string_view bytes;
+            if (!u32(count) || count != expectedCount || !view(count * sizeof(T), bytes)) return fail();
+            std::memcpy(data, bytes.data(), bytes.size());
+            return align();
+        }
+
+        bool raw(void* out, size_t size) {
+            std::string_view bytes;
+            if (!view(size, bytes)) return false;
+            std::memcpy(out, bytes.data(), size);
+            return true;
+        }
+
+        bool view(size_t size, std::string_view& out) {
+            if (!m_ok || size > m_size - m_pos) return fail();
+            out = std::string_view(m_data + m_pos, size);
+            m_pos += size;
+            return true;
+        }
+
+        bool align() {
+            size_t padded = (m_pos + 3) & ~size_t(3);
+            if (padded > m_size) return fail();
+            m_pos = padded;
+            return m_ok;
+        }
+
+        bool ok() const { return m_ok; }
+        bool atEnd() const { return m_pos == m_size; }
+
+    private:
+        bool fail() {
+            m_ok = false;
+            return false;
+        }
+
+        const char* m_data;
+        size_t m_size;
+        size_t m_pos = 0;
+        bool m_ok = true;
+    };
+
+}
+
+#endif //DEEPTHONK3D_BINARYIO_H
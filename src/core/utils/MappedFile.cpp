@@ -0,0 +1,68 @@
+#include "MappedFile.h"
+#include <fstream>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define DEEPTHONK_HAS_MMAP 1
+#endif
+
+namespace deep_thonk {
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+bool MappedFile::open(const std::string& path) {
+    close();
+
+#ifdef DEEPTHONK_HAS_MMAP
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info {};
+    if (::fstat(fd, &info) != 0 || info.st_size <= 0) {
+        ::close(fd);
+        return false;
+    }
+
+    void* address = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if (address != MAP_FAILED) {
+        m_data = static_cast<const char*>(address);
+        m_size = static_cast<size_t>(info.st_size);
+        m_mapped = true;
+        return true;
+    }
+#endif
+
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    if (!file) return false;
+    std::streamsize size = file.tellg();
+    if (size <= 0) return false;
+    m_fallback.resize(static_cast<size_t>(size));
+    file.seekg(0);
+    if (!file.read(m_fallback.data(), size)) {
+        m_fallback.clear();
+        return false;
+    }
+    m_data = m_fallback.data();
+    m_size = m_fallback.size();
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef DEEPTHONK_HAS_MMAP
+    if (m_mapped) {
+        ::munmap(const_cast<char*>(m_data), m_size);
+    }
+#endif
+    m_mapped = false;
+    m_data = nullptr;
+    m_size = 0;
+    m_fallback.clear();
+}
+
+}
@@ -0,0 +1,36 @@
+#ifndef DEEPTHONK3D_MAPPEDFILE_H
+#define DEEPTHONK3D_MAPPEDFILE_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+namespace deep_thonk {
+
+    // Read-only view of a whole file. Uses mmap where available; elsewhere
+    // (e.g. a WASM build without a real file system) it reads the file into
+    // memory instead, behind the same interface.
+    class MappedFile {
+    public:
+        MappedFile() = default;
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        bool open(const std::string& path);
+        void close();
+
+        const char* data() const { return m_data; }
+        size_t size() const { return m_size; }
+
+    private:
+        const char* m_data = nullptr;
+        size_t m_size = 0;
+        bool m_mapped = false;
+        std::vector<char> m_fallback;
+    };
+
+}
+
+#endif //DEEPTHONK3D_MAPPEDFILE_H
@@ -0,0 +1,67 @@
+#ifndef DEEPTHONK3D_RANDOM_H
+#define DEEPTHONK3D_RANDOM_H
+
+#include <cstdint>
+#include <limits>
+
+namespace deep_thonk {
+
+    // PCG32 (XSH-RR, 64-bit state): 16 bytes of state, a multiply and a
+    // rotate per draw. Unlike std::mt19937 plus a std:: distribution, the
+    // sequence produced by seed() and below() is specified here and not by
+    // the standard library, so seeded runs give the same output on every
+    // platform and compiler.
+    //
+    // Satisfies UniformRandomBitGenerator, so it also works with std::shuffle.
+    class Pcg32 {
+    public:
+        using result_type = uint32_t;
+
+        Pcg32() { seed(0); }
+        explicit Pcg32(uint64_t seedValue, uint64_t stream = 0) { seed(seedValue, stream); }
+
+        // Different streams with the same seed give independent sequences.
+        void seed(uint64_t seedValue, uint64_t stream = 0) {
+            m_state = 0;
+            m_increment = (stream << 1) | 1;
+            (*this)();
+            m_state += seedValue;
+            (*this)();
+        }
+
+        static constexpr result_type min() { return 0; }
+        static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+        result_type operator()() {
+            uint64_t old = m_state;
+            m_state = old * 6364136223846793005ull + m_increment;
+            auto xorShifted = static_cast<uint32_t>(((old >> 18) ^ old) >> 27);
+            auto rotation = static_cast<uint32_t>(old >> 59);
+            return (xorShifted >> rotation) | (xorShifted << ((-rotation) & 31));
+        }
+
+        // Uniform in [0, bound) without modulo bias (Lemire's method).
+        // `bound` must be non-zero.
+        uint32_t below(uint32_t bound) {
+            uint64_t product = uint64_t((*this)()) * bound;
+            auto low = static_cast<uint32_t>(product);
+            if (low < bound) {
+                uint32_t threshold = -bound % bound;
+                while (low < threshold) {
+                    product = uint64_t((*this)()) * bound;
+                    low = static_cast<uint32_t>(product);
+                }
+            }
+            return static_cast<uint32_t>(product >> 32);
+        }
+
+        bool operator==(const Pcg32&) const = default;
+
+    private:
+        uint64_t m_state = 0;
+        uint64_t m_increment = 1;
+    };
+
+}
+
+#endif //DEEPTHONK3D_RANDOM_H
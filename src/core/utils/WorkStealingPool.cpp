@@ -0,0 +1,137 @@
+#include "WorkStealingPool.h"
+#include <algorithm>
+
+namespace deep_thonk {
+
+WorkStealingPool::WorkStealingPool(unsigned threadCount) {
+    if (threadCount == 0) {
+        threadCount = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    for (unsigned i = 0; i < threadCount; ++i) {
+        m_slices.push_back(std::make_unique<Slice>());
+    }
+    // The calling thread takes the last slice, so only threadCount - 1 workers are spawned.
+    for (unsigned i = 0; i + 1 < threadCount; ++i) {
+        m_threads.emplace_back(&WorkStealingPool::workerLoop, this, i);
+    }
+}
+
+WorkStealingPool::~WorkStealingPool() {
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_stopping = true;
+    }
+    m_wake.notify_all();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+}
+
+unsigned WorkStealingPool::concurrency() const {
+    return static_cast<unsigned>(m_slices.size());
+}
+
+void WorkStealingPool::parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body) {
+    if (count == 0) return;
+
+    std::lock_guard<std::mutex> job(m_jobLock);
+    size_t participants = m_slices.size();
+    for (size_t i = 0; i < participants; ++i) {
+        std::lock_guard<std::mutex> guard(m_slices[i]->lock);
+        m_slices[i]->begin = count * i / participants;
+        m_slices[i]->end = count * (i + 1) / participants;
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(m_mutex);
+        m_body = &body;
+        m_grain = std::max<size_t>(1, grain);
+        m_error = nullptr;
+        m_busy = static_cast<unsigned>(m_threads.size());
+        ++m_generation;
+    }
+    m_wake.notify_all();
+
+    drain(participants - 1);
+
+    std::exception_ptr error;
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+        m_done.wait(lock, [this]() { return m_busy == 0; });
+        m_body = nullptr;
+        error = m_error;
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+void WorkStealingPool::workerLoop(size_t self) {
+    uint64_t seen = 0;
+    for (;;) {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_wake.wait(lock, [&]() { return m_stopping || m_generation != seen; });
+            if (m_stopping) return;
+            seen = m_generation;
+        }
+
+        drain(self);
+
+        std::lock_guard<std::mutex> guard(m_mutex);
+        if (--m_busy == 0) m_done.notify_all();
+    }
+}
+
+void WorkStealingPool::drain(size_t self) {
+    size_t begin = 0;
+    size_t end = 0;
+    while (takeOwn(self, begin, end) || steal(self, begin, end)) {
+        try {
+            (*m_body)(begin, end);
+        } catch (...) {
+            std::lock_guard<std::mutex> guard(m_mutex);
+            if (!m_error) m_error = std::current_exception();
+        }
+    }
+}
+
+bool WorkStealingPool::takeOwn(size_t self, size_t& begin, size_t& end) {
+    Slice& slice = *m_slices[self];
+    std::lock_guard<std::mutex> guard(slice.lock);
+    if (slice.begin >= slice.end) return false;
+
+    begin = slice.begin;
+    end = std::min(slice.end, begin + m_grain);
+    slice.begin = end;
+    return true;
+}
+
+bool WorkStealingPool::steal(size_t self, size_t& begin, size_t& end) {
+    size_t participants = m_slices.size();
+    for (size_t offset = 1; offset < participants; ++offset) {
+        Slice& victim = *m_slices[(self + offset) % participants];
+        size_t stolenBegin = 0;
+        size_t stolenEnd = 0;
+        {
+            std::lock_guard<std::mutex> guard(victim.lock);
+            size_t remaining = victim.end > victim.begin ? victim.end - victim.begin : 0;
+            if (remaining == 0) continue;
+
+            stolenEnd = victim.end;
+            stolenBegin = remaining > m_grain ? victim.end - remaining / 2 : victim.begin;
+            victim.end = stolenBegin;
+        }
+
+        // Run the first chunk now and park the rest where others can steal it back.
+        begin = stolenBegin;
+        end = std::min(stolenEnd, stolenBegin + m_grain);
+        Slice& own = *m_slices[self];
+        std::lock_guard<std::mutex> guard(own.lock);
+        own.begin = end;
+        own.end = stolenEnd;
+        return true;
+    }
+    return false;
+}
+
+}
@@ -0,0 +1,71 @@
+#ifndef DEEPTHONK3D_WORKSTEALINGPOOL_H
+#define DEEPTHONK3D_WORKSTEALINGPOOL_H
+
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace deep_thonk {
+
+    // Fixed set of worker threads for data-parallel loops.
+    //
+    // parallelFor() hands every participant (the workers plus the calling
+    // thread) one contiguous slice of the index range. Each participant eats
+    // its slice from the front in `grain`-sized chunks; once it runs dry it
+    // steals the back half of some other participant's remaining slice. Cheap
+    // items therefore keep their locality, and a slice full of slow items gets
+    // split up among idle threads.
+    class WorkStealingPool {
+    public:
+        // 0 means one participant per hardware thread.
+        explicit WorkStealingPool(unsigned threadCount = 0);
+        ~WorkStealingPool();
+
+        WorkStealingPool(const WorkStealingPool&) = delete;
+        WorkStealingPool& operator=(const WorkStealingPool&) = delete;
+
+        // Calls body(begin, end) over disjoint chunks covering [0, count) and
+        // returns once all of them have run. The first exception thrown by
+        // `body` is rethrown here. Concurrent calls are serialised.
+        void parallelFor(size_t count, size_t grain, const std::function<void(size_t, size_t)>& body);
+
+        // Number of threads that take part in a parallelFor, caller included.
+        unsigned concurrency() const;
+
+    private:
+        struct alignas(64) Slice {
+            std::mutex lock;
+            size_t begin = 0;
+            size_t end = 0;
+        };
+
+        void workerLoop(size_t self);
+        void drain(size_t self);
+        bool takeOwn(size_t self, size_t& begin, size_t& end);
+        bool steal(size_t self, size_t& begin, size_t& end);
+
+        std::vector<std::thread> m_threads;
+        std::vector<std::unique_ptr<Slice>> m_slices; // one per worker, caller last
+
+        std::mutex m_jobLock; // one parallelFor at a time
+        std::mutex m_mutex;
+        std::condition_variable m_wake;
+        std::condition_variable m_done;
+        uint64_t m_generation = 0;
+        unsigned m_busy = 0;
+        bool m_stopping = false;
+
+        const std::function<void(size_t, size_t)>* m_body = nullptr;
+        size_t m_grain = 1;
+        std::exception_ptr m_error;
+    };
+
+}
+
+#endif //DEEPTHONK3D_WORKSTEALINGPOOL_H
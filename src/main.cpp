@@ -1,6 +1,8 @@
 #include <QApplication>
 #include <QQmlApplicationEngine>
+#include <QDir>
 #include <QQmlContext>
+#include <QStandardPaths>
 #include "ui/bridge/Bridge.h"
 
 int main(int argc, char *argv[])
@@ -11,7 +13,10 @@ int main(int argc, char *argv[])
 
     QQmlApplicationEngine engine;
 
-    Bridge *bridge = new Bridge(&engine);
+    // The conversation is journaled, so it survives a restart
+    QString dataDir = QStandardPaths::writableLocation(QStandardPaths::AppDataLocation);
+    QDir().mkpath(dataDir);
+    Bridge *bridge = new Bridge(dataDir + "/session.dtjournal", &engine);
     engine.rootContext()->setContextProperty("bridge", bridge);
 
     const QUrl url(QStringLiteral("qrc:/ui/qml/Main.qml"));
@@ -0,0 +1,48 @@
+// deepThonk3d_rulec: compiles a JSON rule pack into a precompiled .dtpack blob.
+//
+//   deepThonk3d_rulec <rules.json> <out.dtpack>
+
+#include "core/rogerian/Engine.h"
+#include "core/rogerian/PackFile.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3) {
+        std::cerr << "usage: " << argv[0] << " <rules.json> <out.dtpack>" << std::endl;
+        return 2;
+    }
+
+    std::ifstream input(argv[1], std::ios::binary);
+    if (!input) {
+        std::cerr << "cannot read " << argv[1] << std::endl;
+        return 1;
+    }
+    std::stringstream buffer;
+    buffer << input.rdbuf();
+    std::string jsonContent = buffer.str();
+
+    deep_thonk::Engine engine;
+    try {
+        engine.loadRulesFromString(jsonContent);
+    } catch (const std::exception& error) {
+        std::cerr << argv[1] << ": " << error.what() << std::endl;
+        return 1;
+    }
+
+    auto packs = engine.getRulePacks();
+    const auto& [locale, pack] = *packs.begin();
+    std::string blob = deep_thonk::writePackFile(locale, *pack, deep_thonk::hashRuleSource(jsonContent));
+
+    std::ofstream output(argv[2], std::ios::binary | std::ios::trunc);
+    if (!output.write(blob.data(), static_cast<std::streamsize>(blob.size()))) {
+        std::cerr << "cannot write " << argv[2] << std::endl;
+        return 1;
+    }
+
+    std::cout << "Compiled " << pack->rules.size() << " rules for " << locale << " into " << argv[2]
+              << " (" << blob.size() << " bytes)" << std::endl;
+    return 0;
+}
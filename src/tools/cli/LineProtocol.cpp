@@ -0,0 +1,84 @@
+#include "LineProtocol.h"
+#include <cstring>
+
+namespace deep_thonk::cli {
+
+void appendEscaped(std::string& out, std::string_view field) {
+    size_t start = 0;
+    for (size_t i = 0; i < field.size(); ++i) {
+        char c = field[i];
+        if (c != '\\' && c != '\t' && c != '\n') continue;
+        out.append(field.data() + start, i - start);
+        out += '\\';
+        out += c == '\t' ? 't' : c == '\n' ? 'n' : '\\';
+        start = i + 1;
+    }
+    out.append(field.data() + start, field.size() - start);
+}
+
+std::string unescape(std::string_view field) {
+    std::string out;
+    out.reserve(field.size());
+    for (size_t i = 0; i < field.size(); ++i) {
+        if (field[i] != '\\' || i + 1 == field.size()) {
+            out += field[i];
+            continue;
+        }
+        char c = field[++i];
+        out += c == 't' ? '\t' : c == 'n' ? '\n' : c;
+    }
+    return out;
+}
+
+void splitField(std::string_view line, std::string_view& head, std::string_view& tail) {
+    size_t tab = line.find('\t');
+    if (tab == std::string_view::npos) {
+        head = {};
+        tail = line;
+    } else {
+        head = line.substr(0, tab);
+        tail = line.substr(tab + 1);
+    }
+}
+
+char* LineBuffer::reserve(size_t bytes) {
+    if (m_begin == m_end) {
+        m_begin = m_end = m_scanned = 0;
+    } else if (m_begin > 0 && m_data.size() - m_end < bytes) {
+        // Slide the partial line to the front before growing.
+        std::memmove(m_data.data(), m_data.data() + m_begin, m_end - m_begin);
+        m_end -= m_begin;
+        m_begin = 0;
+    }
+    if (m_data.size() - m_end < bytes) m_data.resize(m_end + bytes);
+    return m_data.data() + m_end;
+}
+
+bool LineBuffer::next(std::string_view& line) {
+    if (m_overlong) return false;
+    const char* start = m_data.data() + m_begin;
+    const void* lf = std::memchr(start + m_scanned, '\n', m_end - m_begin - m_scanned);
+    if (!lf) {
+        m_scanned = m_end - m_begin;
+        if (m_scanned > m_maxLine) dropAll();
+        return false;
+    }
+    size_t length = static_cast<const char*>(lf) - start;
+    if (length > m_maxLine) {
+        dropAll();
+        return false;
+    }
+    line = std::string_view(start, length);
+    if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+    m_begin += length + 1;
+    m_scanned = 0;
+    return true;
+}
+
+void LineBuffer::dropAll() {
+    m_overlong = true;
+    m_begin = m_end = m_scanned = 0;
+    std::string().swap(m_data);
+}
+
+}
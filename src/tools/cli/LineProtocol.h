@@ -0,0 +1,59 @@
+#ifndef DEEPTHONK3D_CLI_LINEPROTOCOL_H
+#define DEEPTHONK3D_CLI_LINEPROTOCOL_H
+
+#include <string>
+#include <string_view>
+
+namespace deep_thonk::cli {
+
+    // Wire format of `deepThonk3d_cli serve`, one line per message:
+    //
+    //   request:  <session> TAB <message> LF
+    //   reply:    <session> TAB <rule id> TAB <reply> LF
+    //
+    // Sessions are named by the client and live as long as its connection;
+    // a request without a TAB goes to the session named "". Replies come
+    // back in request order, so a client may pipeline as many requests as it
+    // likes. Backslash, TAB and LF inside a field are sent as \\, \t and \n.
+    // The server closes a connection that sends a line longer than it
+    // accepts or names more sessions than it keeps (see Server.h).
+    void appendEscaped(std::string& out, std::string_view field);
+    std::string unescape(std::string_view field);
+
+    // Splits `line` at its first TAB into `head` and `tail`; without one,
+    // `head` is empty and `tail` is the whole line.
+    void splitField(std::string_view line, std::string_view& head, std::string_view& tail);
+
+    // Bytes read from a socket, handed out one complete line at a time.
+    // Lines longer than `maxLine` bytes are never handed out: once one is
+    // seen, finished or not, the buffer is overlong() and stays empty.
+    class LineBuffer {
+    public:
+        explicit LineBuffer(size_t maxLine) : m_maxLine(maxLine) {}
+
+        // Room for at least `bytes` more at the returned pointer; commit()
+        // what was written there.
+        char* reserve(size_t bytes);
+        void commit(size_t bytes) { m_end += bytes; }
+
+        // The next complete line without its LF (and CR); false if none is
+        // buffered yet or the buffer is overlong(). The view stays valid
+        // until the next reserve().
+        bool next(std::string_view& line);
+        size_t pending() const { return m_end - m_begin; }
+        bool overlong() const { return m_overlong; }
+
+    private:
+        void dropAll();
+
+        size_t m_maxLine;
+        bool m_overlong = false;
+        std::string m_data;
+        size_t m_begin = 0;
+        size_t m_end = 0;
+        size_t m_scanned = 0; // bytes after m_begin known to hold no LF
+    };
+
+}
+
+#endif //DEEPTHONK3D_CLI_LINEPROTOCOL_H
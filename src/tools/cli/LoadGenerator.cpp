@@ -0,0 +1,278 @@
+#include "LoadGenerator.h"
+#include "LineProtocol.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cerrno>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <deque>
+#include <thread>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace deep_thonk::cli {
+
+namespace {
+
+constexpr size_t kReadChunk = 64 * 1024;
+// A connection with requests in flight and no reply for this long is given up.
+constexpr uint64_t kStallNs = 10'000'000'000ull;
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0;
+#endif
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+struct Client {
+    int fd = -1;
+    LineBuffer in{SIZE_MAX}; // the server's replies are trusted to end
+    std::string out;
+    size_t outSent = 0;
+    // Session and send time of every request still waiting for its reply, oldest first.
+    std::deque<std::pair<uint32_t, uint64_t>> inFlight;
+    size_t nextMessage = 0;
+    uint32_t nextSession = 0;
+    uint64_t lastReplyNs = 0;
+
+    size_t queued() const { return out.size() - outSent; }
+};
+
+struct ThreadResult {
+    uint64_t replies = 0;
+    uint64_t errors = 0;
+    LatencyHistogram latency;
+};
+
+int connectTo(const std::string& path, std::string* error) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        if (error) *error = "socket path must be 1 to " + std::to_string(sizeof(address.sun_path) - 1) + " bytes";
+        return -1;
+    }
+    std::memcpy(address.sun_path, path.c_str(), path.size() + 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK) != 0) {
+        if (error) *error = path + ": " + std::strerror(errno);
+        if (fd >= 0) ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+void appendSessionName(std::string& out, uint32_t session) {
+    out += 's';
+    out += std::to_string(session);
+}
+
+bool flushClient(Client& client) {
+    while (client.queued() > 0) {
+        ssize_t sent = ::send(client.fd, client.out.data() + client.outSent, client.queued(), kSendFlags);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        client.outSent += static_cast<size_t>(sent);
+    }
+    client.out.clear();
+    client.outSent = 0;
+    return true;
+}
+
+void drive(const LoadOptions& options, std::vector<Client*> clients, uint64_t deadlineNs,
+           std::atomic<uint64_t>& issued, ThreadResult& result) {
+    std::vector<pollfd> fds;
+    std::vector<Client*> waiting;
+    std::string expected;
+    bool issuing = true;
+
+    auto drop = [&result](Client& client) {
+        ++result.errors;
+        ::close(client.fd);
+        client.fd = -1;
+        client.inFlight.clear();
+    };
+
+    while (true) {
+        if (issuing && options.requests == 0 && nowNs() >= deadlineNs) issuing = false;
+
+        fds.clear();
+        waiting.clear();
+        for (Client* client : clients) {
+            if (client->fd < 0) continue;
+            while (issuing && client->inFlight.size() < options.pipeline) {
+                if (options.requests && issued.fetch_add(1, std::memory_order_relaxed) >= options.requests) {
+                    issuing = false;
+                    break;
+                }
+                uint32_t session = client->nextSession++ % options.sessions;
+                appendSessionName(client->out, session);
+                client->out += '\t';
+                appendEscaped(client->out, options.messages[client->nextMessage++ % options.messages.size()]);
+                client->out += '\n';
+                uint64_t now = nowNs();
+                if (client->inFlight.empty()) client->lastReplyNs = now;
+                client->inFlight.emplace_back(session, now);
+            }
+            if (!flushClient(*client)) {
+                drop(*client);
+                continue;
+            }
+            if (client->inFlight.empty()) continue;
+            fds.push_back({client->fd, static_cast<short>(POLLIN | (client->queued() > 0 ? POLLOUT : 0)), 0});
+            waiting.push_back(client);
+        }
+        if (fds.empty()) break;
+
+        if (::poll(fds.data(), fds.size(), 100) < 0 && errno != EINTR) break;
+
+        for (size_t i = 0; i < fds.size(); ++i) {
+            Client& client = *waiting[i];
+            uint64_t now = nowNs();
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR)) {
+                ssize_t received = ::read(client.fd, client.in.reserve(kReadChunk), kReadChunk);
+                if (received <= 0 && !(received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR))) {
+                    drop(client);
+                    continue;
+                }
+                if (received > 0) client.in.commit(static_cast<size_t>(received));
+            }
+
+            std::string_view line;
+            while (client.in.next(line)) {
+                std::string_view session;
+                std::string_view rest;
+                splitField(line, session, rest);
+                if (client.inFlight.empty()) {
+                    ++result.errors;
+                    continue;
+                }
+                auto [expectedSession, sentNs] = client.inFlight.front();
+                client.inFlight.pop_front();
+                expected.clear();
+                appendSessionName(expected, expectedSession);
+                if (session != expected) ++result.errors;
+                result.latency.record(now - sentNs);
+                ++result.replies;
+                client.lastReplyNs = now;
+            }
+            if (!client.inFlight.empty() && now - client.lastReplyNs > kStallNs) drop(client);
+        }
+    }
+
+    for (Client* client : clients) {
+        if (client->fd >= 0) ::close(client->fd);
+    }
+}
+
+}
+
+void LatencyHistogram::record(uint64_t ns) {
+    size_t index = ns;
+    if (ns >= (1u << kSubBucketBits)) {
+        int exponent = std::bit_width(ns) - 1;
+        index = (size_t(exponent - kSubBucketBits + 1) << kSubBucketBits) +
+                ((ns >> (exponent - kSubBucketBits)) - (1u << kSubBucketBits));
+    }
+    ++m_buckets[index];
+    ++m_count;
+    m_sum += ns;
+    m_max = std::max(m_max, ns);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other) {
+    for (size_t i = 0; i < m_buckets.size(); ++i) m_buckets[i] += other.m_buckets[i];
+    m_count += other.m_count;
+    m_sum += other.m_sum;
+    m_max = std::max(m_max, other.m_max);
+}
+
+uint64_t LatencyHistogram::percentile(double q) const {
+    if (m_count == 0) return 0;
+    auto target = std::max<uint64_t>(1, static_cast<uint64_t>(std::ceil(q * double(m_count))));
+    uint64_t seen = 0;
+    for (size_t index = 0; index < m_buckets.size(); ++index) {
+        seen += m_buckets[index];
+        if (seen < target) continue;
+        if (index < (1u << kSubBucketBits)) return index;
+        size_t group = index >> kSubBucketBits;
+        uint64_t mantissa = (1u << kSubBucketBits) + (index & ((1u << kSubBucketBits) - 1));
+        return std::min(m_max, mantissa << (group - 1));
+    }
+    return m_max;
+}
+
+nlohmann::json LoadReport::toJson(const LoadOptions& options) const {
+    return {
+        {"connections", options.connections},
+        {"pipeline", options.pipeline},
+        {"sessions", options.sessions},
+        {"replies", replies},
+        {"errors", errors},
+        {"seconds", seconds},
+        {"throughput_rps", throughput()},
+        {"mean_ns", latency.mean()},
+        {"p50_ns", latency.percentile(0.50)},
+        {"p90_ns", latency.percentile(0.90)},
+        {"p99_ns", latency.percentile(0.99)},
+        {"p999_ns", latency.percentile(0.999)},
+        {"max_ns", latency.max()},
+    };
+}
+
+bool runLoad(const LoadOptions& options, LoadReport& report, std::string* error) {
+    if (options.messages.empty() || options.connections == 0 || options.pipeline == 0 || options.sessions == 0) {
+        if (error) *error = "need at least one message, connection, pipelined request and session";
+        return false;
+    }
+
+    std::vector<Client> clients(options.connections);
+    for (size_t i = 0; i < clients.size(); ++i) {
+        clients[i].fd = connectTo(options.socketPath, error);
+        if (clients[i].fd < 0) {
+            for (size_t j = 0; j < i; ++j) ::close(clients[j].fd);
+            return false;
+        }
+        clients[i].nextMessage = i * options.messages.size() / clients.size();
+    }
+
+    unsigned threads = options.threads ? options.threads : std::max(1u, std::thread::hardware_concurrency());
+    threads = std::min<unsigned>(threads, options.connections);
+    std::vector<std::vector<Client*>> shares(threads);
+    for (size_t i = 0; i < clients.size(); ++i) shares[i % threads].push_back(&clients[i]);
+
+    std::vector<ThreadResult> results(threads);
+    std::vector<std::thread> pool;
+    std::atomic<uint64_t> issued{0};
+    uint64_t start = nowNs();
+    uint64_t deadline = start + static_cast<uint64_t>(std::chrono::nanoseconds(options.duration).count());
+    for (unsigned t = 0; t < threads; ++t) {
+        pool.emplace_back(drive, std::cref(options), shares[t], deadline, std::ref(issued), std::ref(results[t]));
+    }
+    for (std::thread& thread : pool) thread.join();
+
+    report = {};
+    report.seconds = double(nowNs() - start) / 1e9;
+    for (const ThreadResult& result : results) {
+        report.replies += result.replies;
+        report.errors += result.errors;
+        report.latency.merge(result.latency);
+    }
+    return true;
+}
+
+}
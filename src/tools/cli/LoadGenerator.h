@@ -0,0 +1,69 @@
+#ifndef DEEPTHONK3D_CLI_LOADGENERATOR_H
+#define DEEPTHONK3D_CLI_LOADGENERATOR_H
+
+#include "third_party/nlohmann/json.hpp"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace deep_thonk::cli {
+
+    struct LoadOptions {
+        std::string socketPath;
+        // Sent round-robin, each connection starting at a different message.
+        std::vector<std::string> messages;
+        unsigned connections = 16;
+        // Requests each connection keeps in flight.
+        unsigned pipeline = 8;
+        // Sessions per connection; requests cycle through them.
+        unsigned sessions = 4;
+        // Client threads; 0 = one per core, never more than connections.
+        unsigned threads = 0;
+        // Stop after this many replies, or else after `duration`.
+        uint64_t requests = 0;
+        std::chrono::milliseconds duration{10000};
+    };
+
+    // Reply latencies in nanoseconds, bucketed log-linearly (64 buckets per
+    // power of two, so within 1.6% of the true value) in fixed memory, so a
+    // long run at full rate records every reply.
+    class LatencyHistogram {
+    public:
+        void record(uint64_t ns);
+        void merge(const LatencyHistogram& other);
+        uint64_t count() const { return m_count; }
+        // Smallest recorded bucket value below which a fraction `q` of the replies fall.
+        uint64_t percentile(double q) const;
+        uint64_t max() const { return m_max; }
+        double mean() const { return m_count ? double(m_sum) / double(m_count) : 0; }
+
+    private:
+        static constexpr int kSubBucketBits = 6;
+
+        std::array<uint64_t, 64 << kSubBucketBits> m_buckets{};
+        uint64_t m_count = 0;
+        uint64_t m_sum = 0;
+        uint64_t m_max = 0;
+    };
+
+    struct LoadReport {
+        uint64_t replies = 0;
+        // Connections that failed and replies that came back for the wrong session.
+        uint64_t errors = 0;
+        double seconds = 0;
+        LatencyHistogram latency;
+
+        double throughput() const { return seconds > 0 ? double(replies) / seconds : 0; }
+        nlohmann::json toJson(const LoadOptions& options) const;
+    };
+
+    // Drives a `deepThonk3d_cli serve` socket with pipelined requests from
+    // several connections and measures the time from writing each request
+    // to reading its reply. Returns false if no connection could be made.
+    bool runLoad(const LoadOptions& options, LoadReport& report, std::string* error = nullptr);
+
+}
+
+#endif //DEEPTHONK3D_CLI_LOADGENERATOR_H
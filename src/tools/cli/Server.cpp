@@ -0,0 +1,313 @@
+#include "Server.h"
+#include "LineProtocol.h"
+#include "core/rogerian/Engine.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <mutex>
+#include <string_view>
+#include <unordered_map>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace deep_thonk::cli {
+
+namespace {
+
+constexpr size_t kReadChunk = 64 * 1024;
+// Replies queued for a client that is not reading; past this its requests wait.
+constexpr size_t kMaxQueuedReplyBytes = 1 << 20;
+
+#ifdef MSG_NOSIGNAL
+constexpr int kSendFlags = MSG_NOSIGNAL;
+#else
+constexpr int kSendFlags = 0; // SIGPIPE is ignored by main() instead
+#endif
+
+struct StringHash {
+    using is_transparent = void;
+    size_t operator()(std::string_view text) const { return std::hash<std::string_view>{}(text); }
+};
+
+struct Connection {
+    Connection(int fd, size_t maxLine) : fd(fd), in(maxLine) {}
+
+    int fd;
+    LineBuffer in;
+    std::string out;
+    size_t outSent = 0;
+    bool readClosed = false;
+    bool refused = false; // broke a ServerOptions limit: send what is queued, then close
+    std::unordered_map<std::string, Session, StringHash, std::equal_to<>> sessions;
+
+    size_t queued() const { return out.size() - outSent; }
+};
+
+bool setNonBlocking(int fd) {
+    int flags = ::fcntl(fd, F_GETFL);
+    return flags >= 0 && ::fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0 && ::fcntl(fd, F_SETFD, FD_CLOEXEC) == 0;
+}
+
+bool makePipe(int fds[2]) {
+    if (::pipe(fds) != 0) return false;
+    return setNonBlocking(fds[0]) && setNonBlocking(fds[1]);
+}
+
+void closePipe(int fds[2]) {
+    for (int i = 0; i < 2; ++i) {
+        if (fds[i] >= 0) ::close(fds[i]);
+        fds[i] = -1;
+    }
+}
+
+void wake(int fd) {
+    char byte = 1;
+    [[maybe_unused]] ssize_t ignored = ::write(fd, &byte, 1);
+}
+
+void drain(int fd) {
+    char bytes[64];
+    while (::read(fd, bytes, sizeof(bytes)) > 0) {
+    }
+}
+
+bool fail(std::string* error, const std::string& what) {
+    if (error) *error = what + ": " + std::strerror(errno);
+    return false;
+}
+
+// Sends what it can of the queued replies; false if the connection is gone.
+bool flush(Connection& connection) {
+    while (connection.queued() > 0) {
+        ssize_t sent = ::send(connection.fd, connection.out.data() + connection.outSent, connection.queued(), kSendFlags);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        connection.outSent += static_cast<size_t>(sent);
+    }
+    connection.out.clear();
+    connection.outSent = 0;
+    return true;
+}
+
+}
+
+struct Server::Worker {
+    std::thread thread;
+    int wakePipe[2] = {-1, -1};
+    std::mutex mutex;
+    std::vector<int> incoming;
+};
+
+Server::Server(const Engine& engine, ServerOptions options) : m_engine(engine), m_options(std::move(options)) {}
+
+Server::~Server() {
+    stop();
+}
+
+bool Server::start(std::string* error) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (m_options.socketPath.empty() || m_options.socketPath.size() >= sizeof(address.sun_path)) {
+        if (error) *error = "socket path must be 1 to " + std::to_string(sizeof(address.sun_path) - 1) + " bytes";
+        return false;
+    }
+    std::memcpy(address.sun_path, m_options.socketPath.c_str(), m_options.socketPath.size() + 1);
+
+    // A socket file left behind by a server that died is replaced; a live
+    // server's socket, or anything else, is not touched.
+    struct stat existing;
+    if (::lstat(m_options.socketPath.c_str(), &existing) == 0) {
+        if (!S_ISSOCK(existing.st_mode)) {
+            if (error) *error = m_options.socketPath + " exists and is not a socket";
+            return false;
+        }
+        int probe = ::socket(AF_UNIX, SOCK_STREAM, 0);
+        bool live = probe >= 0 && ::connect(probe, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+        if (probe >= 0) ::close(probe);
+        if (live) {
+            if (error) *error = m_options.socketPath + " is in use by another server";
+            return false;
+        }
+        ::unlink(m_options.socketPath.c_str());
+    }
+
+    m_listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (m_listenFd < 0) return fail(error, "socket");
+    if (::bind(m_listenFd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        bool result = fail(error, m_options.socketPath);
+        ::close(m_listenFd);
+        m_listenFd = -1;
+        return result;
+    }
+    // From here on stop() cleans up, the socket file included.
+    if (::listen(m_listenFd, SOMAXCONN) != 0 || !setNonBlocking(m_listenFd) || !makePipe(m_wakePipe)) {
+        bool result = fail(error, m_options.socketPath);
+        stop();
+        return result;
+    }
+
+    unsigned threads = m_options.threads ? m_options.threads : std::max(1u, std::thread::hardware_concurrency());
+    m_stopping = false;
+    for (unsigned i = 0; i < threads; ++i) {
+        auto worker = std::make_unique<Worker>();
+        if (!makePipe(worker->wakePipe)) {
+            bool result = fail(error, "pipe");
+            stop();
+            return result;
+        }
+        worker->thread = std::thread(&Server::serve, this, std::ref(*worker));
+        m_workers.push_back(std::move(worker));
+    }
+    m_acceptThread = std::thread(&Server::acceptLoop, this);
+    return true;
+}
+
+void Server::stop() {
+    m_stopping = true;
+    if (m_wakePipe[1] >= 0) wake(m_wakePipe[1]);
+    if (m_acceptThread.joinable()) m_acceptThread.join();
+    for (auto& worker : m_workers) {
+        wake(worker->wakePipe[1]);
+        if (worker->thread.joinable()) worker->thread.join();
+        for (int fd : worker->incoming) ::close(fd);
+        closePipe(worker->wakePipe);
+    }
+    m_workers.clear();
+    closePipe(m_wakePipe);
+    if (m_listenFd >= 0) {
+        ::close(m_listenFd);
+        m_listenFd = -1;
+        ::unlink(m_options.socketPath.c_str());
+    }
+}
+
+void Server::acceptLoop() {
+    size_t next = 0;
+    pollfd fds[2] = {{m_listenFd, POLLIN, 0}, {m_wakePipe[0], POLLIN, 0}};
+    while (!m_stopping) {
+        if (::poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+        while (true) {
+            int fd = ::accept(m_listenFd, nullptr, nullptr);
+            if (fd < 0) break; // EAGAIN, or a client that hung up while queued
+            if (!setNonBlocking(fd)) {
+                ::close(fd);
+                continue;
+            }
+            m_connections.fetch_add(1, std::memory_order_relaxed);
+            Worker& worker = *m_workers[next++ % m_workers.size()];
+            {
+                std::lock_guard lock(worker.mutex);
+                worker.incoming.push_back(fd);
+            }
+            wake(worker.wakePipe[1]);
+        }
+    }
+}
+
+void Server::serve(Worker& worker) {
+    std::vector<std::unique_ptr<Connection>> connections;
+    std::vector<pollfd> fds;
+    uint64_t served = 0;
+
+    // Answers the complete requests already read. Returns true if it
+    // stopped early because the client is not reading its replies.
+    auto answer = [&](Connection& connection) {
+        std::string_view line;
+        while (!connection.refused && connection.queued() < kMaxQueuedReplyBytes && connection.in.next(line)) {
+            std::string_view name;
+            std::string_view message;
+            splitField(line, name, message);
+            auto it = connection.sessions.find(name);
+            if (it == connection.sessions.end()) {
+                if (connection.sessions.size() >= m_options.maxSessions) {
+                    connection.refused = true;
+                    break;
+                }
+                Session session = m_options.seed ? m_engine.createSession(m_options.locale, *m_options.seed)
+                                                 : m_engine.createSession(m_options.locale);
+                it = connection.sessions.emplace(std::string(name), std::move(session)).first;
+            }
+            Response response = m_engine.respond(it->second, unescape(message));
+            appendEscaped(connection.out, name);
+            connection.out += '\t';
+            appendEscaped(connection.out, response.ruleId);
+            connection.out += '\t';
+            appendEscaped(connection.out, response.text);
+            connection.out += '\n';
+            ++served;
+        }
+        if (connection.in.overlong()) connection.refused = true;
+        return !connection.refused && connection.queued() >= kMaxQueuedReplyBytes;
+    };
+
+    while (!m_stopping) {
+        fds.clear();
+        fds.push_back({worker.wakePipe[0], POLLIN, 0});
+        for (const auto& connection : connections) {
+            short events = 0;
+            if (!connection->readClosed && !connection->refused && connection->queued() < kMaxQueuedReplyBytes) events |= POLLIN;
+            if (connection->queued() > 0) events |= POLLOUT;
+            fds.push_back({connection->fd, events, 0});
+        }
+        if (::poll(fds.data(), fds.size(), -1) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        for (size_t i = 1; i < fds.size(); ++i) {
+            if (fds[i].revents == 0) continue;
+            Connection& connection = *connections[i - 1];
+            bool alive = true;
+            if (!connection.refused && (fds[i].revents & (POLLIN | POLLHUP | POLLERR))) {
+                ssize_t received = ::read(connection.fd, connection.in.reserve(kReadChunk), kReadChunk);
+                if (received > 0) {
+                    connection.in.commit(static_cast<size_t>(received));
+                } else if (received == 0) {
+                    connection.readClosed = true;
+                    // A last request without its LF still gets an answer.
+                    if (connection.in.pending() > 0) {
+                        *connection.in.reserve(1) = '\n';
+                        connection.in.commit(1);
+                    }
+                } else if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+                    alive = false;
+                }
+            }
+            while (alive) {
+                bool heldBack = answer(connection);
+                alive = flush(connection);
+                if (!heldBack || connection.queued() > 0) break;
+            }
+            bool finished = connection.refused || (connection.readClosed && connection.in.pending() == 0);
+            if (finished && connection.queued() == 0) alive = false;
+            if (!alive) {
+                ::close(connection.fd);
+                connection.fd = -1;
+            }
+        }
+        std::erase_if(connections, [](const auto& connection) { return connection->fd < 0; });
+        m_requests.fetch_add(served, std::memory_order_relaxed);
+        served = 0;
+
+        if (fds[0].revents) {
+            drain(worker.wakePipe[0]);
+            std::lock_guard lock(worker.mutex);
+            for (int fd : worker.incoming) connections.push_back(std::make_unique<Connection>(fd, m_options.maxLineBytes));
+            worker.incoming.clear();
+        }
+    }
+
+    for (const auto& connection : connections) ::close(connection->fd);
+}
+
+}
@@ -0,0 +1,77 @@
+#ifndef DEEPTHONK3D_CLI_SERVER_H
+#define DEEPTHONK3D_CLI_SERVER_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace deep_thonk {
+    class Engine;
+}
+
+namespace deep_thonk::cli {
+
+    struct ServerOptions {
+        std::string socketPath;
+        // Locale of every new session.
+        std::string locale = "en-US";
+        // Seeds every new session the same way, for reproducible replies.
+        std::optional<uint64_t> seed;
+        // Connection threads; 0 = all cores.
+        unsigned threads = 0;
+        // What one client may make the server hold: the longest request line
+        // and the most sessions on one connection. Past either the
+        // connection is closed once its queued replies are sent.
+        size_t maxLineBytes = 1 << 20;
+        size_t maxSessions = 1024;
+    };
+
+    // Serves the engine over a Unix domain socket (see LineProtocol.h).
+    //
+    // One thread accepts connections and deals them out round-robin to the
+    // connection threads. Each of those polls its own connections, answers
+    // every complete request line as soon as it is read, and writes the
+    // replies of one read back in one send, so pipelined requests cost one
+    // syscall each way per batch instead of per message. A connection whose
+    // replies are not being read stops being read itself once 1 MB is queued,
+    // and one that breaks the line or session limits is closed.
+    class Server {
+    public:
+        Server(const Engine& engine, ServerOptions options);
+        ~Server();
+
+        Server(const Server&) = delete;
+        Server& operator=(const Server&) = delete;
+
+        // Binds the socket (replacing a stale socket file) and starts serving.
+        bool start(std::string* error = nullptr);
+        // Closes every connection, joins the threads and removes the socket file.
+        void stop();
+
+        uint64_t requestsServed() const { return m_requests.load(std::memory_order_relaxed); }
+        uint64_t connectionsAccepted() const { return m_connections.load(std::memory_order_relaxed); }
+
+    private:
+        struct Worker;
+
+        void acceptLoop();
+        void serve(Worker& worker);
+
+        const Engine& m_engine;
+        ServerOptions m_options;
+        int m_listenFd = -1;
+        int m_wakePipe[2] = {-1, -1};
+        std::thread m_acceptThread;
+        std::vector<std::unique_ptr<Worker>> m_workers;
+        std::atomic<bool> m_stopping{false};
+        std::atomic<uint64_t> m_requests{0};
+        std::atomic<uint64_t> m_connections{0};
+    };
+
+}
+
+#endif //DEEPTHONK3D_CLI_SERVER_H
@@ -0,0 +1,288 @@
+// deepThonk3d_cli: the rule engine without the GUI.
+//
+//   deepThonk3d_cli [options] [<messages.txt>]
+//       One conversation: answers each line of the file (or stdin) in turn.
+//   deepThonk3d_cli serve --socket <path> [options]
+//       Serves concurrent sessions over a Unix domain socket until SIGINT or
+//       SIGTERM (protocol in LineProtocol.h).
+//   deepThonk3d_cli loadgen [--socket <path>] [load options] [options]
+//       Drives a server with pipelined requests and reports throughput and
+//       latency percentiles. Without --socket it serves in-process, sharing
+//       the cores with the load; run `serve` separately for real numbers.
+//
+// Rules default to the shipped packs; --rules (repeatable) loads others.
+
+#include "LineProtocol.h"
+#include "LoadGenerator.h"
+#include "Server.h"
+#include "core/rogerian/Engine.h"
+#include <chrono>
+#include <csignal>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <unistd.h>
+
+namespace {
+
+using namespace deep_thonk;
+
+// Sent by loadgen when no --input is given.
+const char* const kDefaultMessages[] = {
+    "hello",
+    "I feel tired all the time",
+    "my mother never listens to me",
+    "I am not sure what I want",
+    "because work is too much",
+    "yes",
+    "I don't know",
+    "I can't sleep at night",
+    "you are not helping me",
+    "I want to be happy again",
+    "maybe it is my fault",
+    "my friends think I should quit",
+    "no",
+    "I remember when things were easier",
+    "why do I always feel this way",
+    "sorry, I was thinking about my father",
+};
+
+struct Options {
+    std::string mode;
+    std::vector<std::string> rules;
+    std::string locale = "en-US";
+    std::optional<uint64_t> seed;
+    unsigned threads = 0;
+    std::string socketPath;
+    std::string input;
+    std::string jsonPath;
+    bool ruleIds = false;
+    bool stats = false;
+    cli::LoadOptions load;
+};
+
+int usage(const char* program) {
+    std::cerr << "usage: " << program << " [options] [<messages.txt>]\n"
+              << "       " << program << " serve --socket <path> [options]\n"
+              << "       " << program << " loadgen [--socket <path>] [--input <messages.txt>] [--connections <n>]\n"
+              << "                 [--pipeline <n>] [--sessions <n>] [--requests <n> | --duration <seconds>]\n"
+              << "                 [--json <out.json>] [options]\n"
+              << "options: --rules <pack.json> (repeatable), --locale <locale> (default en-US), --seed <n>,\n"
+              << "         --threads <n> (server threads, default all cores), --rule-ids (print the rule id after\n"
+              << "         each reply), --stats (print messages per second to stderr)" << std::endl;
+    return 2;
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    int i = 1;
+    if (i < argc && (std::strcmp(argv[i], "serve") == 0 || std::strcmp(argv[i], "loadgen") == 0)) options.mode = argv[i++];
+
+    for (; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        try {
+            if (arg == "--rules" && hasValue) {
+                options.rules.push_back(argv[++i]);
+            } else if (arg == "--locale" && hasValue) {
+                options.locale = argv[++i];
+            } else if (arg == "--seed" && hasValue) {
+                options.seed = std::stoull(argv[++i]);
+            } else if (arg == "--threads" && hasValue) {
+                options.threads = static_cast<unsigned>(std::stoul(argv[++i]));
+            } else if (arg == "--rule-ids") {
+                options.ruleIds = true;
+            } else if (arg == "--stats") {
+                options.stats = true;
+            } else if (arg == "--socket" && hasValue && !options.mode.empty()) {
+                options.socketPath = argv[++i];
+            } else if (arg == "--input" && hasValue && options.mode == "loadgen") {
+                options.input = argv[++i];
+            } else if (arg == "--json" && hasValue && options.mode == "loadgen") {
+                options.jsonPath = argv[++i];
+            } else if (arg == "--connections" && hasValue && options.mode == "loadgen") {
+                options.load.connections = static_cast<unsigned>(std::stoul(argv[++i]));
+            } else if (arg == "--pipeline" && hasValue && options.mode == "loadgen") {
+                options.load.pipeline = static_cast<unsigned>(std::stoul(argv[++i]));
+            } else if (arg == "--sessions" && hasValue && options.mode == "loadgen") {
+                options.load.sessions = static_cast<unsigned>(std::stoul(argv[++i]));
+            } else if (arg == "--requests" && hasValue && options.mode == "loadgen") {
+                options.load.requests = std::stoull(argv[++i]);
+            } else if (arg == "--duration" && hasValue && options.mode == "loadgen") {
+                options.load.duration = std::chrono::milliseconds(static_cast<int64_t>(std::stod(argv[++i]) * 1000));
+            } else if (options.mode.empty() && options.input.empty() && !arg.starts_with("--")) {
+                options.input = arg;
+            } else {
+                return false;
+            }
+        } catch (const std::exception&) {
+            return false; // not a number
+        }
+    }
+    return options.mode != "serve" || !options.socketPath.empty();
+}
+
+bool loadRules(Engine& engine, const Options& options) {
+    std::vector<std::string> paths = options.rules;
+    if (paths.empty()) {
+        for (const char* locale : {"en-US", "pt-BR"}) paths.push_back(std::string(DEEPTHONK_RULES_DIR) + "/" + locale + ".json");
+    }
+
+    // The engine logs every pack it loads on stdout, which carries the replies.
+    std::streambuf* previous = std::cout.rdbuf(std::cerr.rdbuf());
+    bool loaded = true;
+    for (const std::string& path : paths) {
+        try {
+            loaded = engine.loadRulesFromFile(path) && loaded;
+        } catch (const std::exception& error) {
+            std::cerr << path << ": " << error.what() << std::endl;
+            loaded = false;
+        }
+    }
+    std::cout.rdbuf(previous);
+
+    if (loaded && !engine.getRulePack(options.locale)) {
+        std::cerr << "no rules loaded for locale " << options.locale << std::endl;
+        loaded = false;
+    }
+    return loaded;
+}
+
+int converse(const Engine& engine, const Options& options) {
+    std::ifstream file;
+    if (!options.input.empty()) {
+        file.open(options.input, std::ios::binary);
+        if (!file) {
+            std::cerr << "cannot read " << options.input << std::endl;
+            return 1;
+        }
+    }
+    std::istream& input = options.input.empty() ? std::cin : file;
+    // Whoever writes to stdin may wait for each reply before the next line.
+    bool interactive = options.input.empty();
+
+    Session session = options.seed ? engine.createSession(options.locale, *options.seed) : engine.createSession(options.locale);
+    std::string line;
+    uint64_t messages = 0;
+    auto start = std::chrono::steady_clock::now();
+    while (std::getline(input, line)) {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        Response response = engine.respond(session, line);
+        std::cout << response.text;
+        if (options.ruleIds) std::cout << '\t' << response.ruleId;
+        std::cout << '\n';
+        if (interactive) std::cout.flush();
+        ++messages;
+    }
+    std::cout.flush();
+
+    if (options.stats) {
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cerr << "Answered " << messages << " messages in " << seconds * 1e3 << " ms ("
+                  << (seconds > 0 ? double(messages) / seconds : 0) << " messages/s)" << std::endl;
+    }
+    return std::cout ? 0 : 1;
+}
+
+int serve(const Engine& engine, const Options& options) {
+    // Every thread inherits the blocked signals, so only sigwait below sees them.
+    sigset_t signals;
+    sigemptyset(&signals);
+    sigaddset(&signals, SIGINT);
+    sigaddset(&signals, SIGTERM);
+    pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+    cli::ServerOptions serverOptions{options.socketPath, options.locale, options.seed, options.threads};
+    cli::Server server(engine, serverOptions);
+    std::string error;
+    if (!server.start(&error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    std::cerr << "Serving " << options.locale << " on " << options.socketPath << std::endl;
+
+    int received = 0;
+    sigwait(&signals, &received);
+    server.stop();
+    std::cerr << "Served " << server.requestsServed() << " requests over " << server.connectionsAccepted()
+              << " connections" << std::endl;
+    return 0;
+}
+
+int loadgen(const Engine* engine, Options options) {
+    if (!options.input.empty()) {
+        std::ifstream file(options.input, std::ios::binary);
+        if (!file) {
+            std::cerr << "cannot read " << options.input << std::endl;
+            return 1;
+        }
+        for (std::string line; std::getline(file, line);) {
+            if (!line.empty() && line.back() == '\r') line.pop_back();
+            if (!line.empty()) options.load.messages.push_back(std::move(line));
+        }
+    } else {
+        options.load.messages.assign(std::begin(kDefaultMessages), std::end(kDefaultMessages));
+    }
+
+    std::optional<cli::Server> server;
+    std::string error;
+    if (engine) {
+        options.socketPath = (std::filesystem::temp_directory_path() /
+                              ("deepThonk3d-" + std::to_string(::getpid()) + ".sock")).string();
+        server.emplace(*engine, cli::ServerOptions{options.socketPath, options.locale, options.seed, options.threads});
+        if (!server->start(&error)) {
+            std::cerr << error << std::endl;
+            return 1;
+        }
+    }
+    options.load.socketPath = options.socketPath;
+
+    cli::LoadReport report;
+    if (!cli::runLoad(options.load, report, &error)) {
+        std::cerr << error << std::endl;
+        return 1;
+    }
+    if (server) server->stop();
+
+    auto us = [](uint64_t ns) { return double(ns) / 1e3; };
+    std::cout << report.replies << " replies in " << report.seconds << " s: " << report.throughput() << " replies/s over "
+              << options.load.connections << " connections x " << options.load.pipeline << " in flight, "
+              << report.errors << " errors\n"
+              << "latency us: mean " << report.latency.mean() / 1e3 << ", p50 " << us(report.latency.percentile(0.5))
+              << ", p90 " << us(report.latency.percentile(0.9)) << ", p99 " << us(report.latency.percentile(0.99))
+              << ", p99.9 " << us(report.latency.percentile(0.999)) << ", max " << us(report.latency.max()) << std::endl;
+
+    if (!options.jsonPath.empty()) {
+        std::ofstream output(options.jsonPath, std::ios::trunc);
+        output << report.toJson(options.load).dump(2) << std::endl;
+        if (!output) {
+            std::cerr << "cannot write " << options.jsonPath << std::endl;
+            return 1;
+        }
+    }
+    return report.errors == 0 && report.replies > 0 ? 0 : 1;
+}
+
+}
+
+int main(int argc, char *argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options)) return usage(argv[0]);
+
+    // A client that hangs up mid-reply must not kill the process.
+    std::signal(SIGPIPE, SIG_IGN);
+
+    bool needsEngine = options.mode != "loadgen" || options.socketPath.empty();
+    Engine engine;
+    if (needsEngine && !loadRules(engine, options)) return 1;
+
+    if (options.mode == "serve") return serve(engine, options);
+    if (options.mode == "loadgen") return loadgen(needsEngine ? &engine : nullptr, std::move(options));
+    return converse(engine, options);
+}
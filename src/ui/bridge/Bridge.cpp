@@ -1,35 +1,137 @@
 #include "Bridge.h"
+#include <QCoreApplication>
+#include <QDateTime>
 #include <QDebug>
 #include <QFile>
-#include <QTextStream>
+#include <QThread>
+#include <fstream>
+#include <random>
+#include <stdexcept>
 
-Bridge::Bridge(QObject *parent) : QObject(parent)
+namespace {
+
+const char* const kDefaultLocale = "en-US";
+
+}
+
+Bridge::Bridge(QObject *parent) : Bridge(QString(), parent)
 {
-    // Load rule files from resources
-    QFile enFile(":/resources/rules/en-US.json");
-    if (enFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QTextStream in(&enFile);
-        std::string content = in.readAll().toStdString();
-        m_engine.loadRulesFromString(content);
-        enFile.close();
-    }
+}
 
-    QFile ptFile(":/resources/rules/pt-BR.json");
-    if (ptFile.open(QIODevice::ReadOnly | QIODevice::Text)) {
-        QTextStream in(&ptFile);
-        std::string content = in.readAll().toStdString();
-        m_engine.loadRulesFromString(content);
-        ptFile.close();
-    }
+Bridge::Bridge(const QString &journalPath, QObject *parent) : QObject(parent)
+{
+    // Declare the rule packs without compiling them, so the window shows up at
+    // once; each is compiled the first time its locale is selected
+    declareRulePack("en-US");
+    declareRulePack("pt-BR");
 
     m_ruleModel = new RuleModel(&m_engine, this);
+    m_chatModel = new ChatModel(this);
+
+    // A fresh seed per run, kept in the journal next to the choices it made
+    m_seed = (quint64(std::random_device{}()) << 32) ^ std::random_device{}();
+    m_session.rng.seed(m_seed);
+    if (!journalPath.isEmpty())
+        openJournal(journalPath);
+
+    // One worker answers messages in the order they were submitted, so a
+    // slow match never stalls the GUI thread
+    m_replyPool.setMaxThreadCount(1);
+    m_replyPool.setExpiryTimeout(-1);
+
+    // One reload at a time, so packs are published in the order they were requested
+    m_reloadPool.setMaxThreadCount(1);
 
     // Set default locale
-    setLocale("en-US");
+    setLocale(kDefaultLocale);
 }
 
 Bridge::~Bridge()
 {
+    // Queued messages return without matching; the pools then drain on destruction
+    cancelPending();
+}
+
+void Bridge::declareRulePack(const QString &locale)
+{
+    // Prefer the precompiled blob built next to the app
+    QString blobPath = QCoreApplication::applicationDirPath() + "/rules/" + locale + ".dtpack";
+
+    m_engine.addLazyRulePack(locale.toStdString(), [locale, blobPath] {
+        QFile file(":/resources/rules/" + locale + ".json");
+        if (!file.open(QIODevice::ReadOnly))
+            throw std::runtime_error("missing rule pack resource");
+        // Raw bytes, so the source fingerprint matches what deepThonk3d_rulec hashed.
+        return deep_thonk::PackSource{file.readAll().toStdString(), blobPath.toStdString()};
+    });
+}
+
+void Bridge::openJournal(const QString &path)
+{
+    // Rebuild the chat and the hit counts from the recorded replies; nothing is matched again
+    deep_thonk::JournalReader reader;
+    if (reader.open(path.toStdString())) {
+        std::string locale;
+        deep_thonk::JournalRecord record;
+        while (reader.next(record)) {
+            if (record.type != deep_thonk::JournalRecord::Type::Exchange) {
+                locale = record.locale;
+                continue;
+            }
+            auto timestamp = static_cast<qint64>(record.timestampMs);
+            QString ruleId = QString::fromUtf8(record.ruleId.data(), static_cast<qsizetype>(record.ruleId.size()));
+            m_chatModel->append(ChatModel::Speaker::User,
+                                QString::fromUtf8(record.input.data(), static_cast<qsizetype>(record.input.size())),
+                                QString(), timestamp);
+            m_chatModel->append(ChatModel::Speaker::Therapist,
+                                QString::fromUtf8(record.reply.data(), static_cast<qsizetype>(record.reply.size())),
+                                ruleId, timestamp);
+            if (!record.ruleId.empty())
+                ++m_restoredHits[QString::fromStdString(locale)][std::string(record.ruleId)];
+        }
+        if (reader.truncated())
+            qWarning() << "Journal ends in a torn record; it is dropped:" << path;
+    }
+
+    if (!m_journal.open(path.toStdString())) {
+        qWarning() << "Cannot open journal:" << path;
+        return;
+    }
+    m_journalPath = path;
+
+    deep_thonk::JournalRecord start;
+    start.type = deep_thonk::JournalRecord::Type::Start;
+    start.timestampMs = static_cast<uint64_t>(QDateTime::currentMSecsSinceEpoch());
+    start.seed = m_seed;
+    start.locale = kDefaultLocale;
+    m_journal.append(start);
+}
+
+void Bridge::loadLocale(const QString &locale)
+{
+    if (m_loadingLocales.contains(locale) || m_engine.getRulePack(locale.toStdString()))
+        return;
+    m_loadingLocales.insert(locale);
+
+    m_loadPool.start([this, locale] {
+        bool loaded = m_engine.ensureLoaded(locale.toStdString());
+        QMetaObject::invokeMethod(this, [this, locale, loaded] {
+            m_loadingLocales.remove(locale);
+            if (!loaded) {
+                qWarning() << "Missing rule pack for locale:" << locale;
+                return;
+            }
+            auto restored = m_restoredHits.find(locale);
+            if (restored != m_restoredHits.end()) {
+                m_engine.restoreHits(locale.toStdString(), restored->second);
+                m_restoredHits.erase(restored);
+            }
+            m_ruleModel->reloadLocale(locale);
+            emit localeReady(locale);
+            if (locale == m_locale)
+                emit readyChanged();
+        }, Qt::QueuedConnection);
+    });
 }
 
 QAbstractItemModel* Bridge::ruleModel() const
@@ -37,16 +139,121 @@ QAbstractItemModel* Bridge::ruleModel() const
     return m_ruleModel;
 }
 
+QAbstractItemModel* Bridge::chatModel() const
+{
+    return m_chatModel;
+}
+
+bool Bridge::instrumentationEnabled() const
+{
+    return deep_thonk::kInstrumentationEnabled;
+}
+
+bool Bridge::isReady() const
+{
+    return m_engine.getRulePack(m_locale.toStdString()) != nullptr;
+}
+
 void Bridge::submitMessage(const QString &message)
 {
     qDebug() << "Message received:" << message;
-    deep_thonk::Response response = m_engine.respond(message.toStdString());
-    emit rogerianReply(QString::fromStdString(response.text), QString::fromStdString(response.ruleId));
-    m_ruleModel->onRuleMatched(QString::fromStdString(response.ruleId));
+    quint64 epoch = m_epoch.load();
+    m_chatModel->append(ChatModel::Speaker::User, message);
+
+    m_replyPool.start([this, epoch, text = message.toStdString()] {
+        if (epoch != m_epoch.load())
+            return;
+        if (int delay = m_replyDelayMs.load())
+            QThread::msleep(static_cast<unsigned long>(delay));
+
+        deep_thonk::Response response = m_engine.respond(m_session, text);
+
+        QMetaObject::invokeMethod(this, [this, epoch, text, response = std::move(response)] {
+            // Cancelled while the worker was still matching
+            if (epoch != m_epoch.load())
+                return;
+            QString reply = QString::fromStdString(response.text);
+            QString ruleId = QString::fromStdString(response.ruleId);
+            if (m_journal.isOpen()) {
+                deep_thonk::JournalRecord exchange;
+                exchange.timestampMs = static_cast<uint64_t>(QDateTime::currentMSecsSinceEpoch());
+                exchange.templateIndex = response.templateIndex;
+                exchange.input = text;
+                exchange.ruleId = response.ruleId;
+                exchange.reply = response.text;
+                m_journal.append(exchange);
+            }
+            m_chatModel->append(ChatModel::Speaker::Therapist, reply, ruleId);
+            emit rogerianReply(reply, ruleId);
+            m_ruleModel->onRuleMatched(ruleId);
+        }, Qt::QueuedConnection);
+    });
 }
 
 void Bridge::setLocale(const QString &locale)
 {
     qDebug() << "Locale set to:" << locale;
-    m_engine.setLocale(locale.toStdString());
+    bool wasReady = isReady();
+    if (m_journal.isOpen() && !m_locale.isEmpty() && locale != m_locale) {
+        std::string name = locale.toStdString();
+        deep_thonk::JournalRecord record;
+        record.type = deep_thonk::JournalRecord::Type::Locale;
+        record.timestampMs = static_cast<uint64_t>(QDateTime::currentMSecsSinceEpoch());
+        record.locale = name;
+        m_journal.append(record);
+    }
+    m_locale = locale;
+    loadLocale(locale);
+    if (isReady() != wasReady)
+        emit readyChanged();
+
+    // The default session lives on the reply worker; queue the switch behind
+    // the messages already submitted. Never cancelled. Waits for a compile
+    // still running on the load pool, so no reply is made without rules.
+    m_replyPool.start([this, locale = locale.toStdString()] {
+        m_engine.ensureLoaded(locale);
+        m_engine.setLocale(m_session, locale);
+    });
+}
+
+void Bridge::cancelPending()
+{
+    ++m_epoch;
+}
+
+void Bridge::reloadRules(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) {
+        emit rulesReloadFailed(path, file.errorString());
+        return;
+    }
+    std::string content = file.readAll().toStdString();
+
+    m_reloadPool.start([this, path, content = std::move(content)] {
+        try {
+            QString locale = QString::fromStdString(m_engine.reloadRules(content));
+            QMetaObject::invokeMethod(this, [this, locale] {
+                m_ruleModel->reloadLocale(locale);
+                emit rulesReloaded(locale);
+            }, Qt::QueuedConnection);
+        } catch (const std::exception &error) {
+            QString message = QString::fromUtf8(error.what());
+            QMetaObject::invokeMethod(this, [this, path, message] {
+                qWarning() << "Rule reload failed:" << path << message;
+                emit rulesReloadFailed(path, message);
+            }, Qt::QueuedConnection);
+        }
+    });
+}
+
+bool Bridge::exportChat(const QString &path)
+{
+    if (!m_journal.isOpen())
+        return false;
+    m_journal.flush();
+
+    std::ofstream out(path.toStdString(), std::ios::binary | std::ios::trunc);
+    auto format = path.endsWith(".json", Qt::CaseInsensitive) ? deep_thonk::JournalFormat::Json : deep_thonk::JournalFormat::Text;
+    return deep_thonk::exportJournal(m_journalPath.toStdString(), out, format) && out.flush().good();
 }
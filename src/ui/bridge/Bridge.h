@@ -2,30 +2,96 @@
 #define DEEPTHONK3D_BRIDGE_H
 
 #include <QObject>
+#include <QSet>
+#include <QThreadPool>
 #include "../../core/rogerian/Engine.h"
+#include "../../core/rogerian/Journal.h"
+#include "../model/ChatModel.h"
 #include "../model/RuleModel.h"
+#include <atomic>
+#include <map>
+#include <string>
+#include <unordered_map>
 
 class Bridge : public QObject
 {
     Q_OBJECT
     Q_PROPERTY(QAbstractItemModel* ruleModel READ ruleModel CONSTANT)
+    // The conversation so far: each message as it is submitted, each reply as
+    // it is delivered.
+    Q_PROPERTY(QAbstractItemModel* chatModel READ chatModel CONSTANT)
+    Q_PROPERTY(bool instrumentationEnabled READ instrumentationEnabled CONSTANT)
+    // True once the selected locale's rule pack is compiled.
+    Q_PROPERTY(bool ready READ isReady NOTIFY readyChanged)
 
 public:
     explicit Bridge(QObject *parent = nullptr);
+    // Same, keeping the conversation in the journal at `journalPath`: the
+    // chat history and rule hit counts recorded there are restored first,
+    // then every exchange is appended (see JournalWriter).
+    explicit Bridge(const QString &journalPath, QObject *parent = nullptr);
     ~Bridge();
 
     QAbstractItemModel* ruleModel() const;
+    QAbstractItemModel* chatModel() const;
+    bool instrumentationEnabled() const;
+    bool isReady() const;
+
+    // For tests: the reply worker sleeps this long before matching each
+    // message, so a slow reply can be had regardless of the rules.
+    void setReplyDelayForTesting(int ms) { m_replyDelayMs = ms; }
 
 public slots:
+    // Queues `message` for the engine's worker thread and returns at once.
+    // The answer arrives later through rogerianReply, queued back onto this
+    // object's thread, in the order the messages were submitted.
     void submitMessage(const QString &message);
+    // Selects `locale` for the next replies, compiling its rule pack in the
+    // background the first time. Messages sent meanwhile wait for the pack.
     void setLocale(const QString &locale);
+    // Drops every message that has not been answered yet. A reply already
+    // being computed finishes on the worker but is never delivered.
+    void cancelPending();
+    // Recompiles the JSON rule pack at `path` off the UI thread and swaps it
+    // in for its locale; conversations carry on against the old pack meanwhile.
+    void reloadRules(const QString &path);
+    // Writes the journal to `path` as a text transcript, or as JSON when the
+    // name ends in ".json". False without a journal or if `path` cannot be written.
+    bool exportChat(const QString &path);
 
 signals:
     void rogerianReply(const QString &reply, const QString &ruleId);
+    void localeReady(const QString &locale);
+    void readyChanged();
+    void rulesReloaded(const QString &locale);
+    void rulesReloadFailed(const QString &path, const QString &error);
 
 private:
+    void declareRulePack(const QString &locale);
+    void loadLocale(const QString &locale);
+    void openJournal(const QString &path);
+
     RuleModel* m_ruleModel;
+    ChatModel* m_chatModel;
+    QString m_locale;
+    QSet<QString> m_loadingLocales;
     deep_thonk::Engine m_engine;
+    // Used only on the reply worker, after construction.
+    deep_thonk::Session m_session;
+    quint64 m_seed;
+    QString m_journalPath;
+    deep_thonk::JournalWriter m_journal;
+    // Hits replayed from the journal, applied once each locale's pack is compiled.
+    std::map<QString, std::unordered_map<std::string, uint64_t>> m_restoredHits;
+    // Bumped by cancelPending; requests from an older epoch are stale.
+    std::atomic<quint64> m_epoch{0};
+    std::atomic<int> m_replyDelayMs{0};
+    // The pools are declared last so they are destroyed first, waiting out
+    // any work still using m_engine. The reply pool has a single thread, which
+    // owns m_session; the load pool compiles packs in parallel.
+    QThreadPool m_replyPool;
+    QThreadPool m_loadPool;
+    QThreadPool m_reloadPool;
 };
 
 #endif //DEEPTHONK3D_BRIDGE_H
@@ -0,0 +1,111 @@
+#include "ChatModel.h"
+#include <QDateTime>
+
+namespace {
+
+// Initial pool size per chunk, in UTF-16 units; most chunks never grow past it.
+constexpr qsizetype kChunkTextReserve = qsizetype(ChatModel::kChunkSize) * 64;
+
+}
+
+ChatModel::ChatModel(QObject *parent) : QAbstractListModel(parent)
+{
+    // Rule id 0 is "no rule", for the user's messages
+    internRuleId(QString());
+}
+
+ChatModel::~ChatModel()
+{
+}
+
+int ChatModel::rowCount(const QModelIndex &parent) const
+{
+    return parent.isValid() ? 0 : m_count;
+}
+
+const ChatModel::Message& ChatModel::message(int row, const Chunk** chunk) const
+{
+    *chunk = m_chunks[row / kChunkSize].get();
+    return (*chunk)->messages[row % kChunkSize];
+}
+
+QVariant ChatModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row() < 0 || index.row() >= m_count)
+        return QVariant();
+
+    const Chunk* chunk = nullptr;
+    const Message& entry = message(index.row(), &chunk);
+    switch (role) {
+    case TimestampRole:
+        return QDateTime::fromMSecsSinceEpoch(entry.timestampMs);
+    case SpeakerRole:
+        return entry.speaker == Speaker::User ? QStringLiteral("user") : QStringLiteral("therapist");
+    case Qt::DisplayRole:
+    case TextRole:
+        return QString(chunk->text.constData() + entry.textOffset, entry.textLength);
+    case RuleIdRole:
+        return m_ruleIds.at(entry.ruleId);
+    default:
+        return QVariant();
+    }
+}
+
+QHash<int, QByteArray> ChatModel::roleNames() const
+{
+    return {
+        {TimestampRole, "timestamp"},
+        {SpeakerRole, "speaker"},
+        {TextRole, "text"},
+        {RuleIdRole, "ruleId"}
+    };
+}
+
+void ChatModel::append(Speaker speaker, const QString &text, const QString &ruleId)
+{
+    append(speaker, text, ruleId, QDateTime::currentMSecsSinceEpoch());
+}
+
+void ChatModel::append(Speaker speaker, const QString &text, const QString &ruleId, qint64 timestampMs)
+{
+    if (m_count == static_cast<int>(m_chunks.size()) * kChunkSize) {
+        auto chunk = std::make_unique<Chunk>();
+        chunk->text.reserve(kChunkTextReserve);
+        m_chunks.push_back(std::move(chunk));
+    }
+
+    beginInsertRows(QModelIndex(), m_count, m_count);
+    Chunk& chunk = *m_chunks[m_count / kChunkSize];
+    Message& entry = chunk.messages[m_count % kChunkSize];
+    entry.timestampMs = timestampMs;
+    entry.textOffset = static_cast<quint32>(chunk.text.size());
+    entry.textLength = static_cast<quint32>(text.size());
+    entry.ruleId = internRuleId(ruleId);
+    entry.speaker = speaker;
+    chunk.text.append(text);
+    ++m_count;
+    endInsertRows();
+    emit countChanged();
+}
+
+void ChatModel::clear()
+{
+    if (m_count == 0)
+        return;
+    beginResetModel();
+    m_chunks.clear();
+    m_count = 0;
+    endResetModel();
+    emit countChanged();
+}
+
+quint32 ChatModel::internRuleId(const QString &ruleId)
+{
+    auto it = m_ruleIdIndex.constFind(ruleId);
+    if (it != m_ruleIdIndex.constEnd())
+        return it.value();
+    auto id = static_cast<quint32>(m_ruleIds.size());
+    m_ruleIds.append(ruleId);
+    m_ruleIdIndex.insert(ruleId, id);
+    return id;
+}
@@ -0,0 +1,82 @@
+#ifndef DEEPTHONK3D_CHATMODEL_H
+#define DEEPTHONK3D_CHATMODEL_H
+
+#include <QAbstractListModel>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+// The chat transcript as a list model, one row per message, for a ListView
+// that only instantiates the rows on screen.
+//
+// Messages are stored append-only in fixed-size chunks. A chunk holds the
+// message records and one UTF-16 pool with their texts, so appending never
+// moves an existing message and costs the same on the first line and the
+// 100,000th. Rule ids are interned once and shared between rows. QStrings for
+// the text are only built when a delegate asks for them.
+class ChatModel : public QAbstractListModel
+{
+    Q_OBJECT
+    Q_PROPERTY(int count READ count NOTIFY countChanged)
+
+public:
+    enum Role {
+        TimestampRole = Qt::UserRole + 1,
+        SpeakerRole,
+        TextRole,
+        RuleIdRole
+    };
+
+    enum class Speaker : quint8 { User, Therapist };
+
+    // Messages per chunk.
+    static constexpr int kChunkSize = 1024;
+
+    explicit ChatModel(QObject *parent = nullptr);
+    ~ChatModel();
+
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int count() const { return m_count; }
+    QVariant data(const QModelIndex &index, int role) const override;
+    QHash<int, QByteArray> roleNames() const override;
+
+    // Appends one message stamped with the current time; `ruleId` is empty
+    // for the user's own messages.
+    void append(Speaker speaker, const QString &text, const QString &ruleId = QString());
+    // Same, with an explicit time in milliseconds since the epoch.
+    void append(Speaker speaker, const QString &text, const QString &ruleId, qint64 timestampMs);
+
+public slots:
+    void clear();
+
+signals:
+    void countChanged();
+
+private:
+    struct Message {
+        qint64 timestampMs;
+        quint32 textOffset; // into the chunk's pool
+        quint32 textLength;
+        quint32 ruleId;     // into m_ruleIds
+        Speaker speaker;
+    };
+
+    struct Chunk {
+        std::array<Message, kChunkSize> messages;
+        QString text;
+    };
+
+    const Message& message(int row, const Chunk** chunk) const;
+    quint32 internRuleId(const QString &ruleId);
+
+    std::vector<std::unique_ptr<Chunk>> m_chunks;
+    int m_count = 0;
+    QStringList m_ruleIds;
+    QHash<QString, quint32> m_ruleIdIndex;
+};
+
+#endif //DEEPTHONK3D_CHATMODEL_H
@@ -1,24 +1,123 @@
 #include "RuleModel.h"
-#include "TreeItem.h"
-#include <QStringList>
+#include <algorithm>
+#include <string_view>
+
+namespace {
+
+// Columns shown after Hits when the engine is built with instrumentation.
+constexpr int kFirstInstrumentationColumn = 5;
+
+// Internal id layout, sized to fit a 32-bit quintptr (WASM):
+// 2 bits level | 6 bits locale | 24 bits position.
+constexpr quintptr kLevelBits = 2;
+constexpr quintptr kLocaleBits = 6;
+constexpr quintptr kPositionMask = (quintptr(1) << 24) - 1;
+constexpr size_t kMaxLocales = size_t(1) << kLocaleBits;
+
+QString fromStd(std::string_view text)
+{
+    return QString::fromUtf8(text.data(), static_cast<qsizetype>(text.size()));
+}
+
+}
 
 RuleModel::RuleModel(deep_thonk::Engine* engine, QObject *parent)
     : QAbstractItemModel(parent), m_engine(engine)
 {
-    rootItem = new TreeItem({tr("Locale"), tr("Category"), tr("Pattern"), tr("Templates"), tr("Hits")});
-    setupModelData(m_engine->getRulePacks(), rootItem);
+    m_headers = QStringList{tr("Locale"), tr("Category"), tr("Pattern"), tr("Templates"), tr("Hits")};
+    if (deep_thonk::kInstrumentationEnabled)
+        m_headers << tr("Evals") << tr("Misses") << tr("Avg µs");
+
+    for (const auto& [locale, pack] : m_engine->getRulePacks()) {
+        if (m_locales.size() == kMaxLocales)
+            break;
+        LocaleNode& node = m_locales.emplace_back();
+        node.name = fromStd(locale);
+        node.row = static_cast<int>(m_rows.size());
+        m_rows.push_back(static_cast<uint32_t>(m_locales.size() - 1));
+        buildLocale(node, pack);
+    }
+    rebuildRuleIndex();
+
+    m_flushTimer.setSingleShot(true);
+    m_flushTimer.setInterval(kHitFlushIntervalMs);
+    connect(&m_flushTimer, &QTimer::timeout, this, &RuleModel::flushHits);
 }
 
 RuleModel::~RuleModel()
 {
-    delete rootItem;
 }
 
-int RuleModel::columnCount(const QModelIndex &parent) const
+quintptr RuleModel::packId(Level level, uint32_t locale, uint32_t position)
+{
+    return static_cast<quintptr>(level) | (quintptr(locale) << kLevelBits) | (quintptr(position) << (kLevelBits + kLocaleBits));
+}
+
+RuleModel::NodeRef RuleModel::unpackId(quintptr id)
+{
+    return {static_cast<Level>(id & ((quintptr(1) << kLevelBits) - 1)),
+            static_cast<uint32_t>((id >> kLevelBits) & ((quintptr(1) << kLocaleBits) - 1)),
+            static_cast<uint32_t>((id >> (kLevelBits + kLocaleBits)) & kPositionMask)};
+}
+
+void RuleModel::buildLocale(LocaleNode& node, const std::shared_ptr<const deep_thonk::RulePack>& pack) const
+{
+    const auto& rules = pack->rules;
+    node.pack = pack;
+
+    // Categories are already numbered in order of first appearance; count their rules...
+    node.categoryRuleCount.assign(pack->categories.size(), 0);
+    for (const auto& rule : rules)
+        ++node.categoryRuleCount[rule.category];
+
+    node.categoryFirstRule.resize(node.categoryRuleCount.size());
+    uint32_t next = 0;
+    for (size_t c = 0; c < node.categoryRuleCount.size(); ++c) {
+        node.categoryFirstRule[c] = next;
+        next += node.categoryRuleCount[c];
+    }
+
+    // ...then lay the rules out grouped by category, keeping pack order within each.
+    node.rulePackIndex.assign(rules.size(), 0);
+    node.ruleCategory.assign(rules.size(), 0);
+    node.ruleDirty.assign(rules.size(), 0);
+    std::vector<uint32_t> fill(node.categoryFirstRule);
+    for (size_t i = 0; i < rules.size(); ++i) {
+        uint32_t position = fill[rules[i].category]++;
+        node.rulePackIndex[position] = static_cast<uint32_t>(i);
+        node.ruleCategory[position] = rules[i].category;
+    }
+
+    node.stats = deep_thonk::LocaleStats();
+}
+
+void RuleModel::clearLocale(LocaleNode& node) const
 {
-    if (parent.isValid())
-        return static_cast<TreeItem*>(parent.internalPointer())->columnCount();
-    return rootItem->columnCount();
+    node.categoryFirstRule.clear();
+    node.categoryRuleCount.clear();
+    node.rulePackIndex.clear();
+    node.ruleCategory.clear();
+    node.ruleDirty.clear();
+    node.stats = deep_thonk::LocaleStats();
+}
+
+void RuleModel::rebuildRuleIndex()
+{
+    m_ruleIndex.clear();
+    for (uint32_t locale : m_rows) {
+        const LocaleNode& node = m_locales[locale];
+        m_ruleIndex.reserve(m_ruleIndex.size() + static_cast<qsizetype>(node.rulePackIndex.size()));
+        for (uint32_t position = 0; position < node.rulePackIndex.size(); ++position) {
+            QString id = fromStd(node.pack->str(node.pack->rules[node.rulePackIndex[position]].id));
+            if (!m_ruleIndex.contains(id))
+                m_ruleIndex.insert(id, {locale, position});
+        }
+    }
+}
+
+int RuleModel::columnCount(const QModelIndex &) const
+{
+    return static_cast<int>(m_headers.size());
 }
 
 QVariant RuleModel::data(const QModelIndex &index, int role) const
@@ -26,30 +125,67 @@ QVariant RuleModel::data(const QModelIndex &index, int role) const
     if (!index.isValid())
         return QVariant();
 
-    TreeItem *item = static_cast<TreeItem*>(index.internalPointer());
-    QVariant value;
-
     switch (role) {
         case Qt::DisplayRole:
         case NameRole:
-            value = item->data(0);
-            break;
         case CategoryRole:
-            value = item->data(1);
-            break;
         case PatternRole:
-            value = item->data(2);
-            break;
         case TemplatesRole:
-            value = item->data(3);
-            break;
         case HitsRole:
-            value = item->data(4);
+        case EvaluationsRole:
+        case MissesRole:
+        case AvgEvalRole:
             break;
         default:
             return QVariant();
     }
 
+    NodeRef ref = unpackId(index.internalId());
+    const LocaleNode& node = m_locales[ref.locale];
+    QVariant value;
+
+    if (ref.level == Level::Locale) {
+        if (role == Qt::DisplayRole || role == NameRole)
+            value = node.name;
+    } else if (ref.level == Level::Category) {
+        if (role == Qt::DisplayRole || role == NameRole)
+            value = fromStd(node.pack->str(node.pack->categories[ref.position]));
+    } else {
+        uint32_t packIndex = node.rulePackIndex[ref.position];
+        const deep_thonk::RulePack& pack = *node.pack;
+        const deep_thonk::Rule& rule = pack.rules[packIndex];
+        const deep_thonk::RuleStats* stats = packIndex < node.stats.rules.size() ? &node.stats.rules[packIndex] : nullptr;
+
+        switch (role) {
+            case Qt::DisplayRole:
+            case NameRole:
+                value = fromStd(pack.str(rule.id));
+                break;
+            case CategoryRole:
+                value = fromStd(pack.category(rule));
+                break;
+            case PatternRole:
+                value = fromStd(pack.str(rule.patternString));
+                break;
+            case TemplatesRole:
+                value = QVariant(static_cast<qulonglong>(rule.templateCount));
+                break;
+            case HitsRole:
+                value = QVariant(static_cast<qulonglong>(rule.hits.load()));
+                break;
+            case EvaluationsRole:
+                if (stats) value = QVariant(static_cast<qulonglong>(stats->evaluations));
+                break;
+            case MissesRole:
+                if (stats) value = QVariant(static_cast<qulonglong>(stats->misses()));
+                break;
+            case AvgEvalRole:
+                if (stats && stats->evaluations)
+                    value = QString::number(stats->evalNs / 1000.0 / stats->evaluations, 'f', 2);
+                break;
+        }
+    }
+
     return value.isValid() ? value : QVariant(QString(""));
 }
 
@@ -61,6 +197,9 @@ QHash<int, QByteArray> RuleModel::roleNames() const
     roles[PatternRole] = "pattern";
     roles[TemplatesRole] = "templates";
     roles[HitsRole] = "hits";
+    roles[EvaluationsRole] = "evaluations";
+    roles[MissesRole] = "misses";
+    roles[AvgEvalRole] = "avgEvalMicros";
     return roles;
 }
 
@@ -74,8 +213,8 @@ Qt::ItemFlags RuleModel::flags(const QModelIndex &index) const
 
 QVariant RuleModel::headerData(int section, Qt::Orientation orientation, int role) const
 {
-    if (orientation == Qt::Horizontal && role == Qt::DisplayRole)
-        return rootItem->data(section);
+    if (orientation == Qt::Horizontal && role == Qt::DisplayRole && section >= 0 && section < m_headers.size())
+        return m_headers.at(section);
 
     return QVariant();
 }
@@ -85,17 +224,15 @@ QModelIndex RuleModel::index(int row, int column, const QModelIndex &parent) con
     if (!hasIndex(row, column, parent))
         return QModelIndex();
 
-    TreeItem *parentItem;
-
     if (!parent.isValid())
-        parentItem = rootItem;
-    else
-        parentItem = static_cast<TreeItem*>(parent.internalPointer());
+        return createIndex(row, column, packId(Level::Locale, m_rows[static_cast<size_t>(row)], 0));
 
-    TreeItem *childItem = parentItem->child(row);
-    if (childItem)
-        return createIndex(row, column, childItem);
-    return QModelIndex();
+    NodeRef ref = unpackId(parent.internalId());
+    if (ref.level == Level::Locale)
+        return createIndex(row, column, packId(Level::Category, ref.locale, static_cast<uint32_t>(row)));
+
+    const LocaleNode& node = m_locales[ref.locale];
+    return createIndex(row, column, packId(Level::Rule, ref.locale, node.categoryFirstRule[ref.position] + static_cast<uint32_t>(row)));
 }
 
 QModelIndex RuleModel::parent(const QModelIndex &index) const
@@ -103,87 +240,164 @@ QModelIndex RuleModel::parent(const QModelIndex &index) const
     if (!index.isValid())
         return QModelIndex();
 
-    TreeItem *childItem = static_cast<TreeItem*>(index.internalPointer());
-    TreeItem *parentItem = childItem->parentItem();
-
-    if (parentItem == rootItem)
-        return QModelIndex();
-
-    return createIndex(parentItem->row(), 0, parentItem);
+    NodeRef ref = unpackId(index.internalId());
+    switch (ref.level) {
+        case Level::Locale:
+            return QModelIndex();
+        case Level::Category:
+            return createIndex(m_locales[ref.locale].row, 0, packId(Level::Locale, ref.locale, 0));
+        case Level::Rule: {
+            uint32_t category = m_locales[ref.locale].ruleCategory[ref.position];
+            return createIndex(static_cast<int>(category), 0, packId(Level::Category, ref.locale, category));
+        }
+    }
+    return QModelIndex();
 }
 
 int RuleModel::rowCount(const QModelIndex &parent) const
 {
-    TreeItem *parentItem;
     if (parent.column() > 0)
         return 0;
 
     if (!parent.isValid())
-        parentItem = rootItem;
-    else
-        parentItem = static_cast<TreeItem*>(parent.internalPointer());
+        return static_cast<int>(m_rows.size());
+
+    NodeRef ref = unpackId(parent.internalId());
+    const LocaleNode& node = m_locales[ref.locale];
+    switch (ref.level) {
+        case Level::Locale:
+            return static_cast<int>(node.categoryRuleCount.size());
+        case Level::Category:
+            return static_cast<int>(node.categoryRuleCount[ref.position]);
+        case Level::Rule:
+            return 0;
+    }
+    return 0;
+}
 
-    return parentItem->childCount();
+QModelIndex RuleModel::ruleIndex(uint32_t locale, uint32_t position, int column) const
+{
+    const LocaleNode& node = m_locales[locale];
+    int row = static_cast<int>(position - node.categoryFirstRule[node.ruleCategory[position]]);
+    return createIndex(row, column, packId(Level::Rule, locale, position));
 }
 
 void RuleModel::onRuleMatched(const QString& ruleId)
 {
     if (ruleId.isEmpty()) return;
 
-    TreeItem* item = findRuleItem(ruleId, rootItem);
-    if (item) {
-        QModelIndex index = createIndex(item->row(), 4, item);
-        item->setData(4, item->data(4).toULongLong() + 1);
-        emit dataChanged(index, index, {HitsRole});
+    auto it = m_ruleIndex.constFind(ruleId);
+    if (it == m_ruleIndex.constEnd())
+        return;
+
+    auto [locale, position] = it.value();
+    uint8_t& dirty = m_locales[locale].ruleDirty[position];
+    if (dirty)
+        return;
+
+    dirty = 1;
+    m_dirtyRules.emplace_back(locale, position);
+    if (!m_flushTimer.isActive())
+        m_flushTimer.start();
+}
+
+void RuleModel::flushHits()
+{
+    // Rules are laid out grouped by category, so sorting by (locale,
+    // position) leaves each parent's dirty rows next to each other.
+    std::sort(m_dirtyRules.begin(), m_dirtyRules.end());
+
+    for (size_t first = 0; first < m_dirtyRules.size();) {
+        auto [locale, top] = m_dirtyRules[first];
+        LocaleNode& node = m_locales[locale];
+        uint32_t category = node.ruleCategory[top];
+
+        size_t last = first;
+        while (last + 1 < m_dirtyRules.size() && m_dirtyRules[last + 1].first == locale &&
+               node.ruleCategory[m_dirtyRules[last + 1].second] == category)
+            ++last;
+        for (size_t i = first; i <= last; ++i)
+            node.ruleDirty[m_dirtyRules[i].second] = 0;
+
+        emit dataChanged(ruleIndex(locale, top, 4), ruleIndex(locale, m_dirtyRules[last].second, 4), {HitsRole});
+        first = last + 1;
     }
+    m_dirtyRules.clear();
+
+    refreshInstrumentation();
 }
 
-TreeItem* RuleModel::findRuleItem(const QString& ruleId, TreeItem* parent)
+void RuleModel::reloadLocale(const QString& locale)
 {
-    for (int i = 0; i < parent->childCount(); ++i) {
-        TreeItem* child = parent->child(i);
-        if (child->data(0).toString() == ruleId) {
-            return child;
-        }
-        TreeItem* result = findRuleItem(ruleId, child);
-        if (result) {
-            return result;
-        }
+    std::shared_ptr<const deep_thonk::RulePack> pack = m_engine->getRulePack(locale.toStdString());
+    if (!pack) return;
+
+    // Pending repaints refer to positions that are about to change.
+    m_flushTimer.stop();
+    flushHits();
+
+    auto existing = std::find_if(m_locales.begin(), m_locales.end(), [&](const LocaleNode& node) { return node.name == locale; });
+    if (existing == m_locales.end()) {
+        if (m_locales.size() == kMaxLocales)
+            return;
+
+        // Locales are shown in name order, like the engine's map, whichever is
+        // compiled first; the new one takes the next slot.
+        size_t row = 0;
+        while (row < m_rows.size() && m_locales[m_rows[row]].name < locale)
+            ++row;
+
+        beginInsertRows(QModelIndex(), static_cast<int>(row), static_cast<int>(row));
+        uint32_t slot = static_cast<uint32_t>(m_locales.size());
+        LocaleNode& node = m_locales.emplace_back();
+        node.name = locale;
+        buildLocale(node, pack);
+        m_rows.insert(m_rows.begin() + static_cast<std::ptrdiff_t>(row), slot);
+        for (size_t r = row; r < m_rows.size(); ++r)
+            m_locales[m_rows[r]].row = static_cast<int>(r);
+        rebuildRuleIndex();
+        endInsertRows();
+        return;
+    }
+
+    // Swap the locale's children: its categories and rules may all have
+    // changed. The locale row, and every other locale, stays where it is.
+    LocaleNode& node = *existing;
+    QModelIndex parent = createIndex(node.row, 0, packId(Level::Locale, static_cast<uint32_t>(existing - m_locales.begin()), 0));
+    if (!node.categoryRuleCount.empty()) {
+        beginRemoveRows(parent, 0, static_cast<int>(node.categoryRuleCount.size()) - 1);
+        clearLocale(node);
+        rebuildRuleIndex();
+        endRemoveRows();
+    }
+
+    if (pack->categories.empty()) {
+        node.pack = pack;
+        return;
     }
-    return nullptr;
-}
-
-void RuleModel::setupModelData(const std::map<std::string, deep_thonk::RulePack>& rulePacks, TreeItem *parent)
-{
-    for(auto const& [locale, pack] : rulePacks)
-    {
-        TreeItem *localeItem = new TreeItem({QString::fromStdString(locale), QVariant(), QVariant(), QVariant(), QVariant()}, parent);
-        parent->appendChild(localeItem);
-
-        std::map<std::string, TreeItem*> categoryItems;
-
-        for(const auto& rule : pack.rules)
-        {
-            TreeItem* categoryItem;
-            if(categoryItems.find(rule.category) == categoryItems.end())
-            {
-                categoryItem = new TreeItem({QString::fromStdString(rule.category), QVariant(), QVariant(), QVariant(), QVariant()}, localeItem);
-                localeItem->appendChild(categoryItem);
-                categoryItems[rule.category] = categoryItem;
-            }
-            else
-            {
-                categoryItem = categoryItems[rule.category];
-            }
-
-            TreeItem *ruleItem = new TreeItem({
-                QString::fromStdString(rule.id),
-                QString::fromStdString(rule.category),
-                QString::fromStdString(rule.patternString),
-                QVariant(static_cast<qulonglong>(rule.outs.size())),
-                QVariant(static_cast<qulonglong>(rule.hits))
-            }, categoryItem);
-            categoryItem->appendChild(ruleItem);
+    beginInsertRows(parent, 0, static_cast<int>(pack->categories.size()) - 1);
+    buildLocale(node, pack);
+    rebuildRuleIndex();
+    endInsertRows();
+}
+
+void RuleModel::refreshInstrumentation()
+{
+    if (!deep_thonk::kInstrumentationEnabled)
+        return;
+
+    for (uint32_t locale = 0; locale < m_locales.size(); ++locale) {
+        // Read the counters of the pack on display, which may lag a reload.
+        LocaleNode& node = m_locales[locale];
+        deep_thonk::instrumentation::collect(*node.pack, node.stats);
+
+        for (uint32_t category = 0; category < node.categoryRuleCount.size(); ++category) {
+            if (node.categoryRuleCount[category] == 0)
+                continue;
+            uint32_t first = node.categoryFirstRule[category];
+            emit dataChanged(ruleIndex(locale, first, kFirstInstrumentationColumn),
+                             ruleIndex(locale, first + node.categoryRuleCount[category] - 1, kFirstInstrumentationColumn + 2),
+                             {EvaluationsRole, MissesRole, AvgEvalRole});
         }
     }
 }
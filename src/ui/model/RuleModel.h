@@ -2,12 +2,26 @@
 #define RULEMODEL_H
 
 #include <QAbstractItemModel>
+#include <QHash>
 #include <QModelIndex>
+#include <QStringList>
+#include <QTimer>
 #include <QVariant>
 #include "../../core/rogerian/Engine.h"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
 
-class TreeItem;
-
+// Locale -> category -> rule tree over the engine's rule packs.
+//
+// Nothing is copied out of the packs: each locale keeps its pack alive and
+// two flat arrays per level (struct-of-arrays) that describe the tree shape,
+// and data() reads names, patterns and live hit counts straight from the
+// pack. A QModelIndex carries (level, locale slot, position) in its
+// internal id, so there are no per-node allocations. A locale keeps its slot
+// for the model's lifetime whatever row it is shown at, and a reload only
+// replaces its children, so ids into other locales stay valid.
 class RuleModel : public QAbstractItemModel
 {
     Q_OBJECT
@@ -18,7 +32,10 @@ public:
         CategoryRole,
         PatternRole,
         TemplatesRole,
-        HitsRole
+        HitsRole,
+        EvaluationsRole,
+        MissesRole,
+        AvgEvalRole
     };
 
     explicit RuleModel(deep_thonk::Engine* engine, QObject *parent = nullptr);
@@ -34,14 +51,69 @@ public:
 
     QHash<int, QByteArray> roleNames() const override;
 
+    // Hit repaints are batched and flushed at most this often.
+    static constexpr int kHitFlushIntervalMs = 16;
+
 public slots:
+    // Marks the rule's Hits cell for the next flush. The count itself is
+    // read from the engine's counter when the view repaints.
     void onRuleMatched(const QString& ruleId);
+    // Rebuilds one locale's subtree from the engine's current pack, or adds
+    // it once a lazily loaded pack has been compiled.
+    void reloadLocale(const QString& locale);
+    // Pulls per-rule regex counts and cost from the engine's instrumentation
+    // into the Evals/Misses/Avg columns. No-op unless instrumentation is built in.
+    // Runs on every hit flush.
+    void refreshInstrumentation();
+
+private slots:
+    // One dataChanged per parent, spanning that parent's dirty rows.
+    void flushHits();
 
 private:
-    void setupModelData(const std::map<std::string, deep_thonk::RulePack>& rulePacks, TreeItem *parent);
-    TreeItem* findRuleItem(const QString& ruleId, TreeItem* parent);
+    enum class Level : quintptr { Locale = 1, Category = 2, Rule = 3 };
+
+    struct LocaleNode {
+        QString name;
+        int row = 0; // top-level row, kept in name order
+        std::shared_ptr<const deep_thonk::RulePack> pack;
+
+        // Indexed by the pack's category id.
+        std::vector<uint32_t> categoryFirstRule; // first position in the rule arrays
+        std::vector<uint32_t> categoryRuleCount;
+
+        // Rules grouped by category; a rule's row is its position minus
+        // its category's first position.
+        std::vector<uint32_t> rulePackIndex;
+        std::vector<uint32_t> ruleCategory;
+        std::vector<uint8_t> ruleDirty;
+
+        deep_thonk::LocaleStats stats; // last instrumentation snapshot
+    };
+
+    struct NodeRef {
+        Level level;
+        uint32_t locale; // slot in m_locales
+        uint32_t position; // category or rule position within the locale
+    };
+
+    static quintptr packId(Level level, uint32_t locale, uint32_t position);
+    static NodeRef unpackId(quintptr id);
+
+    void buildLocale(LocaleNode& node, const std::shared_ptr<const deep_thonk::RulePack>& pack) const;
+    void clearLocale(LocaleNode& node) const;
+    void rebuildRuleIndex();
+    QModelIndex ruleIndex(uint32_t locale, uint32_t position, int column) const;
 
-    TreeItem *rootItem;
+    QStringList m_headers;
+    // By slot, in the order locales were added; never shifted or reused.
+    std::vector<LocaleNode> m_locales;
+    std::vector<uint32_t> m_rows; // row -> slot
+    // Rule id -> (slot, position), so a hit does not walk the tree. When
+    // two locales share an id the one shown first wins.
+    QHash<QString, std::pair<uint32_t, uint32_t>> m_ruleIndex;
+    std::vector<std::pair<uint32_t, uint32_t>> m_dirtyRules;
+    QTimer m_flushTimer;
     deep_thonk::Engine* m_engine;
 };
 
@@ -1,29 +0,0 @@
-#ifndef TREEITEM_H
-#define TREEITEM_H
-
-#include <QVariant>
-#include <QList>
-
-class TreeItem
-{
-public:
-    explicit TreeItem(const QList<QVariant> &data, TreeItem *parentItem = nullptr);
-    ~TreeItem();
-
-    void appendChild(TreeItem *child);
-
-    TreeItem *child(int row);
-    int childCount() const;
-    int columnCount() const;
-    QVariant data(int column) const;
-    void setData(int column, const QVariant &value);
-    int row() const;
-    TreeItem *parentItem();
-
-private:
-    QList<TreeItem*> m_childItems;
-    QList<QVariant> m_itemData;
-    TreeItem *m_parentItem;
-};
-
-#endif // TREEITEM_H
@@ -19,9 +19,26 @@ ApplicationWindow {
     // Left: Chat
     ColumnLayout {
       Layout.fillHeight: true; Layout.preferredWidth: parent.width * 0.60; spacing: 8
-      TextArea {
-        id: chatLog; readOnly: true; wrapMode: TextEdit.WrapAnywhere
+      // Only the rows on screen exist; delegates are recycled while scrolling
+      ListView {
+        id: chatLog; clip: true; reuseItems: true
         Layout.fillWidth: true; Layout.fillHeight: true
+        model: bridge.chatModel
+        ScrollBar.vertical: ScrollBar {
+          onPressedChanged: if (!pressed) chatLog.following = chatLog.atYEnd
+        }
+
+        // Follow new messages unless the user has scrolled back
+        property bool following: true
+        onMovementEnded: following = atYEnd
+        onCountChanged: if (following) Qt.callLater(positionViewAtEnd)
+
+        delegate: Text {
+          width: ListView.view.width; wrapMode: Text.WrapAnywhere
+          text: "[" + model.timestamp.toLocaleTimeString() + "] " + (model.speaker === "user"
+                  ? qsTr("You") + ": " + model.text
+                  : qsTr("Therapist") + ": " + model.text + " (rule: " + model.ruleId + ")")
+        }
       }
       RowLayout {
         TextField {
@@ -29,6 +46,8 @@ ApplicationWindow {
           Layout.fillWidth: true
           onAccepted: send()
         }
+        // Rules for the selected locale are still compiling
+        BusyIndicator { running: !bridge.ready; visible: running; Layout.preferredHeight: prompt.height }
         Button { text: qsTr("Send"); onClicked: send() }
       }
     }
@@ -43,6 +62,9 @@ ApplicationWindow {
         Text { text: "Pattern"; Layout.preferredWidth: 120; font.bold: true }
         Text { text: "Templates"; Layout.preferredWidth: 70; font.bold: true; horizontalAlignment: Text.AlignHCenter }
         Text { text: "Hits"; Layout.preferredWidth: 50; font.bold: true; horizontalAlignment: Text.AlignHCenter }
+        Text { text: "Evals"; Layout.preferredWidth: 50; font.bold: true; horizontalAlignment: Text.AlignHCenter; visible: bridge.instrumentationEnabled }
+        Text { text: "Misses"; Layout.preferredWidth: 50; font.bold: true; horizontalAlignment: Text.AlignHCenter; visible: bridge.instrumentationEnabled }
+        Text { text: "Avg µs"; Layout.preferredWidth: 60; font.bold: true; horizontalAlignment: Text.AlignHCenter; visible: bridge.instrumentationEnabled }
       }
       TreeView {
         id: ruleTreeView
@@ -77,23 +99,31 @@ ApplicationWindow {
                 Layout.preferredWidth: 50
                 horizontalAlignment: Text.AlignHCenter
             }
+            Text {
+                text: model.evaluations
+                Layout.preferredWidth: 50
+                horizontalAlignment: Text.AlignHCenter
+                visible: bridge.instrumentationEnabled
+            }
+            Text {
+                text: model.misses
+                Layout.preferredWidth: 50
+                horizontalAlignment: Text.AlignHCenter
+                visible: bridge.instrumentationEnabled
+            }
+            Text {
+                text: model.avgEvalMicros
+                Layout.preferredWidth: 60
+                horizontalAlignment: Text.AlignHCenter
+                visible: bridge.instrumentationEnabled
+            }
         }
       }
     }
   }
 
-  Connections {
-    target: bridge
-    function onRogerianReply(reply, ruleId) {
-      const timestamp = new Date().toLocaleTimeString();
-      chatLog.text += `[${timestamp}] Therapist: ${reply} (rule: ${ruleId})\n`;
-    }
-  }
-
   function send() {
     if (!prompt.text.length) return
-    const time = new Date().toLocaleTimeString();
-    chatLog.append("[" + time + "] You: " + prompt.text + "\n")
     bridge.submitMessage(prompt.text)
     prompt.text = ""
   }
@@ -1,4 +1,5 @@
 #include <QTest>
+#include "test_bridge.h"
 #include "test_engine.h"
 
 int main(int argc, char *argv[])
@@ -11,5 +12,9 @@ int main(int argc, char *argv[])
         TestEngine testEngine;
         status |= QTest::qExec(&testEngine, argc, argv);
     }
+    {
+        TestBridge testBridge;
+        status |= QTest::qExec(&testBridge, argc, argv);
+    }
     return status;
 }
@@ -0,0 +1,257 @@
+#include "test_bridge.h"
+#include <QElapsedTimer>
+#include <QFile>
+#include <QPersistentModelIndex>
+#include <QSignalSpy>
+#include <QTemporaryDir>
+#include <QThread>
+#include <QTimer>
+#include "../src/ui/bridge/Bridge.h"
+#include "../src/ui/model/ChatModel.h"
+#include "../src/ui/model/RuleModel.h"
+#include <algorithm>
+
+namespace {
+
+// Long enough per message that a reply computed on the GUI thread, or a
+// cancelled one still delivered, cannot go unnoticed.
+constexpr int kSlowReplyMs = 250;
+
+// Distinct texts, so none is answered from the match cache.
+QString slowMessage(int i)
+{
+    return QString("I feel slow %1").arg(i);
+}
+
+std::string readResource(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return {};
+    return file.readAll().toStdString();
+}
+
+}
+
+void TestBridge::testLazyLocales()
+{
+    Bridge bridge;
+    QSignalSpy ready(&bridge, &Bridge::localeReady);
+
+    // Only the default locale is compiled, in the background.
+    QVERIFY(ready.wait(10000));
+    QCOMPARE(ready.at(0).at(0).toString(), QString("en-US"));
+    QVERIFY(bridge.property("ready").toBool());
+    QCOMPARE(bridge.ruleModel()->rowCount(), 1);
+
+    QSignalSpy readyChanged(&bridge, &Bridge::readyChanged);
+    bridge.setLocale("pt-BR");
+    QVERIFY(!bridge.property("ready").toBool());
+    QTRY_COMPARE_WITH_TIMEOUT(ready.count(), 2, 10000);
+    QCOMPARE(ready.at(1).at(0).toString(), QString("pt-BR"));
+    QVERIFY(bridge.property("ready").toBool());
+    QCOMPARE(readyChanged.count(), 2);
+
+    QCOMPARE(bridge.ruleModel()->rowCount(), 2);
+    QCOMPARE(bridge.ruleModel()->index(0, 0).data().toString(), QString("en-US"));
+    QCOMPARE(bridge.ruleModel()->index(1, 0).data().toString(), QString("pt-BR"));
+
+    // Messages sent right after a switch wait for the pack instead of failing.
+    QSignalSpy replies(&bridge, &Bridge::rogerianReply);
+    bridge.setLocale("en-US");
+    bridge.submitMessage("I feel lost");
+    QVERIFY(replies.wait(10000));
+    QVERIFY(!replies.at(0).at(1).toString().isEmpty());
+}
+
+void TestBridge::testRuleModelReload()
+{
+    deep_thonk::Engine engine;
+    engine.loadRulesFromString(readResource(":/resources/rules/pt-BR.json"));
+    RuleModel model(&engine);
+    QCOMPARE(model.rowCount(), 1);
+
+    QPersistentModelIndex ptLocale = model.index(0, 0);
+    QPersistentModelIndex ptCategory = model.index(0, 0, ptLocale);
+    QPersistentModelIndex ptRule = model.index(0, 0, ptCategory);
+    QString ptRuleId = ptRule.data().toString();
+    QVERIFY(!ptRuleId.isEmpty());
+
+    // A locale compiled later can land in front of one already shown.
+    engine.loadRulesFromString(readResource(":/resources/rules/en-US.json"));
+    model.reloadLocale("en-US");
+    QCOMPARE(model.rowCount(), 2);
+    QCOMPARE(model.index(0, 0).data().toString(), QString("en-US"));
+    QCOMPARE(ptLocale.row(), 1);
+    QVERIFY(ptRule.isValid());
+    QCOMPARE(ptRule.data().toString(), ptRuleId);
+    QCOMPARE(ptRule.parent().parent().data().toString(), QString("pt-BR"));
+
+    // Reloading one locale leaves indexes into the other untouched.
+    QPersistentModelIndex enRule = model.index(0, 0, model.index(0, 0, model.index(0, 0)));
+    QString enRuleId = enRule.data().toString();
+    engine.reloadRules(readResource(":/resources/rules/pt-BR.json"));
+    model.reloadLocale("pt-BR");
+    QVERIFY(!ptRule.isValid());
+    QVERIFY(ptLocale.isValid());
+    QCOMPARE(ptLocale.row(), 1);
+    QCOMPARE(model.rowCount(ptLocale), model.rowCount(model.index(1, 0)));
+    QVERIFY(model.rowCount(ptLocale) > 0);
+    QVERIFY(enRule.isValid());
+    QCOMPARE(enRule.data().toString(), enRuleId);
+    QCOMPARE(enRule.parent().parent().data().toString(), QString("en-US"));
+}
+
+void TestBridge::testRepliesDoNotBlockGuiThread()
+{
+    Bridge bridge;
+    bridge.setReplyDelayForTesting(kSlowReplyMs);
+
+    QThread* guiThread = QThread::currentThread();
+    bool repliedOnGuiThread = true;
+    QSignalSpy replies(&bridge, &Bridge::rogerianReply);
+    connect(&bridge, &Bridge::rogerianReply, this, [&] {
+        repliedOnGuiThread = repliedOnGuiThread && QThread::currentThread() == guiThread;
+    });
+
+    // The GUI thread must keep servicing its event loop while the worker matches.
+    QElapsedTimer sinceTick;
+    qint64 longestGap = 0;
+    QTimer ticker;
+    ticker.setInterval(5);
+    connect(&ticker, &QTimer::timeout, this, [&] {
+        longestGap = std::max(longestGap, sinceTick.restart());
+    });
+
+    constexpr int kMessages = 3;
+    QElapsedTimer submitting;
+    submitting.start();
+    for (int i = 0; i < kMessages; ++i)
+        bridge.submitMessage(slowMessage(i));
+    QVERIFY(submitting.elapsed() < 50);
+
+    // Nothing is answered inline: replies only arrive through the event loop.
+    QCOMPARE(replies.count(), 0);
+
+    QElapsedTimer waiting;
+    waiting.start();
+    sinceTick.start();
+    ticker.start();
+    QTRY_COMPARE_WITH_TIMEOUT(replies.count(), kMessages, 30000);
+    ticker.stop();
+    QVERIFY(waiting.elapsed() >= (kMessages - 1) * kSlowReplyMs);
+
+    QVERIFY(repliedOnGuiThread);
+    QVERIFY2(longestGap < 200, qPrintable(QString("GUI thread stalled for %1 ms").arg(longestGap)));
+}
+
+void TestBridge::testCancelPending()
+{
+    Bridge bridge;
+    bridge.setReplyDelayForTesting(kSlowReplyMs);
+
+    // The first message is on the worker by the time of the cancel; the
+    // rest are still queued.
+    QSignalSpy replies(&bridge, &Bridge::rogerianReply);
+    for (int i = 0; i < 8; ++i)
+        bridge.submitMessage(slowMessage(i));
+    QTest::qWait(kSlowReplyMs / 5);
+    bridge.cancelPending();
+
+    // Only the message sent after the cancel is answered, and it still gets through.
+    bridge.setReplyDelayForTesting(0);
+    bridge.submitMessage("hello");
+    QVERIFY(replies.wait(30000));
+    QTest::qWait(2 * kSlowReplyMs);
+    QCOMPARE(replies.count(), 1);
+    QCOMPARE(replies.at(0).at(1).toString(), QString("greeting.hello"));
+}
+
+void TestBridge::testChatHistory()
+{
+    Bridge bridge;
+    QAbstractItemModel* chat = bridge.chatModel();
+    QCOMPARE(chat->rowCount(), 0);
+
+    // The message is logged when submitted, the reply when it is delivered.
+    QSignalSpy replies(&bridge, &Bridge::rogerianReply);
+    bridge.submitMessage("I feel lost");
+    QCOMPARE(chat->rowCount(), 1);
+    QCOMPARE(chat->index(0, 0).data(ChatModel::SpeakerRole).toString(), QString("user"));
+    QCOMPARE(chat->index(0, 0).data(ChatModel::TextRole).toString(), QString("I feel lost"));
+    QVERIFY(chat->index(0, 0).data(ChatModel::RuleIdRole).toString().isEmpty());
+
+    QVERIFY(replies.wait(10000));
+    QCOMPARE(chat->rowCount(), 2);
+    QCOMPARE(chat->index(1, 0).data(ChatModel::SpeakerRole).toString(), QString("therapist"));
+    QCOMPARE(chat->index(1, 0).data(ChatModel::TextRole).toString(), replies.at(0).at(0).toString());
+    QCOMPARE(chat->index(1, 0).data(ChatModel::RuleIdRole).toString(), replies.at(0).at(1).toString());
+    QVERIFY(chat->index(1, 0).data(ChatModel::TimestampRole).toDateTime().isValid());
+
+    // Rows stay put across chunk boundaries, one insert per message.
+    ChatModel model;
+    QSignalSpy inserted(&model, &QAbstractItemModel::rowsInserted);
+    const int count = ChatModel::kChunkSize * 2 + 5;
+    for (int i = 0; i < count; ++i)
+        model.append(i % 2 ? ChatModel::Speaker::Therapist : ChatModel::Speaker::User, QString::number(i),
+                     i % 2 ? QString("rule.%1").arg(i % 3) : QString(), 1000 + i);
+    QCOMPARE(model.rowCount(), count);
+    QCOMPARE(inserted.count(), count);
+    for (int row : {0, ChatModel::kChunkSize - 1, ChatModel::kChunkSize, count - 1}) {
+        QModelIndex index = model.index(row, 0);
+        QCOMPARE(index.data(ChatModel::TextRole).toString(), QString::number(row));
+        QCOMPARE(index.data(ChatModel::RuleIdRole).toString(), row % 2 ? QString("rule.%1").arg(row % 3) : QString());
+        QCOMPARE(index.data(ChatModel::TimestampRole).toDateTime().toMSecsSinceEpoch(), qint64(1000 + row));
+    }
+
+    model.clear();
+    QCOMPARE(model.rowCount(), 0);
+    model.append(ChatModel::Speaker::User, "again");
+    QCOMPARE(model.index(0, 0).data(ChatModel::TextRole).toString(), QString("again"));
+}
+
+void TestBridge::testJournalRestore()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    QString journal = dir.filePath("session.dtjournal");
+
+    QStringList replies;
+    {
+        Bridge bridge(journal);
+        QSignalSpy spy(&bridge, &Bridge::rogerianReply);
+        bridge.submitMessage("I feel lost");
+        QVERIFY(spy.wait(10000));
+        bridge.submitMessage("hello");
+        QTRY_COMPARE_WITH_TIMEOUT(spy.count(), 2, 10000);
+        for (const auto& reply : spy)
+            replies << reply.at(0).toString();
+    }
+
+    // A new bridge shows the same conversation before anything is matched.
+    Bridge bridge(journal);
+    QAbstractItemModel* chat = bridge.chatModel();
+    QCOMPARE(chat->rowCount(), 4);
+    QCOMPARE(chat->index(0, 0).data(ChatModel::TextRole).toString(), QString("I feel lost"));
+    QCOMPARE(chat->index(1, 0).data(ChatModel::TextRole).toString(), replies.at(0));
+    QCOMPARE(chat->index(3, 0).data(ChatModel::TextRole).toString(), replies.at(1));
+
+    // Its hit counts are restored once the pack is compiled.
+    QSignalSpy ready(&bridge, &Bridge::localeReady);
+    QVERIFY(ready.wait(10000));
+    QAbstractItemModel* rules = bridge.ruleModel();
+    qulonglong hits = 0;
+    QModelIndex locale = rules->index(0, 0);
+    for (int category = 0; category < rules->rowCount(locale); ++category) {
+        QModelIndex categoryIndex = rules->index(category, 0, locale);
+        for (int rule = 0; rule < rules->rowCount(categoryIndex); ++rule)
+            hits += rules->index(rule, 0, categoryIndex).data(RuleModel::HitsRole).toULongLong();
+    }
+    QCOMPARE(hits, qulonglong(2));
+
+    QString exported = dir.filePath("chat.txt");
+    QVERIFY(bridge.exportChat(exported));
+    QFile text(exported);
+    QVERIFY(text.open(QIODevice::ReadOnly));
+    QVERIFY(text.readAll().contains("You: I feel lost"));
+}
@@ -0,0 +1,20 @@
+#ifndef TEST_BRIDGE_H
+#define TEST_BRIDGE_H
+
+#include <QObject>
+#include <QTest>
+
+class TestBridge : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void testLazyLocales();
+    void testRuleModelReload();
+    void testRepliesDoNotBlockGuiThread();
+    void testCancelPending();
+    void testChatHistory();
+    void testJournalRestore();
+};
+
+#endif // TEST_BRIDGE_H
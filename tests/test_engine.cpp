@@ -1,6 +1,62 @@
 #include "test_engine.h"
 #include <QFile>
+#include <QTemporaryDir>
 #include <QTextStream>
+#include "../src/core/rogerian/Journal.h"
+#include "../src/core/rogerian/Normalizer.h"
+#include "../src/core/rogerian/PackFile.h"
+#include "../src/core/rogerian/Regex.h"
+#include "../src/core/rogerian/RuleLoader.h"
+#include "../src/core/rogerian/Template.h"
+#include "../src/core/utils/BinaryIO.h"
+#include "../src/core/utils/WorkStealingPool.h"
+#include "../src/third_party/nlohmann/json.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <map>
+#include <regex>
+#include <set>
+#include <sstream>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+
+namespace {
+
+std::string readRuleFile(const QString& path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        return {};
+    QTextStream in(&file);
+    return in.readAll().toStdString();
+}
+
+// The matcher that shipped before the compiled index: try every rule's
+// pattern with std::regex, keep the longest.
+int referenceMatch(const deep_thonk::RulePack& pack, const std::string& text, std::smatch& bestMatch)
+{
+    const std::vector<deep_thonk::Rule>& rules = pack.rules;
+    std::vector<std::string> groupNames;
+    int best = -1;
+    for (size_t i = 0; i < rules.size(); ++i) {
+        std::regex pattern(deep_thonk::foldPattern(deep_thonk::stripGroupNames(pack.str(rules[i].patternString), groupNames)));
+        std::smatch currentMatch;
+        if (std::regex_search(text, currentMatch, pattern)) {
+            if (best < 0 || rules[i].rank > rules[best].rank ||
+                (rules[i].rank == rules[best].rank && rules[i].patternString.length > rules[best].patternString.length)) {
+                best = static_cast<int>(i);
+                bestMatch = currentMatch;
+            }
+        }
+    }
+    return best;
+}
+
+}
 
 void TestEngine::init()
 {
@@ -59,3 +115,923 @@ void TestEngine::testReflection()
 
     QVERIFY(QString::fromStdString(response).contains(expectedReflection, Qt::CaseInsensitive));
 }
+
+void TestEngine::testReflectionTable_data()
+{
+    QTest::addColumn<QString>("input");
+    QTest::addColumn<QString>("expectedReflection");
+
+    QTest::newRow("empty") << "" << "";
+    QTest::newRow("punctuation") << "i, am... me!" << "you, are... you!";
+    QTest::newRow("mixed case") << "My Mother and I" << "your Mother and you";
+    QTest::newRow("apostrophe is part of a word") << "i'm you're" << "i'm you're";
+    QTest::newRow("no partial words") << "mine isle amber" << "mine isle amber";
+    QTest::newRow("digits split words") << "me2you" << "you2i";
+    QTest::newRow("last pair wins") << "me" << "you";
+    QTest::newRow("curly apostrophe") << "I’m me" << "I’m you";
+    QTest::newRow("accents fold for lookup") << "Mé, Ïsle" << "you, Ïsle";
+}
+
+void TestEngine::testReflectionTable()
+{
+    QFETCH(QString, input);
+    QFETCH(QString, expectedReflection);
+
+    deep_thonk::ReflectionTable table;
+    table.build({{"i", "you"}, {"my", "your"}, {"me", "me"}, {"am", "are"}, {"you", "i"}, {"ME", "you"}});
+
+    std::string reflected = "kept:";
+    table.reflect(input.toStdString(), reflected);
+
+    QCOMPARE(QString::fromStdString(reflected), "kept:" + expectedReflection);
+}
+
+void TestEngine::testTemplates_data()
+{
+    QTest::addColumn<QString>("input");
+    QTest::addColumn<QString>("expectedResponse");
+
+    QTest::newRow("numbered slots") << "swap my keys for your notes" << "So your keys go and my notes come?";
+    QTest::newRow("named slots") << "i feel tired about my job" << "tired, because of your job. Go on about your job.";
+    QTest::newRow("missing group is empty") << "only one" << "[one][]";
+    QTest::newRow("unknown braces stay literal") << "braces" << "{0} {x} {} {10";
+}
+
+void TestEngine::testTemplates()
+{
+    QFETCH(QString, input);
+    QFETCH(QString, expectedResponse);
+
+    deep_thonk::Engine engine;
+    engine.loadRulesFromString(R"json({
+        "locale": "test",
+        "reflect": [["my", "your"], ["your", "my"], ["i", "you"]],
+        "rules": [
+            {"id": "swap", "category": "Test", "pattern": "swap (\\w+ \\w+) for (\\w+ \\w+)",
+             "outs": ["So {1} go and {2} come?"]},
+            {"id": "named", "category": "Test", "pattern": "i feel (?<feeling>\\w+) about (?<topic>.+)",
+             "outs": ["{feeling}, because of {topic}. Go on about {2}."]},
+            {"id": "missing", "category": "Test", "pattern": "only (\\w+)",
+             "outs": ["[{1}][{2}]"]},
+            {"id": "literal", "category": "Test", "pattern": "braces",
+             "outs": ["{0} {x} {} {10"]}
+        ]
+    })json");
+    engine.setLocale("test");
+
+    QCOMPARE(QString::fromStdString(engine.respond(input.toStdString()).text), expectedResponse);
+}
+
+void TestEngine::testNormalizer_data()
+{
+    QTest::addColumn<QString>("input");
+    QTest::addColumn<QString>("folded");
+    QTest::addColumn<QString>("words");
+
+    QTest::newRow("ascii") << "I AM me2you" << "i am me2you" << "I|AM|me|you";
+    QTest::newRow("accents") << "Você ESTÁ bem?" << "voce esta bem?" << "Você|ESTÁ|bem";
+    QTest::newRow("combining accent") << QString::fromUtf8("na\u0303o sei") << "nao sei" << QString::fromUtf8("na\u0303o|sei");
+    QTest::newRow("curly apostrophe") << "I don’t" << "i don't" << "I|don’t";
+    QTest::newRow("ligatures") << "Æon ß" << "aeon ss" << "Æon|ß";
+    QTest::newRow("cyrillic") << "Привет, мир" << "привет, мир" << "Привет|мир";
+    QTest::newRow("unicode spaces") << QString::fromUtf8("a\u00A0b\u2003c") << "a b c" << "a|b|c";
+    QTest::newRow("punctuation") << "“sim” — não…" << "“sim” — nao…" << "sim|não";
+}
+
+void TestEngine::testNormalizer()
+{
+    QFETCH(QString, input);
+    QFETCH(QString, folded);
+    QFETCH(QString, words);
+
+    std::string source = input.toStdString();
+    deep_thonk::NormalizedText text;
+    deep_thonk::normalize(source, text);
+
+    QCOMPARE(QString::fromStdString(text.text()), folded);
+    QStringList sourceWords;
+    for (const auto& word : text.words()) {
+        sourceWords << QString::fromStdString(std::string(text.sourceSlice(word.begin, word.end)));
+    }
+    QCOMPARE(sourceWords.join('|'), words);
+    QCOMPARE(QString::fromStdString(std::string(text.sourceSlice(0, text.text().size()))), input);
+}
+
+void TestEngine::testAccentedInput()
+{
+    deep_thonk::Engine engine;
+    engine.loadRulesFromString(readRuleFile(":/resources/rules/pt-BR.json"));
+    engine.loadRulesFromString(readRuleFile(":/resources/rules/en-US.json"));
+
+    // Accents and case fold away for matching; captures keep the user's spelling.
+    deep_thonk::Session pt = engine.createSession("pt-BR");
+    for (const char* input : {"Eu NÃO consigo dormir com o Avô", "eu nao consigo dormir com o Avô"}) {
+        deep_thonk::Response response = engine.respond(pt, input);
+        QCOMPARE(QString::fromStdString(response.ruleId), "agencia.naoconsigo");
+        QVERIFY2(QString::fromStdString(response.text).contains("dormir com o Avô"), response.text.c_str());
+    }
+
+    // The shipped pattern spells "don’t" with a curly apostrophe; a straight one matches too.
+    deep_thonk::Session en = engine.createSession("en-US");
+    QCOMPARE(QString::fromStdString(engine.respond(en, "I don't know my mother").ruleId), "agency.cannot");
+    QVERIFY(QString::fromStdString(engine.respond(en, "I don’t know my mother").text).contains("know your mother"));
+
+    // Reflection keys fold the same way as the input.
+    deep_thonk::ReflectionTable table;
+    table.build({{"eu", "você"}, {"você", "eu"}});
+    QCOMPARE(QString::fromStdString(std::string(table.lookup("VOCE"))), "eu");
+    std::string reflected;
+    table.reflect("Você e EU", reflected);
+    QCOMPARE(QString::fromStdString(reflected), "eu e você");
+
+    // A class member that folds to two letters matches those two letters, not either one.
+    QCOMPARE(QString::fromStdString(deep_thonk::foldPattern("^[æs]+$")), "^(?:ae|[s])+$");
+    deep_thonk::Engine ligatures;
+    ligatures.loadRulesFromString(R"json({"locale": "test",
+        "rules": [{"id": "lig", "category": "Test", "pattern": "^gr[æß]t$", "outs": ["ok"]}]})json");
+    deep_thonk::Session session = ligatures.createSession("test");
+    for (const char* input : {"GRÆT", "graet", "grsst"}) {
+        QCOMPARE(QString::fromStdString(ligatures.respond(session, input).ruleId), "lig");
+    }
+    for (const char* input : {"grat", "gret", "grst"}) {
+        QVERIFY(ligatures.respond(session, input).ruleId.empty());
+    }
+    // Negated classes and ranges cannot say that, so they are refused.
+    QVERIFY_THROWS_EXCEPTION(std::runtime_error, deep_thonk::Engine().loadRulesFromString(R"json({"locale": "test",
+        "rules": [{"id": "neg", "category": "Test", "pattern": "[^ß]", "outs": ["ok"]}]})json"));
+    QVERIFY_THROWS_EXCEPTION(std::runtime_error, deep_thonk::Engine().loadRulesFromString(R"json({"locale": "test",
+        "rules": [{"id": "range", "category": "Test", "pattern": "[a-æ]", "outs": ["ok"]}]})json"));
+}
+
+void TestEngine::testMatcherGolden_data()
+{
+    QTest::addColumn<QString>("locale");
+
+    QTest::newRow("en-US") << "en-US";
+    QTest::newRow("pt-BR") << "pt-BR";
+}
+
+void TestEngine::testMatcherGolden()
+{
+    QFETCH(QString, locale);
+
+    deep_thonk::Engine engine;
+    engine.loadRulesFromString(readRuleFile(":/resources/rules/" + locale + ".json"));
+    const deep_thonk::RulePack& pack = *engine.getRulePacks().at(locale.toStdString());
+
+    std::vector<std::string> corpus = {
+        "", " ", "?", "Hello", "hello there", "HI", "hey you", "Hit me", "they said hi",
+        "I feel", "i feel sad", "I am feeling lost today", "I  feel   tired",
+        "I can't sleep", "I cannot focus", "I don’t know", "I do not care",
+        "I think you are my friend", "i think", "I think", "I am happy", "You are not happy",
+        "Please reflect: i am happy", "please REFLECT: you are my friend",
+        "eu sinto medo", "Eu sinto que estou sozinho", "tenho sentido raiva",
+        "eu nao consigo dormir", "Eu não consigo parar", "EU NÃO CONSIGO", "você está bem?",
+        "my mother thinks I am crazy", "nothing matches this one", "123 456", "don't",
+    };
+    // Long inputs put literals past, and across, the 16/32-byte chunks the
+    // prefilter skips over.
+    for (size_t pad : {13, 15, 16, 29, 31, 32, 47, 64}) {
+        std::string filler(pad, '.');
+        for (const char* tail : {"I THINK so", "well hEy", "eu NÃO consigo ir", "please reflect: ok", "zzz"}) {
+            corpus.push_back(filler + tail);
+            corpus.push_back(filler + tail + filler);
+        }
+    }
+    for (const auto& rule : pack.rules) {
+        corpus.emplace_back(pack.str(rule.id));
+        corpus.emplace_back(pack.str(rule.patternString));
+        for (const auto& out : pack.outs(rule)) {
+            corpus.emplace_back(pack.str(out.text));
+        }
+    }
+    for (const auto& [from, to] : pack.reflectPairs) {
+        corpus.push_back(std::string(pack.str(from)) + " " + std::string(pack.str(to)));
+    }
+
+    deep_thonk::NormalizedText input;
+    for (const auto& source : corpus) {
+        deep_thonk::normalize(source, input);
+        const std::string& text = input.text();
+        std::smatch expected;
+        deep_thonk::MatchResult actual;
+        int expectedIndex = referenceMatch(pack, text, expected);
+        int actualIndex = pack.matcher.findBest(pack.rules, text, actual);
+
+        QVERIFY2(expectedIndex == actualIndex, text.c_str());
+        if (expectedIndex < 0)
+            continue;
+        QCOMPARE(actual.captures.size(), expected.size());
+        for (size_t group = 0; group < expected.size(); ++group) {
+            const deep_thonk::CaptureSpan& span = actual.captures[group];
+            QCOMPARE(span.matched(), expected[group].matched);
+            if (span.matched()) {
+                QCOMPARE(qsizetype(span.begin), qsizetype(expected.position(group)));
+                QCOMPARE(QString::fromStdString(text.substr(span.begin, span.length())), QString::fromStdString(expected[group].str()));
+            }
+        }
+    }
+}
+
+void TestEngine::testLinearMatching()
+{
+    // Same matches and captures as std::regex on the subset.
+    const std::pair<const char*, const char*> cases[] = {
+        {"a(b*?)(b+)", "xabbb"}, {"\\bcat\\b", "concat a cat."}, {"\\bcat\\b", "concat"},
+        {"^(?:i|we) (\\w+)(?: (.*))?$", "we need help now"}, {"(\\d{2,3})-(\\d+)?x", "1-x 12-x 1234-5x"},
+        {"[^a-c\\s]+", "abc dEf"}, {"(a|ab)(c|bcd)(d*)", "abcd"}, {"x*", "yyy"}, {"\\.\\x41", "-.A"},
+    };
+    for (auto [pattern, source] : cases) {
+        const std::string text(source);
+        deep_thonk::Regex regex;
+        QVERIFY2(regex.compile(pattern), pattern);
+        std::vector<deep_thonk::CaptureSpan> captures;
+        std::smatch expected;
+        bool found = regex.search(text, captures);
+        QCOMPARE(found, std::regex_search(text, expected, std::regex(pattern)));
+        if (!found)
+            continue;
+        QCOMPARE(captures.size(), expected.size());
+        for (size_t group = 0; group < expected.size(); ++group) {
+            QCOMPARE(captures[group].matched(), expected[group].matched);
+            if (captures[group].matched()) {
+                QCOMPARE(qsizetype(captures[group].begin), qsizetype(expected.position(group)));
+                QCOMPARE(qsizetype(captures[group].length()), qsizetype(expected.length(group)));
+            }
+        }
+    }
+
+    // \u escapes stand for the character's UTF-8 bytes.
+    deep_thonk::Regex regex;
+    std::vector<deep_thonk::CaptureSpan> captures;
+    QVERIFY(regex.compile("caf\\u00e9"));
+    QVERIFY(regex.search("un café", captures));
+    QCOMPARE(captures[0].begin, 3u);
+    QCOMPARE(captures[0].length(), 5u);
+
+    // Syntax without a linear-time match is rejected with a reason.
+    std::string error;
+    QVERIFY(!regex.compile("(\\w+) \\1", &error));
+    QVERIFY(error.find("back-reference") != std::string::npos);
+    for (const char* pattern : {"a(?=b)", "(?<!a)b", "a{1001}", "[[:alpha:]]", "(a", "a)", "*a", "\\q"})
+        QVERIFY2(!regex.compile(pattern), pattern);
+    QVERIFY_THROWS_EXCEPTION(std::runtime_error, deep_thonk::Engine().loadRulesFromString(R"json({"locale": "test",
+        "rules": [{"id": "echo", "category": "Test", "pattern": "(\\w+) \\1", "outs": ["x"]}]})json"));
+
+    // Patterns that backtrack exponentially stay within the step bound.
+    const std::string paste(20000, 'a');
+    for (const char* pattern : {"(a+)+b", "(a|aa)*c", "(.*)(.*)(.*)x", "(\\w+\\s?)*!"}) {
+        QVERIFY(regex.compile(pattern));
+        uint64_t budget = deep_thonk::Matcher::kUnlimitedSteps;
+        QVERIFY(regex.search(paste, captures, budget) == deep_thonk::Regex::Outcome::NoMatch);
+        QVERIFY(deep_thonk::Matcher::kUnlimitedSteps - budget <= regex.stepBound(paste.size()));
+    }
+
+    // A message over the engine's budget gets the neutral probe; the result
+    // is not cached, so a larger budget answers it properly.
+    deep_thonk::Engine engine;
+    engine.loadRulesFromString(R"json({"locale": "test", "rules": [
+        {"id": "probe", "category": "General", "pattern": "^$", "outs": ["Go on."]},
+        {"id": "feel", "category": "Test", "pattern": "i feel (.+) about (.+)", "outs": ["Why {1}?"]}]})json");
+    engine.setMatchBudget(5000);
+    deep_thonk::Session session = engine.createSession("test", 1);
+    QCOMPARE(QString::fromStdString(engine.respond(session, "i feel good about it").text), QString("Why good?"));
+    const std::string longPaste = "i feel " + std::string(5000, 'x') + " about it";
+    QCOMPARE(QString::fromStdString(engine.respond(session, longPaste).text), QString("Go on."));
+    QCOMPARE(engine.instrumentationSnapshot().matchBudgetExhausted, uint64_t(1));
+    engine.setMatchBudget(deep_thonk::Engine::kDefaultMatchBudget);
+    QCOMPARE(QString::fromStdString(engine.respond(session, longPaste).ruleId), QString("feel"));
+}
+
+void TestEngine::testPackFile()
+{
+    std::string json = readRuleFile(":/resources/rules/en-US.json");
+    deep_thonk::Engine compiled;
+    compiled.loadRulesFromString(json);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    std::string path = dir.filePath("en-US.dtpack").toStdString();
+    std::string blob = deep_thonk::writePackFile("en-US", *compiled.getRulePacks().at("en-US"), deep_thonk::hashRuleSource(json));
+    std::ofstream(path, std::ios::binary).write(blob.data(), blob.size());
+
+    deep_thonk::Engine loaded;
+    QVERIFY(loaded.loadRulesFromBinary(path, json));
+
+    deep_thonk::Session expected = compiled.createSession("en-US");
+    deep_thonk::Session actual = loaded.createSession("en-US");
+    for (const char* input : {"Hello", "I feel lost", "I don’t know", "I think you are my friend", "Please reflect: my day", "zzz"}) {
+        expected.rng.seed(7);
+        actual.rng.seed(7);
+        deep_thonk::Response a = compiled.respond(expected, input);
+        deep_thonk::Response b = loaded.respond(actual, input);
+        QVERIFY2(a.text == b.text && a.ruleId == b.ruleId, input);
+    }
+
+    // A blob built from different JSON is stale; the engine compiles the JSON instead.
+    deep_thonk::Engine stale;
+    QVERIFY(!stale.loadRulesFromBinary(path, json + "\n"));
+    QCOMPARE(stale.getRulePacks().count("en-US"), size_t(1));
+
+    // Tables that pass the checksum are still range-checked: point every
+    // root edge of the matcher past its node table. The blob ends with the
+    // root edges, the rule filter flags and the rule order.
+    std::string tampered = blob;
+    size_t ruleCount = compiled.getRulePacks().at("en-US")->rules.size();
+    size_t rootNext = tampered.size() - (4 + 4 * ruleCount) - (4 + ((ruleCount + 3) & ~size_t(3))) - 256 * 4;
+    for (size_t i = 0; i < 256; ++i) {
+        uint32_t target = 0x7fffffff;
+        std::memcpy(&tampered[rootNext + 4 * i], &target, sizeof(target));
+    }
+    uint64_t checksum = deep_thonk::fnv1a64(tampered.data() + sizeof(deep_thonk::PackFileHeader),
+                                            tampered.size() - sizeof(deep_thonk::PackFileHeader));
+    std::memcpy(&tampered[offsetof(deep_thonk::PackFileHeader, checksum)], &checksum, sizeof(checksum));
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(tampered.data(), tampered.size());
+    deep_thonk::Engine unchecked;
+    QVERIFY(!unchecked.loadRulesFromBinary(path, json));
+    deep_thonk::Session session = unchecked.createSession("en-US");
+    QCOMPARE(QString::fromStdString(unchecked.respond(session, "Hello").ruleId), QString("greeting.hello"));
+
+    // Corruption is caught by the checksum.
+    blob[blob.size() / 2] ^= 0x5a;
+    std::ofstream(path, std::ios::binary | std::ios::trunc).write(blob.data(), blob.size());
+    deep_thonk::Engine corrupt;
+    QVERIFY(!corrupt.loadRulesFromBinary(path, json));
+}
+
+void TestEngine::testRuleLoader()
+{
+    // The streaming loader must build the same pack from a stream as from memory.
+    std::string json = readRuleFile(":/resources/rules/pt-BR.json");
+    deep_thonk::RulePack fromString;
+    deep_thonk::RulePack fromStream;
+    std::istringstream input(json);
+    QCOMPARE(deep_thonk::parseRulePack(json, fromString), std::string("pt-BR"));
+    QCOMPARE(deep_thonk::parseRulePack(input, fromStream, json.size()), std::string("pt-BR"));
+    QCOMPARE(fromStream.rules.size(), fromString.rules.size());
+    QVERIFY(fromStream.strings == fromString.strings);
+    for (size_t i = 0; i < fromString.rules.size(); ++i) {
+        QVERIFY(fromStream.str(fromStream.rules[i].id) == fromString.str(fromString.rules[i].id));
+        QCOMPARE(fromStream.rules[i].templateCount, fromString.rules[i].templateCount);
+    }
+
+    // Categories are interned: one id and one pooled string per distinct name.
+    std::set<std::string_view> categories;
+    for (const auto& rule : fromString.rules)
+        categories.insert(fromString.category(rule));
+    QCOMPARE(fromString.categories.size(), categories.size());
+    for (const auto& rule : fromString.rules)
+        QVERIFY(fromString.str(fromString.categories[rule.category]) == fromString.category(rule));
+
+    // Unknown keys, including nested ones, are skipped.
+    deep_thonk::RulePack pack;
+    QCOMPARE(deep_thonk::parseRulePack(R"json({
+        "version": 3, "meta": {"rules": [{"id": "ignored"}]},
+        "locale": "en-US", "reflect": [["i", "you"]],
+        "rules": [{"id": "a", "category": "General", "weight": 2, "tags": ["x", {"y": 1}],
+                   "pattern": "(.*)", "outs": ["{1}?"]}]
+    })json", pack), std::string("en-US"));
+    QCOMPARE(pack.rules.size(), size_t(1));
+    QVERIFY(pack.str(pack.rules[0].id) == "a");
+    QCOMPARE(pack.neutralRule, uint32_t(0));
+
+    QVERIFY_THROWS_EXCEPTION(std::runtime_error, deep_thonk::parseRulePack(R"json({"locale": "en-US",
+        "rules": [{"id": "a", "category": "General", "outs": []}]})json", pack));
+    QVERIFY_THROWS_EXCEPTION(std::runtime_error, deep_thonk::parseRulePack(R"json({"locale": "en-US",
+        "rules": [{"id": 1, "category": "General", "pattern": "x", "outs": []}]})json", pack));
+    QVERIFY_THROWS_EXCEPTION(std::runtime_error, deep_thonk::parseRulePack(R"json({"rules": []})json", pack));
+    QVERIFY_THROWS_EXCEPTION(std::runtime_error, deep_thonk::parseRulePack(R"json({"locale": "en-US", "rules": [)json", pack));
+}
+
+void TestEngine::testConcurrentSessions()
+{
+    deep_thonk::Engine engine;
+    engine.loadRulesFromString(readRuleFile(":/resources/rules/en-US.json"));
+    engine.loadRulesFromString(readRuleFile(":/resources/rules/pt-BR.json"));
+
+    const std::vector<std::string> locales = {"en-US", "pt-BR"};
+    const std::vector<std::string> inputs = {
+        "Hello", "I feel lost", "I can't sleep", "I think you are my friend", "Please reflect: i am me",
+        "eu sinto medo", "eu não consigo dormir", "anything else",
+    };
+
+    // What each locale answers single-threaded; every call below must agree.
+    std::map<std::string, std::vector<std::string>> expectedRules;
+    uint64_t expectedHits = 0;
+    for (const auto& locale : locales) {
+        deep_thonk::Session session = engine.createSession(locale);
+        for (const auto& input : inputs) {
+            expectedRules[locale].push_back(engine.respond(session, input).ruleId);
+            ++expectedHits;
+        }
+    }
+
+    constexpr int threadCount = 8;
+    constexpr int rounds = 250;
+    std::atomic<int> mismatches{0};
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t) {
+        threads.emplace_back([&, t]() {
+            const std::string& locale = locales[t % locales.size()];
+            deep_thonk::Session session = engine.createSession(locale);
+            for (int round = 0; round < rounds; ++round) {
+                for (size_t i = 0; i < inputs.size(); ++i) {
+                    deep_thonk::Response response = engine.respond(session, inputs[i]);
+                    if (response.ruleId != expectedRules[locale][i] || response.text.empty())
+                        mismatches.fetch_add(1, std::memory_order_relaxed);
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    expectedHits += static_cast<uint64_t>(threadCount) * rounds * inputs.size();
+
+    uint64_t hits = 0;
+    for (const auto& [locale, pack] : engine.getRulePacks()) {
+        for (const auto& rule : pack->rules)
+            hits += rule.hits.load();
+    }
+
+    QCOMPARE(mismatches.load(), 0);
+    QCOMPARE(hits, expectedHits);
+}
+
+void TestEngine::testRespondBatch()
+{
+    std::vector<std::string> messages;
+    const std::vector<std::string> inputs = {
+        "Hello", "I feel lost", "I can't sleep", "I think you are my friend", "anything else", "",
+    };
+    for (int i = 0; i < 2000; ++i)
+        messages.push_back(inputs[i % inputs.size()]);
+
+    deep_thonk::BatchOptions options;
+    options.locale = "en-US";
+    options.seed = 42;
+
+    deep_thonk::WorkStealingPool single(1);
+    deep_thonk::WorkStealingPool many(4);
+    std::vector<deep_thonk::Response> sequential = m_engine.respondBatch(messages, single, options);
+    std::vector<deep_thonk::Response> parallel = m_engine.respondBatch(messages, many, options);
+    std::vector<deep_thonk::Response> again = m_engine.respondBatch(messages, many, options);
+
+    QCOMPARE(parallel.size(), messages.size());
+    deep_thonk::Session session = m_engine.createSession("en-US");
+    for (size_t i = 0; i < messages.size(); ++i) {
+        QVERIFY(parallel[i].text == sequential[i].text);
+        QVERIFY(parallel[i].text == again[i].text);
+        QVERIFY(parallel[i].ruleId == m_engine.respond(session, messages[i]).ruleId);
+    }
+}
+
+void TestEngine::testTemplateSelection()
+{
+    // Reference output of PCG32 for seed 42, stream 54.
+    deep_thonk::Pcg32 reference(42, 54);
+    for (uint32_t expected : {0xa15c02b7u, 0x7b47f409u, 0xba1d3330u, 0x83d2f293u, 0xbfa4784bu, 0xcbed606eu})
+        QCOMPARE(reference(), expected);
+
+    const std::string json = R"json({
+        "locale": "test",
+        "rules": [
+            {"id": "weighted", "category": "Test", "pattern": "weighted", "outs": ["a", "b", "c"], "weights": [1, 0, 3]},
+            {"id": "fresh", "category": "Test", "pattern": "fresh", "outs": ["x", "y", "z"], "noRepeat": true},
+            {"id": "plain", "category": "Test", "pattern": "plain", "outs": ["1", "2", "3", "4"]}
+        ]
+    })json";
+    deep_thonk::Engine engine;
+    engine.loadRulesFromString(json);
+
+    deep_thonk::Session session = engine.createSession("test", 5);
+    std::map<std::string, int> counts;
+    for (int i = 0; i < 4000; ++i)
+        ++counts[engine.respond(session, "weighted").text];
+    QCOMPARE(counts.count("b"), size_t(0));
+    QVERIFY(counts["c"] > 2 * counts["a"]);
+
+    std::string previous;
+    for (int i = 0; i < 1000; ++i) {
+        std::string text = engine.respond(session, "fresh").text;
+        QVERIFY(text != previous);
+        previous = text;
+    }
+
+    // Equal seeds give equal conversations; a recorded one replays on any seed.
+    deep_thonk::Session recorded = engine.createSession("test", 77);
+    deep_thonk::Session twin = engine.createSession("test", 77);
+    recorded.log.mode = deep_thonk::ChoiceLog::Mode::Record;
+    std::vector<std::string> transcript;
+    for (int i = 0; i < 60; ++i) {
+        const char* input = i % 3 == 0 ? "weighted" : i % 3 == 1 ? "fresh" : "plain";
+        transcript.push_back(engine.respond(recorded, input).text);
+        QVERIFY(engine.respond(twin, input).text == transcript.back());
+    }
+    QCOMPARE(recorded.log.choices.size(), transcript.size());
+
+    deep_thonk::Session replay = engine.createSession("test", 1234);
+    replay.log = recorded.log;
+    replay.log.mode = deep_thonk::ChoiceLog::Mode::Replay;
+    for (int i = 0; i < 60; ++i) {
+        const char* input = i % 3 == 0 ? "weighted" : i % 3 == 1 ? "fresh" : "plain";
+        QVERIFY(engine.respond(replay, input).text == transcript[i]);
+    }
+
+    // Policies survive a precompiled pack.
+    const deep_thonk::RulePack& pack = *engine.getRulePack("test");
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    std::string path = dir.filePath("test.dtpack").toStdString();
+    std::string blob = deep_thonk::writePackFile("test", pack, deep_thonk::hashRuleSource(json));
+    std::ofstream(path, std::ios::binary).write(blob.data(), blob.size());
+    deep_thonk::Engine loaded;
+    QVERIFY(loaded.loadRulesFromBinary(path, json));
+    deep_thonk::Session a = engine.createSession("test", 9);
+    deep_thonk::Session b = loaded.createSession("test", 9);
+    for (int i = 0; i < 100; ++i) {
+        const char* input = i % 2 ? "weighted" : "fresh";
+        QVERIFY(loaded.respond(b, input).text == engine.respond(a, input).text);
+    }
+
+    // Weights must line up with the outs.
+    QVERIFY_THROWS_EXCEPTION(std::runtime_error, deep_thonk::Engine().loadRulesFromString(R"json({"locale": "test",
+        "rules": [{"id": "w", "category": "Test", "pattern": "w", "outs": ["a", "b"], "weights": [1]}]})json"));
+    QVERIFY_THROWS_EXCEPTION(std::runtime_error, deep_thonk::Engine().loadRulesFromString(R"json({"locale": "test",
+        "rules": [{"id": "w", "category": "Test", "pattern": "w", "outs": ["a"], "weights": [0]}]})json"));
+}
+
+void TestEngine::testConversationMemory()
+{
+    const std::string json = R"json({
+        "locale": "test",
+        "reflect": [["my", "your"], ["i", "you"]],
+        "rules": [
+            {"id": "probe", "category": "General", "pattern": "^$", "outs": ["Go on."]},
+            {"id": "family", "category": "Family", "pattern": "my (mother|father)", "rank": 5,
+             "outs": ["Tell me about your family."], "memory": ["Earlier you mentioned your {1}."]},
+            {"id": "long", "category": "Test", "pattern": "my (.+) is a very long pattern",
+             "outs": ["Your {1}?"], "memory": ["Does that have to do with the fact that your {1}?"]},
+            {"id": "feel", "category": "Test", "pattern": "i feel (.+)", "outs": ["Why {1}?"]}
+        ]
+    })json";
+    deep_thonk::Engine engine;
+    engine.loadRulesFromString(json);
+    deep_thonk::Session session = engine.createSession("test", 3);
+
+    // A higher rank beats a longer pattern.
+    QCOMPARE(QString::fromStdString(engine.respond(session, "my mother is a very long pattern").ruleId), QString("family"));
+    QCOMPARE(QString::fromStdString(engine.respond(session, "my CAT is a very long pattern").ruleId), QString("long"));
+    QCOMPARE(QString::fromStdString(engine.respond(session, "i feel fine").ruleId), QString("feel"));
+    QCOMPARE(session.memory.size(), size_t(3));
+
+    // With nothing matching, pending turns answer oldest first, then the probe.
+    deep_thonk::Response first = engine.respond(session, "hmm");
+    QCOMPARE(QString::fromStdString(first.text), QString("Earlier you mentioned your mother."));
+    QCOMPARE(QString::fromStdString(first.ruleId), QString("family"));
+    QCOMPARE(QString::fromStdString(engine.respond(session, "hmm").text),
+             QString("Does that have to do with the fact that your CAT?"));
+    QCOMPARE(QString::fromStdString(engine.respond(session, "hmm").text), QString("Go on."));
+
+    // The ring keeps the latest turns only and never grows.
+    for (int i = 0; i < 20; ++i)
+        engine.respond(session, "my father");
+    QCOMPARE(session.memory.size(), deep_thonk::ConversationMemory::kTurns);
+    uint64_t serial = engine.getRulePack("test")->serial;
+    size_t pending = 0;
+    while (session.memory.takePending(serial))
+        ++pending;
+    QCOMPARE(pending, deep_thonk::ConversationMemory::kTurns);
+    static_assert(std::is_trivially_copyable_v<deep_thonk::ConversationMemory>);
+
+    // Long captures are cut at a character boundary.
+    std::string accents = "i feel ";
+    for (int i = 0; i < 100; ++i)
+        accents += "\u00e9";
+    engine.respond(session, accents);
+    QCOMPARE(session.memory.recent(0).captureText().size(), deep_thonk::ConversationMemory::kCaptureBytes);
+
+    // Turns kept under a pack are not answered from the one that replaces it.
+    engine.respond(session, "my mother");
+    engine.reloadRules(R"json({"locale": "test", "rules": [
+        {"id": "probe", "category": "General", "pattern": "^$", "outs": ["Go on."]}]})json");
+    QCOMPARE(QString::fromStdString(engine.respond(session, "hmm").ruleId), QString("probe"));
+
+    // Memory outs may only use one capture group, and ranks are whole numbers.
+    QVERIFY_THROWS_EXCEPTION(std::runtime_error, deep_thonk::Engine().loadRulesFromString(R"json({"locale": "test",
+        "rules": [{"id": "m", "category": "Test", "pattern": "(a)(b)", "outs": ["x"], "memory": ["{1}", "{2}"]}]})json"));
+    QVERIFY_THROWS_EXCEPTION(std::runtime_error, deep_thonk::Engine().loadRulesFromString(R"json({"locale": "test",
+        "rules": [{"id": "r", "category": "Test", "pattern": "r", "rank": 1.5, "outs": ["x"]}]})json"));
+}
+
+void TestEngine::testJournal()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    std::string path = dir.filePath("session.dtjournal").toStdString();
+
+    deep_thonk::Session session = m_engine.createSession("en-US", 11);
+    constexpr int kThreads = 4;
+    constexpr int kExchanges = 500;
+    {
+        deep_thonk::JournalWriter writer;
+        QVERIFY(writer.open(path));
+        deep_thonk::JournalRecord start;
+        start.type = deep_thonk::JournalRecord::Type::Start;
+        start.seed = 11;
+        start.locale = "en-US";
+        writer.append(start);
+
+        // Appends from several threads share a handful of fsyncs.
+        std::vector<std::thread> threads;
+        for (int t = 0; t < kThreads; ++t) {
+            threads.emplace_back([&writer, t] {
+                for (int i = 0; i < kExchanges; ++i) {
+                    std::string input = "message " + std::to_string(t) + "/" + std::to_string(i);
+                    deep_thonk::JournalRecord exchange;
+                    exchange.timestampMs = 1000 + i;
+                    exchange.templateIndex = static_cast<uint32_t>(t);
+                    exchange.input = input;
+                    exchange.ruleId = "rule.test";
+                    exchange.reply = "Tell me \"more\".";
+                    writer.append(exchange);
+                }
+            });
+        }
+        for (auto& thread : threads)
+            thread.join();
+        QVERIFY(writer.flush());
+        QVERIFY(writer.syncCount() < uint64_t(kThreads * kExchanges));
+    }
+
+    deep_thonk::JournalReader reader;
+    QVERIFY(reader.open(path));
+    deep_thonk::JournalRecord record;
+    QVERIFY(reader.next(record));
+    QVERIFY(record.type == deep_thonk::JournalRecord::Type::Start);
+    QCOMPARE(record.seed, uint64_t(11));
+    QVERIFY(record.locale == "en-US");
+    std::map<std::string, int> perThread;
+    while (reader.next(record)) {
+        QVERIFY(record.type == deep_thonk::JournalRecord::Type::Exchange);
+        QVERIFY(record.reply == "Tell me \"more\".");
+        ++perThread[std::string(record.input.substr(0, record.input.find('/')))];
+    }
+    QVERIFY(!reader.truncated());
+    QCOMPARE(perThread.size(), size_t(kThreads));
+    for (const auto& [prefix, count] : perThread)
+        QCOMPARE(count, kExchanges);
+    size_t validSize = reader.validSize();
+    reader.close();
+
+    // A torn last record is skipped by readers and cut off by the next writer.
+    {
+        std::ofstream torn(path, std::ios::binary | std::ios::app);
+        torn.write("\x40\0\0\0\x12\x34", 6);
+    }
+    QVERIFY(reader.open(path));
+    int records = 0;
+    while (reader.next(record))
+        ++records;
+    QVERIFY(reader.truncated());
+    QCOMPARE(records, 1 + kThreads * kExchanges);
+    reader.close();
+    {
+        deep_thonk::JournalWriter writer;
+        QVERIFY(writer.open(path));
+        QCOMPARE(std::filesystem::file_size(path), uintmax_t(validSize));
+        deep_thonk::Response response = m_engine.respond(session, "I feel lost");
+        deep_thonk::JournalRecord exchange;
+        exchange.templateIndex = response.templateIndex;
+        exchange.input = "I feel lost";
+        exchange.ruleId = response.ruleId;
+        exchange.reply = response.text;
+        writer.append(exchange);
+    }
+
+    // Hit counts come back from the journal without matching anything.
+    std::unordered_map<std::string, uint64_t> hits;
+    QVERIFY(reader.open(path));
+    while (reader.next(record)) {
+        if (record.type == deep_thonk::JournalRecord::Type::Exchange)
+            ++hits[std::string(record.ruleId)];
+    }
+    QVERIFY(!reader.truncated());
+    reader.close();
+    deep_thonk::Engine restored;
+    restored.loadRulesFromString(readRuleFile(":/resources/rules/en-US.json"));
+    QVERIFY(restored.restoreHits("en-US", hits));
+    QVERIFY(!restored.restoreHits("xx-XX", hits));
+    std::shared_ptr<const deep_thonk::RulePack> pack = restored.getRulePack("en-US");
+    uint64_t total = 0;
+    for (const auto& rule : pack->rules)
+        total += rule.hits.load();
+    QCOMPARE(total, uint64_t(1));
+
+    // Exports stream every record; the JSON one parses back.
+    std::ostringstream text;
+    std::ostringstream json;
+    QVERIFY(deep_thonk::exportJournal(path, text, deep_thonk::JournalFormat::Text));
+    QVERIFY(deep_thonk::exportJournal(path, json, deep_thonk::JournalFormat::Json));
+    QVERIFY(text.str().find("You: I feel lost\n") != std::string::npos);
+    QVERIFY(text.str().find("session started (en-US, seed 11)") != std::string::npos);
+    nlohmann::json parsed = nlohmann::json::parse(json.str());
+    QCOMPARE(parsed.size(), size_t(2 + kThreads * kExchanges));
+    QCOMPARE(QString::fromStdString(parsed.back()["input"].get<std::string>()), QString("I feel lost"));
+
+    // Anything else is left alone.
+    std::string foreign = dir.filePath("notes.txt").toStdString();
+    std::ofstream(foreign) << "not a journal";
+    deep_thonk::JournalWriter writer;
+    QVERIFY(!writer.open(foreign));
+    QVERIFY(!deep_thonk::exportJournal(foreign, text, deep_thonk::JournalFormat::Text));
+}
+
+void TestEngine::testMatchCache()
+{
+    const std::string json = R"json({
+        "locale": "test",
+        "reflect": [["my", "your"], ["i", "you"]],
+        "rules": [
+            {"id": "probe", "category": "General", "pattern": "^$", "outs": ["Go on."]},
+            {"id": "feel", "category": "Test", "pattern": "i feel (.+)", "outs": ["Why do you feel {1}?"]},
+            {"id": "yes", "category": "Test", "pattern": "^yes$", "outs": ["You seem sure."]}
+        ]
+    })json";
+    deep_thonk::Engine cached;
+    cached.loadRulesFromString(json);
+    deep_thonk::Engine uncached;
+    uncached.loadRulesFromString(json);
+    uncached.setMatchCacheCapacity(0);
+
+    // Repeats, in any case, are answered from the cache with the same reply.
+    deep_thonk::Session a = cached.createSession("test", 5);
+    deep_thonk::Session b = uncached.createSession("test", 5);
+    const std::vector<std::string> messages = {"I feel tired", "yes", "i FEEL tired", "Yes", "hmm", "hmm", "I feel my age"};
+    for (const auto& message : messages) {
+        deep_thonk::Response fromCache = cached.respond(a, message);
+        deep_thonk::Response direct = uncached.respond(b, message);
+        QCOMPARE(QString::fromStdString(fromCache.text), QString::fromStdString(direct.text));
+        QCOMPARE(QString::fromStdString(fromCache.ruleId), QString::fromStdString(direct.ruleId));
+    }
+    deep_thonk::MatchCacheStats stats = cached.matchCacheStats();
+    QCOMPARE(stats.hits, uint64_t(3));
+    QCOMPARE(stats.misses, uint64_t(4));
+    QCOMPARE(stats.entries, size_t(4));
+    QVERIFY(stats.bytes > 0);
+    QCOMPARE(cached.instrumentationSnapshot().matchCache.hits, uint64_t(3));
+    QCOMPARE(uncached.matchCacheStats().entries, size_t(0));
+
+    // A reloaded pack never sees results of the one it replaced.
+    cached.reloadRules(R"json({"locale": "test", "rules": [
+        {"id": "probe", "category": "General", "pattern": "^$", "outs": ["Go on."]},
+        {"id": "tired", "category": "Test", "pattern": "tired", "outs": ["Rest, then."]}]})json");
+    QCOMPARE(QString::fromStdString(cached.respond(a, "I feel tired").ruleId), QString("tired"));
+    QCOMPARE(cached.matchCacheStats().hits, uint64_t(3));
+
+    // The cache stays within its capacity, including ones that do not
+    // divide evenly across the shards.
+    for (size_t capacity : {size_t(1), size_t(5), deep_thonk::MatchCache::kShards, deep_thonk::MatchCache::kShards + 3}) {
+        cached.setMatchCacheCapacity(capacity);
+        for (int i = 0; i < 200; ++i)
+            cached.respond(a, "i feel " + std::to_string(i));
+        QVERIFY(cached.matchCacheStats().entries <= capacity);
+        QVERIFY(cached.matchCacheStats().entries > 0);
+    }
+    QCOMPARE(QString::fromStdString(cached.respond(a, "i feel 199").text), QString("Go on."));
+}
+
+void TestEngine::testHotReload()
+{
+    std::string json = readRuleFile(":/resources/rules/en-US.json");
+    deep_thonk::Engine engine;
+    engine.loadRulesFromString(json);
+
+    deep_thonk::Session session = engine.createSession("en-US");
+    deep_thonk::Response first = engine.respond(session, "I feel lost");
+    QVERIFY(!first.ruleId.empty());
+    std::shared_ptr<const deep_thonk::RulePack> oldPack = engine.getRulePack("en-US");
+
+    // Keeps the matched rule's id, drops every other rule.
+    std::string replacement = R"json({"locale": "en-US", "reflect": [], "rules": [
+        {"id": ")json" + first.ruleId + R"json(", "category": "General", "pattern": "(.*)", "outs": ["reloaded"]},
+        {"id": "brand.new", "category": "General", "pattern": "^never$", "outs": ["new"]}]})json";
+
+    // Readers keep answering while packs are swapped underneath them.
+    std::atomic<bool> stop{false};
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&engine, &stop] {
+            deep_thonk::Session local = engine.createSession("en-US");
+            while (!stop.load())
+                engine.respond(local, "I feel lost");
+        });
+    }
+    for (int i = 0; i < 10; ++i)
+        QCOMPARE(engine.reloadRulesAsync(i % 2 ? json : replacement).get(), std::string("en-US"));
+    stop = true;
+    for (auto& reader : readers)
+        reader.join();
+
+    engine.reloadRules(replacement);
+    deep_thonk::Response after = engine.respond(session, "anything at all");
+    QVERIFY(after.text == "reloaded");
+
+    // The old snapshot stays valid for whoever still holds it.
+    QVERIFY(oldPack->rules.size() > 2);
+
+    const deep_thonk::RulePack& pack = *engine.getRulePack("en-US");
+    QCOMPARE(pack.rules.size(), size_t(2));
+    QVERIFY(pack.rules[0].hits.load() >= 2);
+    QCOMPARE(pack.rules[1].hits.load(), uint64_t(0));
+
+    QVERIFY_THROWS_EXCEPTION(std::runtime_error, engine.reloadRules(R"json({"locale": "xx-XX", "rules": []})json"));
+    QVERIFY_THROWS_EXCEPTION(std::runtime_error, engine.reloadRulesAsync("{").get());
+    QCOMPARE(engine.getRulePack("en-US")->rules.size(), size_t(2));
+}
+
+void TestEngine::testLazyRulePack()
+{
+    std::string json = readRuleFile(":/resources/rules/en-US.json");
+    std::atomic<int> compiles{0};
+
+    deep_thonk::Engine engine;
+    engine.addLazyRulePack("en-US", [&] {
+        ++compiles;
+        return deep_thonk::PackSource{json, ""};
+    });
+    engine.addLazyRulePack("pt-BR", [&]() -> deep_thonk::PackSource {
+        throw std::runtime_error("never used");
+    });
+
+    // Declaring costs nothing, and a session may pick the locale before its pack exists.
+    QCOMPARE(compiles.load(), 0);
+    QVERIFY(engine.getRulePacks().empty());
+    deep_thonk::Session session = engine.createSession("en-US");
+    QCOMPARE(session.locale, std::string("en-US"));
+    QVERIFY(engine.respond(session, "I feel lost").ruleId.empty());
+
+    std::atomic<int> loaded{0};
+    std::vector<std::thread> loaders;
+    for (int t = 0; t < 4; ++t)
+        loaders.emplace_back([&engine, &loaded] { loaded += engine.ensureLoaded("en-US"); });
+    for (auto& loader : loaders)
+        loader.join();
+    QCOMPARE(loaded.load(), 4);
+    QCOMPARE(compiles.load(), 1);
+
+    // The session switches to the compiled pack on its next reply.
+    QVERIFY(!engine.respond(session, "I feel lost").ruleId.empty());
+    QCOMPARE(engine.getRulePacks().size(), size_t(1));
+
+    QVERIFY(!engine.ensureLoaded("pt-BR"));
+    QVERIFY(!engine.ensureLoaded("xx-XX"));
+    QVERIFY(!engine.getRulePack("pt-BR"));
+}
+
+void TestEngine::testInstrumentation()
+{
+    if (!deep_thonk::kInstrumentationEnabled)
+        QSKIP("built without DEEPTHONK_ENABLE_INSTRUMENTATION");
+
+    deep_thonk::Engine engine;
+    engine.loadRulesFromString(readRuleFile(":/resources/rules/en-US.json"));
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&engine] {
+            deep_thonk::Session session = engine.createSession("en-US");
+            for (int i = 0; i < 50; ++i) {
+                engine.respond(session, "I feel lost");
+                engine.respond(session, "Hello");
+            }
+        });
+    }
+    // Snapshots may be taken while other threads are recording.
+    for (int i = 0; i < 10; ++i)
+        engine.instrumentationSnapshot();
+    for (auto& thread : threads)
+        thread.join();
+
+    // Counts of exited threads are kept.
+    deep_thonk::InstrumentationSnapshot snapshot = engine.instrumentationSnapshot();
+    const deep_thonk::LocaleStats& stats = snapshot.locales.at("en-US");
+    QCOMPARE(stats.responses, uint64_t(400));
+    QCOMPARE(stats.phases[static_cast<size_t>(deep_thonk::Phase::Match)].count, uint64_t(400));
+
+    const deep_thonk::RulePack& pack = *engine.getRulePack("en-US");
+    // Repeated messages are answered from the match cache, so most wins are
+    // counted as cached rather than as regex matches.
+    uint64_t matches = 0;
+    for (size_t i = 0; i < pack.rules.size(); ++i) {
+        QCOMPARE(stats.rules[i].matches + stats.rules[i].cached, pack.rules[i].hits.load());
+        QVERIFY(stats.rules[i].evaluations >= stats.rules[i].matches);
+        QVERIFY(stats.rules[i].evaluations == 0 || stats.rules[i].evalNs > 0);
+        matches += stats.rules[i].matches + stats.rules[i].cached;
+    }
+    QVERIFY(snapshot.matchCache.hits > 0);
+    QCOMPARE(matches + stats.fallbacks, stats.responses);
+
+    // A reload publishes a new pack whose counters start from zero.
+    engine.reloadRules(readRuleFile(":/resources/rules/en-US.json"));
+    QCOMPARE(engine.instrumentationSnapshot().locales.at("en-US").responses, uint64_t(0));
+}
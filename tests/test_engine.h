@@ -19,6 +19,33 @@ private slots:
     void testReflection_data();
     void testReflection();
 
+    void testReflectionTable_data();
+    void testReflectionTable();
+
+    void testTemplates_data();
+    void testTemplates();
+
+    void testNormalizer_data();
+    void testNormalizer();
+    void testAccentedInput();
+
+    void testMatcherGolden_data();
+    void testMatcherGolden();
+    void testLinearMatching();
+
+    void testPackFile();
+    void testRuleLoader();
+
+    void testConcurrentSessions();
+    void testRespondBatch();
+    void testTemplateSelection();
+    void testConversationMemory();
+    void testJournal();
+    void testMatchCache();
+    void testHotReload();
+    void testLazyRulePack();
+    void testInstrumentation();
+
 private:
     deep_thonk::Engine m_engine;
 };